@@ -0,0 +1,467 @@
+#define _GNU_SOURCE // For mkdtemp(), setenv() and utimensat() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+// Custom headers
+#include "main.h"
+#include "command.h"
+#include "input_parser.h"
+#include "route.h"
+#include "reveal.h"
+#include "dircache.h"
+#include "log.h"
+#include "jobs.h"
+#include "vars.h"
+#include "builtins.h"
+#include "script.h"
+
+/*
+ * Microbenchmarks for the shell, run by `make bench`.
+ *
+ * Each benchmark is calibrated so that one sample runs for at least
+ * TARGET_SAMPLE_NS, then timed over a fixed number of samples. Reported
+ * numbers are per iteration: the median and the median absolute deviation
+ * (MAD) across samples, which are far less sensitive to the odd slow sample
+ * than mean and stddev. Results go to stdout as JSON; progress goes to
+ * stderr. Anything the shell code prints goes to /dev/null.
+ *
+ * Usage: bench/shell_bench [--samples N] [--filter SUBSTRING] [--list]
+ */
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+#define DEFAULT_SAMPLES 21
+#define TARGET_SAMPLE_NS 5000000.0 // 5 ms
+#define MAX_ITERATIONS 1000000
+
+typedef void (*BenchFn)(void* ctx);
+
+typedef struct {
+    const char* name;
+    BenchFn setup;    // Run once before timing, may be NULL
+    BenchFn fn;       // The timed operation
+    void* ctx;
+} Bench;
+
+typedef struct {
+    const char* name;
+    long iterations;
+    int samples;
+    double median_ns;
+    double mad_ns;
+    double min_ns;
+    double max_ns;
+} BenchResult;
+
+static char tmp_root[] = "/tmp/roy_shell_bench.XXXXXX";
+static char dir_paths[3][512];
+static const int dir_sizes[3] = {100, 1000, 10000};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int double_comparator(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double* values, int n) {
+    qsort(values, n, sizeof(double), double_comparator);
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+static double time_iterations(const Bench* b, long iterations) {
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) b->fn(b->ctx);
+    return now_ns() - start;
+}
+
+static BenchResult run_bench(const Bench* b, int samples) {
+    if (b->setup) b->setup(b->ctx);
+    b->fn(b->ctx); // Warm up caches, so calibration isn't fooled by a cold first call
+
+    // Calibrate: double the iteration count until a sample is long enough.
+    long iterations = 1;
+    while (iterations < MAX_ITERATIONS && time_iterations(b, iterations) < TARGET_SAMPLE_NS) {
+        iterations *= 2;
+    }
+
+    double per_iter[samples];
+    for (int s = 0; s < samples; s++) {
+        per_iter[s] = time_iterations(b, iterations) / iterations;
+    }
+
+    BenchResult r;
+    r.name = b->name;
+    r.iterations = iterations;
+    r.samples = samples;
+    r.median_ns = median_of(per_iter, samples); // Also sorts per_iter
+    r.min_ns = per_iter[0];
+    r.max_ns = per_iter[samples - 1];
+    double deviations[samples];
+    for (int s = 0; s < samples; s++) {
+        double d = per_iter[s] - r.median_ns;
+        deviations[s] = d < 0 ? -d : d;
+    }
+    r.mad_ns = median_of(deviations, samples);
+    return r;
+}
+
+// --- Parser ---
+
+static void bench_parse(void* ctx) {
+    char* line = ctx;
+    script_free(script_parse(line, NULL));
+}
+
+static char* make_long_line(void) {
+    // One command with ~600 arguments and a few redirections: ~4 KiB.
+    size_t cap = 8192, len = 0;
+    char* line = malloc(cap);
+    len += snprintf(line + len, cap - len, "grep -e pattern");
+    for (int i = 0; i < 600; i++) {
+        len += snprintf(line + len, cap - len, " f%03d", i);
+    }
+    snprintf(line + len, cap - len, " < in.txt > out.txt");
+    return line;
+}
+
+static char* make_max_pipeline(void) {
+    // MAX_PIPED_CMDS stages, each with a few arguments.
+    size_t cap = 4096, len = 0;
+    char* line = malloc(cap);
+    for (int i = 0; i < MAX_PIPED_CMDS; i++) {
+        len += snprintf(line + len, cap - len, "%scmd%d -a -b arg%d", i ? " | " : "", i, i);
+    }
+    return line;
+}
+
+static char* make_nested_subst(void) {
+    // 200 levels of $( ... ) in one word.
+    size_t cap = 4096, len = 0;
+    char* line = malloc(cap);
+    len += snprintf(line + len, cap - len, "echo ");
+    for (int i = 0; i < 200; i++) len += snprintf(line + len, cap - len, "$(x ");
+    for (int i = 0; i < 200; i++) len += snprintf(line + len, cap - len, ")");
+    return line;
+}
+
+static char* make_invalid_tail(void) {
+    // A long valid prefix that fails at the very end, so all of it is
+    // parsed before being thrown away.
+    size_t cap = 8192, len = 0;
+    char* line = malloc(cap);
+    for (int i = 0; i < 15; i++) {
+        len += snprintf(line + len, cap - len, "cmd%d a b c d e f g ; ", i);
+    }
+    snprintf(line + len, cap - len, "cmd > > x");
+    return line;
+}
+
+// --- Directory listing ---
+
+static void create_dir(int which) {
+    char* path = dir_paths[which];
+    snprintf(path, sizeof(dir_paths[which]), "%s/d%d", tmp_root, dir_sizes[which]);
+    mkdir(path, 0755);
+    char file[600];
+    for (int i = 0; i < dir_sizes[which]; i++) {
+        // Scrambled names so the sort has real work to do.
+        unsigned int h = (unsigned int)i * 2654435761u;
+        snprintf(file, sizeof(file), "%s/%08x_%d.txt", path, h, i);
+        int fd = open(file, O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0) close(fd);
+    }
+    // Old mtime, so dircache treats its listing as trustworthy.
+    struct timespec times[2] = {{time(NULL) - 3600, 0}, {time(NULL) - 3600, 0}};
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+static void bench_list_and_sort(void* ctx) {
+    char** files = list_and_sort_files(ctx);
+    for (int i = 0; files && files[i]; i++) free(files[i]);
+    free(files);
+}
+
+static void bench_dircache_get(void* ctx) {
+    dircache_release(dircache_get(ctx));
+}
+
+// --- History ---
+
+static void write_history(int lines) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/.roy_shell_history", tmp_root);
+    FILE* f = fopen(path, "w");
+    if (!f) return;
+    for (int i = 0; i < lines; i++) fprintf(f, "echo history line %d | wc -c\n", i);
+    fclose(f);
+}
+
+static void setup_full_history(void* ctx) { write_history(15); }
+static void setup_large_history(void* ctx) { write_history(10000); }
+
+static void bench_add_to_log(void* ctx) {
+    static unsigned long n = 0;
+    char command[64];
+    snprintf(command, sizeof(command), "echo command %lu", n++); // Never a duplicate
+    add_to_log(command);
+}
+
+static void bench_log_list(void* ctx) {
+    char* args[] = {"log", NULL};
+    execute_log(args);
+}
+
+// --- Job table ---
+
+static void bench_jobs_fill(void* ctx) {
+    init_jobs();
+    for (int i = 0; i < MAX_JOBS; i++) add_job(1000000 + i, "sleep 100 &");
+}
+
+static void setup_jobs_full(void* ctx) { bench_jobs_fill(NULL); }
+
+static void bench_jobs_lookup(void* ctx) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!get_job_by_pgid(1000000 + i)) abort();
+    }
+}
+
+static void bench_jobs_snapshot(void* ctx) {
+    Job jobs[MAX_JOBS];
+    if (get_active_jobs(jobs) != MAX_JOBS) abort();
+}
+
+static void bench_jobs_recent(void* ctx) {
+    if (!get_most_recent_job()) abort();
+}
+
+// --- End to end ---
+
+static void bench_pipeline(void* ctx) {
+    char* line = ctx;
+    ScriptNode* tree = script_parse(line, NULL);
+    script_run(tree, line);
+    script_free(tree);
+}
+
+// --- Control flow ---
+
+#define LOOP_ITERATIONS 100000
+
+// A 100k-iteration loop body parsed once, against the same commands each
+// lexed and parsed from scratch, which is what a loop costs when its body
+// is re-read every time round.
+static char* loop_line;
+static ScriptNode* loop_tree;
+
+static void setup_for_loop(void* ctx) {
+    if (loop_tree) return;
+    size_t cap = LOOP_ITERATIONS * 2 + 64, len = 0;
+    loop_line = malloc(cap);
+    len += snprintf(loop_line + len, cap - len, "for i in");
+    for (int i = 0; i < LOOP_ITERATIONS; i++) {
+        len += snprintf(loop_line + len, cap - len, " w");
+    }
+    snprintf(loop_line + len, cap - len, "; do true $i; done");
+    loop_tree = script_parse(loop_line, NULL);
+    if (!loop_tree) abort();
+}
+
+static void bench_for_loop(void* ctx) {
+    script_run(loop_tree, loop_line);
+}
+
+static void bench_relex_loop(void* ctx) {
+    char line[32];
+    for (int i = 0; i < LOOP_ITERATIONS; i++) {
+        snprintf(line, sizeof(line), "true %d", i);
+        bench_pipeline(line);
+    }
+}
+
+static void remove_tree(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    char child[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) remove_tree(child);
+        else unlink(child);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+static void print_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+int main(int argc, char** argv) {
+    int samples = DEFAULT_SAMPLES;
+    const char* filter = NULL;
+    int list_only = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list_only = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--samples N] [--filter SUBSTRING] [--list]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 3) samples = 3;
+
+    if (!mkdtemp(tmp_root)) {
+        perror("bench: mkdtemp");
+        return 1;
+    }
+    // History and the frecency database live in $HOME; keep them out of the real one.
+    setenv("HOME", tmp_root, 1);
+    init_shell(&info);
+    init_jobs();
+    init_vars();
+    for (int i = 0; i < 3; i++) create_dir(i);
+
+    char reveal_line[600];
+    snprintf(reveal_line, sizeof(reveal_line), "reveal %s", dir_paths[0]);
+
+    // A script of small coreutils, run natively and with `command` forcing
+    // the external binaries.
+    char lines_path[600], native_script[1400], external_script[1400];
+    snprintf(lines_path, sizeof(lines_path), "%s/lines.txt", tmp_root);
+    FILE* lines = fopen(lines_path, "w");
+    for (int i = 0; lines && i < 1000; i++) fprintf(lines, "line %d\n", i);
+    if (lines) fclose(lines);
+    snprintf(native_script, sizeof(native_script),
+             "echo a ; printf %%s b ; true ; wc -l %s ; head -n 5 %s ; false", lines_path, lines_path);
+    snprintf(external_script, sizeof(external_script),
+             "command echo a ; command printf %%s b ; command true ; command wc -l %s ; "
+             "command head -n 5 %s ; command false", lines_path, lines_path);
+
+    // The sample plugin (`make plugins`) as builtins, against the same code
+    // run as an external executable.
+    char plugin_path[PATH_MAX], tool_path[PATH_MAX];
+    char enable_line[PATH_MAX + 16], tool_hash_line[PATH_MAX + 32], tool_json_line[PATH_MAX + 64];
+    int have_plugins = realpath("plugins/sample.so", plugin_path) != NULL &&
+                       realpath("plugins/sample-tool", tool_path) != NULL;
+    if (have_plugins) {
+        snprintf(enable_line, sizeof(enable_line), "enable -f %s", plugin_path);
+        bench_pipeline(enable_line);
+        have_plugins = find_builtin("fnvhash") != NULL;
+    }
+    snprintf(tool_hash_line, sizeof(tool_hash_line), "%s fnvhash hello-world", tool_path);
+    snprintf(tool_json_line, sizeof(tool_json_line), "%s jsonfield name <<< {\"id\":1,\"name\":\"x\"}", tool_path);
+
+    Bench benches[] = {
+        {"parse/short", NULL, bench_parse, "ls -l"},
+        {"parse/typical", NULL, bench_parse, "cat file.txt | grep foo | sort > out.txt ; echo done &"},
+        {"parse/long_4k", NULL, bench_parse, make_long_line()},
+        {"parse/max_pipeline", NULL, bench_parse, make_max_pipeline()},
+        {"parse/nested_subst_200", NULL, bench_parse, make_nested_subst()},
+        {"parse/invalid_tail", NULL, bench_parse, make_invalid_tail()},
+        {"dir/list_and_sort_100", NULL, bench_list_and_sort, dir_paths[0]},
+        {"dir/list_and_sort_1000", NULL, bench_list_and_sort, dir_paths[1]},
+        {"dir/list_and_sort_10000", NULL, bench_list_and_sort, dir_paths[2]},
+        {"dir/dircache_hit_10000", NULL, bench_dircache_get, dir_paths[2]},
+        {"log/list_10000_lines", setup_large_history, bench_log_list, NULL},
+        {"log/list_full", setup_full_history, bench_log_list, NULL},
+        {"log/add_full", setup_full_history, bench_add_to_log, NULL},
+        {"jobs/fill_table", NULL, bench_jobs_fill, NULL},
+        {"jobs/lookup_all_by_pgid", setup_jobs_full, bench_jobs_lookup, NULL},
+        {"jobs/active_snapshot", setup_jobs_full, bench_jobs_snapshot, NULL},
+        {"jobs/most_recent", setup_jobs_full, bench_jobs_recent, NULL},
+        {"pipeline/builtin_export", NULL, bench_pipeline, "export BENCH_VAR=1"},
+        {"pipeline/builtin_reveal_100", NULL, bench_pipeline, reveal_line},
+        {"pipeline/external_true", NULL, bench_pipeline, "command true"},
+        {"pipeline/native_true", NULL, bench_pipeline, "true"},
+        {"pipeline/native_script", NULL, bench_pipeline, native_script},
+        {"pipeline/external_script", NULL, bench_pipeline, external_script},
+        {"pipeline/stages_2", NULL, bench_pipeline, "true | cat"},
+        {"pipeline/stages_4", NULL, bench_pipeline, "true | cat | cat | cat"},
+        {"pipeline/stages_8", NULL, bench_pipeline, "true | cat | cat | cat | cat | cat | cat | cat"},
+        {"control/for_100k_true", setup_for_loop, bench_for_loop, NULL},
+        {"control/relex_100k_true", NULL, bench_relex_loop, NULL},
+        // Plugin benchmarks stay last so they can be dropped together.
+        {"plugin/fnvhash_builtin", NULL, bench_pipeline, "fnvhash hello-world"},
+        {"plugin/fnvhash_exec", NULL, bench_pipeline, tool_hash_line},
+        {"plugin/jsonfield_builtin", NULL, bench_pipeline, "jsonfield name <<< {\"id\":1,\"name\":\"x\"}"},
+        {"plugin/jsonfield_exec", NULL, bench_pipeline, tool_json_line},
+    };
+    int num_benches = sizeof(benches) / sizeof(benches[0]);
+    if (!have_plugins) {
+        fprintf(stderr, "bench: plugins not built, skipping plugin/*\n");
+        num_benches -= 4;
+    }
+
+    if (list_only) {
+        for (int i = 0; i < num_benches; i++) printf("%s\n", benches[i].name);
+        remove_tree(tmp_root);
+        return 0;
+    }
+
+    // Results go to the real stdout; everything the shell prints is discarded.
+    fflush(stdout);
+    FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    if (!out || devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+        perror("bench: redirect stdout");
+        return 1;
+    }
+    close(devnull);
+
+    BenchResult results[num_benches];
+    int num_results = 0;
+    for (int i = 0; i < num_benches; i++) {
+        if (filter && !strstr(benches[i].name, filter)) continue;
+        fprintf(stderr, "%-28s", benches[i].name);
+        results[num_results] = run_bench(&benches[i], samples);
+        fflush(stdout);
+        const BenchResult* r = &results[num_results++];
+        fprintf(stderr, " %12.0f ns  (MAD %.0f ns, %ld iters x %d)\n",
+                r->median_ns, r->mad_ns, r->iterations, r->samples);
+    }
+    init_jobs(); // The fake jobs must never be signalled
+
+    fprintf(out, "{\n  \"suite\": \"roy-shell\",\n  \"version\": ");
+    print_json_string(out, BENCH_VERSION);
+    fprintf(out, ",\n  \"timestamp\": %ld,\n  \"unit\": \"ns\",\n  \"results\": [\n", (long)time(NULL));
+    for (int i = 0; i < num_results; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "    {\"name\": ");
+        print_json_string(out, r->name);
+        fprintf(out, ", \"median\": %.1f, \"mad\": %.1f, \"min\": %.1f, \"max\": %.1f, "
+                     "\"iterations\": %ld, \"samples\": %d}%s\n",
+                r->median_ns, r->mad_ns, r->min_ns, r->max_ns, r->iterations, r->samples,
+                i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+
+    remove_tree(tmp_root);
+    return 0;
+}
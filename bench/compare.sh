@@ -0,0 +1,36 @@
+#!/bin/sh
+# Compares two result files written by `make bench`.
+#
+# Usage: bench/compare.sh old.json new.json
+# A benchmark is flagged when its median moved by more than 5% and by more
+# than three times the larger of the two MADs, i.e. beyond run-to-run noise.
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 old.json new.json" >&2
+    exit 2
+fi
+
+# Each result sits on its own line: {"name": "...", "median": N, "mad": N, ...}
+extract() {
+    sed -n 's/.*"name": "\([^"]*\)", "median": \([0-9.]*\), "mad": \([0-9.]*\).*/\1 \2 \3/p' "$1"
+}
+
+extract "$1" > /tmp/bench_old.$$
+extract "$2" > /tmp/bench_new.$$
+
+awk '
+    NR == FNR { old_median[$1] = $2; old_mad[$1] = $3; next }
+    {
+        name = $1; median = $2; mad = $3
+        if (!(name in old_median)) { printf "%-28s %12s -> %12.0f ns  (new)\n", name, "-", median; next }
+        before = old_median[name]
+        change = before > 0 ? (median - before) / before * 100 : 0
+        noise = 3 * (mad > old_mad[name] ? mad : old_mad[name])
+        diff = median - before; if (diff < 0) diff = -diff
+        verdict = ""
+        if (diff > noise && (change > 5 || change < -5)) verdict = change > 0 ? "  SLOWER" : "  faster"
+        printf "%-28s %12.0f -> %12.0f ns  %+6.1f%%%s\n", name, before, median, change, verdict
+    }
+' /tmp/bench_old.$$ /tmp/bench_new.$$
+
+rm -f /tmp/bench_old.$$ /tmp/bench_new.$$
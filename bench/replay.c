@@ -0,0 +1,610 @@
+#define _GNU_SOURCE // For mkdtemp(), setenv(), clearenv(), realpath(), memmem() and nftw() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <ftw.h>
+#include <limits.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * Replays a session recorded with ROY_SHELL_RECORD=file (see
+ * include/record.h) against a shell binary, through a pty, and reports how
+ * long each command took: from the last line of its input going in to the
+ * next prompt coming out.
+ *
+ * By default the lines go in with the recorded pauses between them, so the
+ * shell sees the session as it happened (background jobs get the same time
+ * to run, and so on); with --max-speed they go in as soon as the prompt is
+ * back. Either way the shell starts in the recorded directory and with the
+ * recorded environment, but with a fresh $HOME so that history and
+ * frecency state don't differ between runs.
+ *
+ * Changes to the directory and environment during the session are made by
+ * the commands themselves, so they aren't applied from outside. Instead the
+ * replayed shell records its own session into the scratch $HOME (at the
+ * cost of a write() per command), and the changes it saw before each
+ * command are checked against the recorded ones; the first that differs
+ * is reported, since the commands after it may not have run the same way.
+ *
+ * Latencies are summarized per command name (its first word) and over all
+ * commands: a table on stderr, next to the recorded latencies, and JSON on
+ * stdout in the format of `make bench`, so that bench/compare.sh compares
+ * two builds on the same recording.
+ *
+ * Usage: bench/shell_replay [--max-speed] [--shell PATH] [--timeout SECONDS]
+ *                           [--version LABEL] RECORDING > results.json
+ */
+
+#define PROMPT_END "\033[36m> \033[0m" // How the shell's prompt ends
+#define DEFAULT_TIMEOUT 60              // Seconds to wait for a command
+
+typedef struct {
+    char* name;            // First word of the command line
+    char** lines;          // Input lines, newline included
+    long long* delays_us;  // Recorded pause before each line
+    int num_lines;
+    long long recorded_us; // Recorded time from the last line to done, -1 if none
+    char** changes;        // The d, e and u records just before it, as "tag text"
+    int num_changes;
+} Command;
+
+typedef struct {
+    Command* commands;
+    int num_commands;
+    char** env;               // The exported variables at the start, as "NAME=value"
+    int env_count;
+    char start_dir[PATH_MAX]; // Empty if not recorded
+} Recording;
+
+typedef struct {
+    const char* name;
+    double* replayed_ns;
+    int count;
+    double* recorded_ns;
+    int recorded_count;
+} Group;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void sleep_us(long long us) {
+    if (us <= 0) return;
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void* xrealloc(void* p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        perror("replay: realloc");
+        exit(1);
+    }
+    return p;
+}
+
+// Undoes the recording's `\\` and `\n` escapes in place.
+static void unescape(char* s) {
+    char* out = s;
+    for (; *s; s++) {
+        if (*s == '\\' && (s[1] == '\\' || s[1] == 'n')) {
+            *out++ = s[1] == 'n' ? '\n' : '\\';
+            s++;
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+static char* first_word(const char* line) {
+    line += strspn(line, " \t");
+    size_t len = strcspn(line, " \t\n;|&<>()");
+    if (len == 0) return strdup("(empty)");
+    char* word = malloc(len + 1);
+    if (!word) return NULL;
+    memcpy(word, line, len);
+    word[len] = '\0';
+    return word;
+}
+
+static char* xstrdup(const char* s) {
+    char* copy = strdup(s);
+    if (!copy) {
+        perror("replay: malloc");
+        exit(1);
+    }
+    return copy;
+}
+
+static void add_string(char*** list, int* count, char* s) {
+    *list = xrealloc(*list, (*count + 1) * sizeof(char*));
+    (*list)[(*count)++] = s;
+}
+
+/**
+ * @brief Reads a recording into its commands, the directory and environment
+ * the session started with, and the changes to them before each command.
+ * @return 0, or -1 if the file can't be read.
+ */
+static int read_recording(const char* path, Recording* rec) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char* line = NULL;
+    size_t cap = 0;
+    if (getline(&line, &cap, f) < 0 || strncmp(line, "roy-shell-record 1", 18) != 0) {
+        fprintf(stderr, "replay: %s: not a recording\n", path);
+        free(line);
+        fclose(f);
+        return -1;
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    Command* commands = NULL;
+    int count = 0;
+    long long pending_us = 0; // Time since the last line that went to the shell
+    char** changes = NULL;    // Since the last command
+    int num_changes = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        if (line[n - 1] == '\n') line[n - 1] = '\0';
+        char tag;
+        long long us;
+        int text_at;
+        if (sscanf(line, "%c %lld %n", &tag, &us, &text_at) != 2) continue;
+        char* text = line + text_at;
+        unescape(text);
+        pending_us += us;
+
+        if (tag == 'd' && count == 0) {
+            snprintf(rec->start_dir, sizeof(rec->start_dir), "%s", text);
+        } else if (tag == 'e' && count == 0) {
+            add_string(&rec->env, &rec->env_count, xstrdup(text));
+        } else if (tag == 'd' || tag == 'e' || tag == 'u') {
+            char* change = malloc(strlen(text) + 3);
+            if (!change) {
+                perror("replay: malloc");
+                exit(1);
+            }
+            sprintf(change, "%c %s", tag, text);
+            add_string(&changes, &num_changes, change);
+        } else if (tag == 'c' || (tag == 'm' && count > 0)) {
+            if (tag == 'c') {
+                commands = xrealloc(commands, (count + 1) * sizeof(Command));
+                Command* c = &commands[count++];
+                memset(c, 0, sizeof(*c));
+                c->name = first_word(text);
+                c->recorded_us = -1;
+                c->changes = changes;
+                c->num_changes = num_changes;
+                changes = NULL;
+                num_changes = 0;
+            }
+            Command* c = &commands[count - 1];
+            c->lines = xrealloc(c->lines, (c->num_lines + 1) * sizeof(char*));
+            c->delays_us = xrealloc(c->delays_us, (c->num_lines + 1) * sizeof(long long));
+            size_t len = strlen(text);
+            char* input = malloc(len + 2);
+            if (!input) {
+                perror("replay: malloc");
+                exit(1);
+            }
+            memcpy(input, text, len);
+            memcpy(input + len, "\n", 2);
+            c->lines[c->num_lines] = input;
+            c->delays_us[c->num_lines++] = pending_us;
+            pending_us = 0;
+        } else if (tag == 'r' && count > 0) {
+            commands[count - 1].recorded_us = pending_us;
+            pending_us = 0;
+        }
+    }
+    for (int i = 0; i < num_changes; i++) free(changes[i]); // After the last command
+    free(changes);
+    free(line);
+    fclose(f);
+    rec->commands = commands;
+    rec->num_commands = count;
+    return 0;
+}
+
+// The value of `name` in the recorded environment, or NULL.
+static const char* recorded_env(const Recording* rec, const char* name) {
+    size_t len = strlen(name);
+    for (int i = 0; i < rec->env_count; i++) {
+        if (strncmp(rec->env[i], name, len) == 0 && rec->env[i][len] == '=') {
+            return rec->env[i] + len + 1;
+        }
+    }
+    return NULL;
+}
+
+// Replaces the environment with the recorded one.
+static void use_recorded_env(const Recording* rec) {
+    clearenv();
+    for (int i = 0; i < rec->env_count; i++) {
+        char* eq = strchr(rec->env[i], '=');
+        if (!eq) continue;
+        *eq = '\0';
+        setenv(rec->env[i], eq + 1, 1);
+        *eq = '=';
+    }
+}
+
+/**
+ * @brief A copy of the change record `change` with a path or value under
+ * `from_home` moved under `to_home`, as the replayed shell would see it.
+ */
+static char* map_home(const char* change, const char* from_home, const char* to_home) {
+    const char* text = change + 2;
+    if (change[0] == 'e') {
+        text = strchr(text, '=');
+        text = text ? text + 1 : change + strlen(change);
+    }
+    size_t len = from_home ? strlen(from_home) : 0;
+    if (change[0] == 'u' || len == 0 || strncmp(text, from_home, len) != 0 ||
+        (text[len] != '/' && text[len] != '\0')) {
+        return xstrdup(change);
+    }
+    size_t head = (size_t)(text - change);
+    char* mapped = malloc(head + strlen(to_home) + strlen(text + len) + 1);
+    if (!mapped) {
+        perror("replay: malloc");
+        exit(1);
+    }
+    sprintf(mapped, "%.*s%s%s", (int)head, change, to_home, text + len);
+    return mapped;
+}
+
+static void print_changes(const char* label, const Command* c) {
+    fprintf(stderr, "  %s:", label);
+    for (int i = 0; i < c->num_changes; i++) {
+        fprintf(stderr, "%s %s", i ? "," : "", c->changes[i]);
+    }
+    fprintf(stderr, "%s\n", c->num_changes ? "" : " (none)");
+}
+
+/**
+ * @brief Checks the directory and environment changes the replayed shell
+ * recorded into `path`, before each of its first `count` commands, against
+ * the ones in `rec`, and warns at the first that differs.
+ */
+static void check_changes(const Recording* rec, int count, const char* path, const char* from_home,
+                          const char* to_home) {
+    Recording replayed;
+    if (access(path, F_OK) != 0) {
+        fprintf(stderr, "replay: warning: the shell didn't record its session, so its directory "
+                        "and environment weren't checked\n");
+        return;
+    }
+    if (read_recording(path, &replayed) != 0) return;
+    int differ = 0;
+    for (int i = 0; i < count && i < replayed.num_commands; i++) {
+        const Command* a = &rec->commands[i];
+        const Command* b = &replayed.commands[i];
+        int same = a->num_changes == b->num_changes;
+        for (int k = 0; same && k < a->num_changes; k++) {
+            char* expected = map_home(a->changes[k], from_home, to_home);
+            same = strcmp(expected, b->changes[k]) == 0;
+            free(expected);
+        }
+        if (!same && differ++ == 0) {
+            fprintf(stderr, "replay: warning: before command %d (%s), the directory or environment "
+                            "changed differently than recorded\n", i + 1, a->name);
+            print_changes("recorded", a);
+            print_changes("replayed", b);
+        }
+    }
+    if (differ > 1) {
+        fprintf(stderr, "replay: warning: and before %d more commands\n", differ - 1);
+    }
+}
+
+/**
+ * @brief Runs `shell` on a new pty, with echo off so that its output is only
+ * what it writes. @return The pty's master side, or -1.
+ */
+static int start_shell(const char* shell, pid_t* pid_out) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("replay: pty");
+        return -1;
+    }
+    char* slave_name = ptsname(master);
+    if (!slave_name) {
+        perror("replay: ptsname");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("replay: fork");
+        return -1;
+    }
+    if (pid == 0) {
+        setsid(); // The pty becomes our controlling terminal when we open it
+        int slave = open(slave_name, O_RDWR);
+        if (slave < 0) {
+            perror("replay: open pty");
+            _exit(127);
+        }
+        struct termios t;
+        if (tcgetattr(slave, &t) == 0) {
+            t.c_lflag &= ~(ECHO | ECHONL);
+            tcsetattr(slave, TCSANOW, &t);
+        }
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        close(master);
+        execl(shell, shell, (char*)NULL);
+        perror(shell);
+        _exit(127);
+    }
+    *pid_out = pid;
+    return master;
+}
+
+/**
+ * @brief Reads the shell's output until a prompt shows up.
+ * @return 0 at a prompt, 1 if the shell went away, -1 after `timeout_ms`.
+ */
+static int wait_for_prompt(int master, int timeout_ms) {
+    static const char prompt[] = PROMPT_END;
+    const size_t prompt_len = sizeof(prompt) - 1;
+    char window[4096 + sizeof(prompt)];
+    size_t kept = 0; // A possible start of the prompt, left from the last read
+    double deadline = now_ns() + timeout_ms * 1e6;
+
+    while (1) {
+        int left_ms = (int)((deadline - now_ns()) / 1e6);
+        if (left_ms <= 0) return -1;
+        struct pollfd p = {master, POLLIN, 0};
+        int ready = poll(&p, 1, left_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        if (ready == 0) return -1;
+
+        ssize_t n = read(master, window + kept, sizeof(window) - kept);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 1; // EIO once the shell has exited
+        size_t len = kept + (size_t)n;
+        if (memmem(window, len, prompt, prompt_len) != NULL) {
+            return 0;
+        }
+        kept = len < prompt_len - 1 ? len : prompt_len - 1;
+        memmove(window, window + len - kept, kept);
+    }
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int double_comparator(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values.
+static double percentile(const double* sorted, int n, double p) {
+    int rank = (int)(p * n + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static double mad_of(const double* sorted, int n, double median) {
+    double deviations[n];
+    for (int i = 0; i < n; i++) {
+        double d = sorted[i] - median;
+        deviations[i] = d < 0 ? -d : d;
+    }
+    qsort(deviations, n, sizeof(double), double_comparator);
+    return percentile(deviations, n, 0.5);
+}
+
+static Group* find_group(Group** groups, int* count, const char* name) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp((*groups)[i].name, name) == 0) return &(*groups)[i];
+    }
+    *groups = xrealloc(*groups, (*count + 1) * sizeof(Group));
+    Group* g = &(*groups)[(*count)++];
+    memset(g, 0, sizeof(*g));
+    g->name = name;
+    return g;
+}
+
+static void add_sample(double** values, int* count, double value) {
+    *values = xrealloc(*values, (*count + 1) * sizeof(double));
+    (*values)[(*count)++] = value;
+}
+
+static void print_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void report(Group* groups, int num_groups, const char* version) {
+    fprintf(stderr, "%-16s %6s %10s %10s %10s %10s %12s\n",
+            "command", "count", "p50 ms", "p90 ms", "p99 ms", "max ms", "recorded p50");
+    printf("{\n  \"suite\": \"roy-shell-replay\",\n  \"version\": ");
+    print_json_string(stdout, version);
+    printf(",\n  \"timestamp\": %ld,\n  \"unit\": \"ns\",\n  \"results\": [\n", (long)time(NULL));
+
+    int printed = 0;
+    for (int i = 0; i < num_groups; i++) {
+        Group* g = &groups[i];
+        if (g->count == 0) continue;
+        qsort(g->replayed_ns, g->count, sizeof(double), double_comparator);
+        double* v = g->replayed_ns;
+        double median = percentile(v, g->count, 0.5);
+        fprintf(stderr, "%-16s %6d %10.3f %10.3f %10.3f %10.3f", g->name, g->count, median / 1e6,
+                percentile(v, g->count, 0.9) / 1e6, percentile(v, g->count, 0.99) / 1e6,
+                v[g->count - 1] / 1e6);
+        if (g->recorded_count > 0) {
+            qsort(g->recorded_ns, g->recorded_count, sizeof(double), double_comparator);
+            fprintf(stderr, " %12.3f\n", percentile(g->recorded_ns, g->recorded_count, 0.5) / 1e6);
+        } else {
+            fprintf(stderr, " %12s\n", "-");
+        }
+
+        printf("%s    {\"name\": ", printed++ ? ",\n" : "");
+        char name[256];
+        snprintf(name, sizeof(name), "replay/%s", g->name);
+        print_json_string(stdout, name);
+        printf(", \"median\": %.1f, \"mad\": %.1f, \"min\": %.1f, \"max\": %.1f, "
+               "\"p90\": %.1f, \"p99\": %.1f, \"count\": %d}",
+               median, mad_of(v, g->count, median), v[0], v[g->count - 1],
+               percentile(v, g->count, 0.9), percentile(v, g->count, 0.99), g->count);
+    }
+    printf("\n  ]\n}\n");
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    if (remove(path) != 0) perror(path);
+    return 0; // Remove as much as we can
+}
+
+// Removes the scratch $HOME and whatever the session left in it.
+static void remove_home(const char* home) {
+    nftw(home, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+int main(int argc, char** argv) {
+    const char* shell = "./shell";
+    const char* version = NULL;
+    const char* recording = NULL;
+    int max_speed = 0;
+    int timeout = DEFAULT_TIMEOUT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-speed") == 0) {
+            max_speed = 1;
+        } else if (strcmp(argv[i], "--shell") == 0 && i + 1 < argc) {
+            shell = argv[++i];
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--version") == 0 && i + 1 < argc) {
+            version = argv[++i];
+        } else if (argv[i][0] != '-' && !recording) {
+            recording = argv[i];
+        } else {
+            recording = NULL;
+            break;
+        }
+    }
+    if (!recording || timeout <= 0) {
+        fprintf(stderr, "Usage: %s [--max-speed] [--shell PATH] [--timeout SECONDS] "
+                        "[--version LABEL] RECORDING\n", argv[0]);
+        return 2;
+    }
+
+    char shell_path[PATH_MAX];
+    if (!realpath(shell, shell_path)) { // The shell starts elsewhere
+        perror(shell);
+        return 1;
+    }
+    Recording rec;
+    if (read_recording(recording, &rec) != 0) return 1;
+    Command* commands = rec.commands;
+    int num_commands = rec.num_commands;
+    if (rec.start_dir[0] && chdir(rec.start_dir) != 0) {
+        fprintf(stderr, "replay: warning: can't start in %s: %s\n", rec.start_dir, strerror(errno));
+    }
+    char home[] = "/tmp/roy_shell_replay.XXXXXX";
+    if (!mkdtemp(home)) {
+        perror("replay: mkdtemp");
+        return 1;
+    }
+    const char* recorded_home = recorded_env(&rec, "HOME");
+    if (rec.env_count > 0) {
+        use_recorded_env(&rec);
+    } else {
+        fprintf(stderr, "replay: warning: no environment recorded; using this one\n");
+    }
+    char check_path[sizeof(home) + 16];
+    snprintf(check_path, sizeof(check_path), "%s/replay.record", home);
+    setenv("HOME", home, 1);
+    setenv("ROY_SHELL_RECORD", check_path, 1); // Not over the recording
+
+    pid_t pid;
+    int master = start_shell(shell_path, &pid);
+    if (master < 0) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    Group* groups = NULL;
+    int num_groups = 0;
+    Group* all = find_group(&groups, &num_groups, "(all)");
+    int status = wait_for_prompt(master, timeout * 1000);
+    int done = 0;
+    for (; done < num_commands && status == 0; done++) {
+        Command* c = &commands[done];
+        double sent = 0;
+        for (int l = 0; l < c->num_lines && status == 0; l++) {
+            if (!max_speed) sleep_us(c->delays_us[l]);
+            sent = now_ns();
+            if (write_all(master, c->lines[l], strlen(c->lines[l])) != 0) status = 1;
+        }
+        if (status == 0) status = wait_for_prompt(master, timeout * 1000);
+        if (status != 0) break; // `exit`, or a command that never finished
+
+        double latency = now_ns() - sent;
+        Group* g = find_group(&groups, &num_groups, c->name);
+        all = &groups[0]; // find_group() may have moved it
+        add_sample(&g->replayed_ns, &g->count, latency);
+        add_sample(&all->replayed_ns, &all->count, latency);
+        if (c->recorded_us >= 0) {
+            add_sample(&g->recorded_ns, &g->recorded_count, c->recorded_us * 1e3);
+            add_sample(&all->recorded_ns, &all->recorded_count, c->recorded_us * 1e3);
+        }
+    }
+    if (status < 0) {
+        fprintf(stderr, "replay: no prompt after %d s at command %d (%s); stopping\n",
+                timeout, done + 1, done < num_commands ? commands[done].name : "start");
+    } else if (done < num_commands && strcmp(commands[done].name, "exit") != 0) {
+        fprintf(stderr, "replay: the shell exited at command %d (%s)\n", done + 1, commands[done].name);
+    }
+
+    if (status == 0) {
+        write_all(master, "\004", 1); // End of input: the shell logs out
+        wait_for_prompt(master, timeout * 1000);
+    }
+    close(master); // Hangs up on whatever is still running
+    waitpid(pid, NULL, 0);
+    check_changes(&rec, done, check_path, recorded_home, home);
+    remove_home(home);
+
+    fprintf(stderr, "replayed %d of %d commands from %s%s\n", groups[0].count, num_commands, recording,
+            max_speed ? " at maximum speed" : "");
+    report(groups, num_groups, version ? version : shell);
+    return status < 0 ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Compares `reveal -R` against `find` on a synthetic tree.
+#
+# Usage: bench/reveal_recursive.sh [dirs_per_level] [files_per_dir] [runs]
+# The first run of each tool warms the dentry/inode cache and is discarded.
+# Set REVEAL_THREADS to pin the worker count when measuring scaling.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+FANOUT=${1:-20}
+FILES=${2:-50}
+RUNS=${3:-5}
+TREE=${TMPDIR:-/tmp}/reveal_bench_tree
+
+if [ ! -x "$SHELL_BIN" ]; then
+    echo "build the shell first (make)" >&2
+    exit 1
+fi
+
+# Three levels of $FANOUT directories with $FILES files each.
+if [ ! -d "$TREE" ]; then
+    echo "creating tree in $TREE ..." >&2
+    for a in $(seq 1 "$FANOUT"); do
+        for b in $(seq 1 "$FANOUT"); do
+            for c in $(seq 1 "$FANOUT"); do
+                d="$TREE/a$a/b$b/c$c"
+                mkdir -p "$d"
+                (cd "$d" && seq 1 "$FILES" | sed 's/^/f/' | xargs touch)
+            done
+        done
+    done
+fi
+
+now() {
+    date +%s.%N
+}
+
+time_cmd() {
+    best=""
+    i=0
+    while [ "$i" -le "$RUNS" ]; do
+        start=$(now)
+        "$@" >/dev/null 2>&1
+        end=$(now)
+        if [ "$i" -gt 0 ]; then
+            best=$(awk -v s="$start" -v e="$end" -v b="$best" \
+                'BEGIN { t = e - s; if (b == "" || t < b) b = t; printf "%.4f", b }')
+        fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+run_reveal() {
+    echo "reveal -Ra $TREE" | "$SHELL_BIN"
+}
+
+entries=$(find "$TREE" | wc -l)
+reveal_t=$(time_cmd run_reveal)
+find_t=$(time_cmd find "$TREE")
+
+rate() {
+    awk -v n="$1" -v t="$2" 'BEGIN { printf "%.0f", (t > 0) ? n / t : 0 }'
+}
+
+printf "entries:   %d\n" "$entries"
+printf "reveal -R: %ss (%s entries/s)\n" "$reveal_t" "$(rate "$entries" "$reveal_t")"
+printf "find:      %ss (%s entries/s)\n" "$find_t" "$(rate "$entries" "$find_t")"
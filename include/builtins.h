@@ -0,0 +1,56 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdint.h>
+
+#include "shell_plugin.h"
+
+typedef void (*BuiltinFn)(char** args);
+
+enum {
+    BUILTIN_PARENT   = 1 << 0, // Must run in the shell process when run alone
+    BUILTIN_PIPELINE = 1 << 1, // Safe to run as a pipeline stage (in a child)
+    BUILTIN_STDIN    = 1 << 2, // May read stdin, so it needs a child (and job
+                               // control) when stdin is a terminal
+    BUILTIN_WAITS    = 1 << 3  // May block for long, so it needs a child that
+                               // Ctrl-Z can stop when stdin is a terminal
+};
+
+typedef struct {
+    const char* name;
+    BuiltinFn fn;
+    int flags;
+    ShellPluginFn plugin; // Set instead of fn for builtins loaded by `enable -f`
+} Builtin;
+
+// Looks a builtin up by name: the built-in table in constant time, then
+// any loaded plugins. NULL if there is none.
+const Builtin* find_builtin(const char* name);
+
+// Runs a builtin and returns its exit status.
+int run_builtin(const Builtin* builtin, char** args);
+
+// Counts a run of `builtin` for shellstat. run_builtin() counts its own;
+// this is for the parent to count one it forked a child to run.
+void count_builtin_call(const Builtin* builtin);
+// The name of builtin `i` (plugins come last, as one) with its run count
+// in *calls, or NULL past the end.
+const char* builtin_calls(int i, unsigned long* calls);
+
+// Sets the exit status of the builtin being run (0 unless it calls this).
+void set_builtin_status(int status);
+
+void execute_exit(char** args);
+
+// The hash behind the builtin table's perfect hash. Shared with the
+// generator in tools/, which picks a seed without collisions.
+static inline uint32_t builtin_hash(const char* name, uint32_t seed) {
+    uint32_t h = seed;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+#endif
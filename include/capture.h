@@ -0,0 +1,25 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// Output capture for background jobs (`jobs capture on`): a job's stdout and
+// stderr go into a pipe that a shell thread drains into a bounded per-job
+// ring, so the job never waits on the terminal and its output doesn't land
+// on top of the prompt.
+
+// Returns the write end of a new capture pipe, with its read end in
+// *read_fd, or -1 if capture is off or no capture slot is free.
+int capture_open(int* read_fd);
+// Starts draining `read_fd` as job `job_id`'s output. Takes the fd.
+void capture_attach(int job_id, int read_fd);
+
+// For fg: writes what job `job_id` captured so far to stdout, then passes
+// its further output straight through (`follow`), or captures it again.
+void capture_follow(int job_id, int follow);
+// For fg, once job `job_id` has exited: lets the output still in its pipe
+// through (waiting up to a moment for the pipe to close), then stops
+// following it.
+void capture_settle(int job_id);
+
+void execute_jobs(char** args);
+
+#endif
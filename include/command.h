@@ -2,16 +2,24 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
-#define MAX_ARGS 64       // Max arguments for a single command
+#define INITIAL_ARGS 8    // Initial argument slots; the list grows as needed
 #define MAX_PIPED_CMDS 16 // Max commands in a single pipeline
 
+struct HereDoc; // See heredoc.h
+
 // Represents one command in a pipeline (e.g., "grep foo")
 typedef struct {
-    char* args[MAX_ARGS];  // Argument list like {"grep", "foo", NULL}
+    char** args;           // Argument list like {"grep", "foo", NULL}
     char* input_file;      // Redirect stdin from this file
     char* output_file;     // Redirect stdout to this file
+    char* here_delim;      // Delimiter of a <<DELIM here-document
+    char* here_string;     // Word of a <<<word here-string
+    struct HereDoc* here_doc; // Body that becomes stdin, once read
     int   append_mode;       // Flag for append mode (>>)
     int   arg_count;       // Number of arguments
+    int   arg_capacity;    // Slots allocated in args, including the NULL terminator
+    char** assignments;    // Leading NAME=value words, set aside by expansion
+    int   assignment_count;
 } SimpleCommand;
 
 typedef enum {
@@ -24,12 +32,19 @@ typedef struct {
     SimpleCommand commands[MAX_PIPED_CMDS];
     int num_commands;
     JobMode mode;
+    double timeout;         // From a `timeout` prefix: seconds to run (0 for none)
+    int timeout_signal;     // Sent when the timeout passes
+    double timeout_grace;   // Seconds from that signal to SIGKILL (0 for none)
 } CommandPipeline;
 
 // Function prototype for the new parser
 CommandPipeline* parse_commands(char* input);
 // Function to free the memory used by the pipeline
 void free_pipeline(CommandPipeline* pipeline);
+// Deep copy of a pipeline as parsed, before expansion, to run it again.
+CommandPipeline* copy_pipeline(const CommandPipeline* pipeline);
+// Appends an argument (taking ownership) and keeps the list NULL-terminated.
+int append_arg(SimpleCommand* cmd, char* arg);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef COREUTILS_H
+#define COREUTILS_H
+
+// In-process versions of small coreutils, compatible with their common flags.
+// `command NAME ...` still runs the external binary.
+void execute_echo(char** args);
+void execute_printf(char** args);
+void execute_true(char** args);
+void execute_false(char** args);
+void execute_cat(char** args);
+void execute_head(char** args);
+void execute_wc(char** args);
+void execute_sleep(char** args);
+
+// Parses a sleep-style duration, NUMBER[smhd], into seconds. Returns -1 if
+// it isn't one.
+int parse_duration(const char* word, double* seconds);
+
+#endif
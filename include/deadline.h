@@ -0,0 +1,35 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <sys/types.h>
+
+#include "command.h"
+
+// Job deadlines: `timeout DUR pipeline` and `deadline JOB DUR`. When a
+// deadline passes, the job's process group gets a signal (SIGTERM unless
+// told otherwise), then SIGKILL after a grace period.
+
+// Strips a leading `timeout [-s SIG] [-k DUR] DUR` from the pipeline's
+// first command into its timeout fields. Returns -1 after printing an error.
+int deadline_take_prefix(CommandPipeline* pipeline);
+
+// Starts the countdown for process group `pgid`.
+void deadline_add(pid_t pgid, double seconds, int sig, double grace);
+// The job led by `pgid` is over: drops its deadline, unless the deadline
+// already passed and SIGKILL is still due for stragglers in the group.
+// Returns 1 if the deadline had passed.
+int deadline_cancel(pid_t pgid);
+
+// The timerfd to poll for deadlines (readable when one is due), or -1 if
+// none is pending.
+int deadline_fd(void);
+// Signals every job whose deadline has passed. Cheap if none has.
+void deadline_expire(void);
+
+// waitpid() that keeps enforcing deadlines while it blocks. Other signals
+// interrupt it just as they would interrupt waitpid().
+pid_t deadline_waitpid(pid_t pid, int* status, int options);
+
+void execute_deadline(char** args);
+
+#endif
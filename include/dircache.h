@@ -0,0 +1,51 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+// A sorted directory listing shared through the cache. Treat it as read-only
+// and hand it back with dircache_release() when done.
+typedef struct DirListing {
+    char** names;          // Sorted, NULL-terminated; includes "." and ".."
+    unsigned char* types;  // d_type of each name (DT_UNKNOWN if the fs doesn't say)
+    int count;
+
+    // --- Cache bookkeeping, private to dircache.c ---
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;     // Directory mtime when the listing was read
+    struct timespec read_time; // Wall-clock time of the read, for racy-mtime checks
+    size_t bytes;              // Memory charged against the cache budget
+    int refcount;
+    int in_cache;
+    int wd;                    // inotify watch descriptor, -1 if none
+    int stale;                 // Set by inotify when the directory changed
+    struct DirListing* lru_prev;
+    struct DirListing* lru_next;
+    struct DirListing* hash_next;
+} DirListing;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long invalidations; // Cached listings found out of date
+    size_t bytes;
+    size_t budget;
+    int listings;
+    int inotify_enabled;
+} DirCacheStats;
+
+DirListing* dircache_get(const char* path);
+void dircache_release(DirListing* listing);
+void dircache_clear(void);
+void dircache_set_budget(size_t bytes);
+int dircache_set_inotify(int enabled);
+void dircache_get_stats(DirCacheStats* stats);
+
+// The 'dircache' built-in: show statistics, clear, or tune the cache.
+void execute_dircache(char** args);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <stddef.h>
+
+// Records a visit to an absolute directory path in the persistent database.
+void frecency_add_visit(const char* path);
+
+// Finds the best-ranked directory matching a fuzzy query, skipping `exclude`
+// (usually the current directory). Returns 1 and fills `out` on a match.
+int frecency_query(const char* query, const char* exclude, char* out, size_t out_size);
+
+// Drops a directory from the database, e.g. because it no longer exists.
+void frecency_remove(const char* path);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef HEREDOC_H
+#define HEREDOC_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "command.h"
+
+// Contents of a here-document or here-string, waiting to become some
+// command's stdin. Small bodies stay in memory and go through a pipe;
+// anything bigger is written straight into a sealed memfd.
+typedef struct HereDoc {
+    char* data;   // In-memory body, NULL once it has moved to the memfd
+    size_t len;
+    size_t cap;
+    int memfd;    // -1 while the body is still in memory
+} HereDoc;
+
+// Reads the bodies of all `<<DELIM` here-documents in a parsed command line
+// from `in`, one after the other. Returns -1 on error.
+int read_here_docs(CommandPipeline** sequence, int count, FILE* in);
+
+// Turns each `<<<word` here-string into a here-document (after expansion).
+int prepare_here_strings(CommandPipeline* pipeline);
+
+// Returns a fresh read-only fd positioned at the start of the body.
+int here_doc_open(const HereDoc* doc);
+
+// A copy that shares nothing with `doc` but its (sealed) memfd's contents.
+HereDoc* copy_here_doc(const HereDoc* doc);
+void free_here_doc(HereDoc* doc);
+
+// Copies the bodies of the here-documents that `line` starts, delimiter
+// lines included, from `in` to `out`: for command lines that continue on
+// the next lines, whose bodies come before the rest of the command.
+int copy_here_doc_bodies(const char* line, FILE* in, FILE* out);
+
+#endif
@@ -4,9 +4,11 @@
 #include "command.h" // For CommandPipeline
 
 CommandPipeline** parse_command_sequence(char* input, int* sequence_count);
+// Parses `atomic (| atomic)*` into an empty pipeline. Returns 0 on a syntax error.
+int parse_cmd_group(char** str, CommandPipeline* pipeline);
 void free_pipeline_sequence(CommandPipeline** sequence, int count);
 int isValidShellCommand(char* input);
 int match_token(char** str, const char* token);
 void skip_whitespace(char** str);
-int parse_name(char** str);
+int parse_name(char** str, char** name_buffer);
 #endif
\ No newline at end of file
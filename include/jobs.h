@@ -3,12 +3,13 @@
 
 #include <sys/types.h>
 
-#define MAX_JOBS 20
+#define MAX_JOBS 64
 
 // NEW: An enum to represent the state of a job.
 typedef enum {
     JOB_RUNNING,
-    JOB_STOPPED
+    JOB_STOPPED,
+    JOB_QUEUED   // Waiting in the scheduler's queue; not started yet
 } JobStatus;
 
 // Represents a background job being tracked by the shell
@@ -22,8 +23,17 @@ typedef struct {
 // --- Function Prototypes ---
 void init_jobs();
 void add_job(pid_t pgid, const char* command_line);
+// Adds a job that already has a number (one started from the queue), silently.
+void add_job_with_id(pid_t pgid, const char* command_line, int job_id);
+int allocate_job_id(void);
+// Handles the exit of child `pid`. Returns the number of the job it led,
+// with its exit status in *exit_status, or 0 if it wasn't a job leader.
+int job_finished(pid_t pid, int status, int* exit_status);
 void reap_finished_jobs();
-void execute_activities(); // <-- ADD THIS new function prototype
+int count_running_jobs(void);
+int has_free_job_slot(void);
+void execute_activities(char** args);
+int get_active_jobs(Job* out); // Fills up to MAX_JOBS entries, returns the count
 
 // Part E.3
 Job* get_job_by_pgid(pid_t pgid);
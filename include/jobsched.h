@@ -0,0 +1,33 @@
+#ifndef JOBSCHED_H
+#define JOBSCHED_H
+
+#include "command.h"
+#include "jobs.h"
+
+// Sets the running-job limit to the number of online CPUs.
+void init_jobsched(void);
+
+// 1 if a new background job may start now rather than queue.
+int jobsched_can_start(void);
+// Queues a background pipeline, taking over its contents (the caller's
+// copy is left empty).
+void jobsched_enqueue(CommandPipeline* pipeline, const char* command_line);
+// Starts queued jobs while the limit allows.
+void jobsched_start_queued(void);
+
+int jobsched_queue_length(void);
+// Copies up to `max` queued jobs into `out` as JOB_QUEUED entries.
+int jobsched_get_queued_jobs(Job* out, int max);
+void jobsched_clear(void);
+
+// Before reading a line: enforces due deadlines and, from a terminal, keeps
+// doing so and starting queued jobs as running ones finish, until input
+// arrives.
+void jobsched_wait_for_input(void);
+// At end of input: blocks until every queued job has been started.
+void jobsched_drain(void);
+
+void execute_wait(char** args);
+void execute_sched(char** args);
+
+#endif
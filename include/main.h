@@ -1,18 +1,25 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <signal.h>
+
 struct shell_info
 {
     char username[40];
     char systemname[40];
     char home[1000];
     char cwd[1000];
+    pid_t pid; // The shell's own, also in its forked children
 };
 extern struct shell_info info; // extern indicates its defined in another file
 
 extern volatile pid_t foreground_pgid;
+// Set by Ctrl-C, so that loops stop instead of starting their next command.
+extern volatile sig_atomic_t interrupted;
 
 void init_shell(struct shell_info* info);
-void process_command_line(char* line, int add_to_history);
+void process_command_line(const char* line, int add_to_history);
+// Runs `line` in a forked child (a `$(...)`, say) and exits with its status.
+void run_subshell_line(const char* line) __attribute__((noreturn));
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <sys/types.h>
+
+#include "command.h"
+
+// `memo [-f FILE]... [-e NAME]... pipeline`: runs a deterministic pipeline
+// once, then replays its stdout from an on-disk store for as long as its
+// key (the words of the pipeline, the cwd, PATH and the named variables,
+// and the size, mtime and inode of the named files) stays the same.
+
+typedef struct Memo Memo;
+
+// Strips a leading `memo` prefix from an expanded foreground pipeline and
+// computes its key into *memo (NULL if there was none, or if the pipeline
+// can't be memoized). Returns -1 after printing an error.
+int memo_take_prefix(CommandPipeline* pipeline, Memo** memo);
+// On a hit, writes the stored output where the pipeline's would go, sets
+// $? to 0 and returns 1. Returns 0 on a miss.
+int memo_replay(Memo* memo, CommandPipeline* pipeline);
+// On a miss, before forking: returns the fd the last command's stdout
+// should go to, or -1 (after printing why) to run without recording.
+int memo_record(Memo* memo, CommandPipeline* pipeline);
+// After forking: starts copying that output to where it belongs and into
+// the store, in the job's process group `pgid`.
+void memo_start(Memo* memo, pid_t pgid);
+// Once the pipeline exited (or stopped): keeps its output if it exited
+// with `status` 0. Frees `memo`, which may be NULL.
+void memo_finish(Memo* memo, int stopped, int status);
+
+// This session's lookups: hits replayed and misses run (for shellstat).
+void memo_get_stats(unsigned long long* hit_count, unsigned long long* miss_count);
+
+void execute_memo(char** args);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef NDJSON_H
+#define NDJSON_H
+
+// Newline-delimited JSON for the builtins' --json modes: one object per
+// entry, one per line, written through the builtin output buffer (see
+// output.h), so a listing of any length is streamed in a few block writes
+// without holding all of it.
+//
+//   for each entry: ndjson_begin(); ndjson_string("name", ...); ndjson_end();
+//   if (ndjson_finish() != 0) ... // The write error is in errno
+//
+// Strings are escaped as JSON requires; bytes that aren't ASCII are passed
+// through as they are, so names that aren't UTF-8 stay byte-exact.
+
+void ndjson_begin(void);
+void ndjson_string(const char* key, const char* value); // NULL is written as null
+void ndjson_int(const char* key, long long value);
+void ndjson_uint(const char* key, unsigned long long value);
+void ndjson_end(void);
+// Writes out what is left. Returns -1 if any write failed.
+int ndjson_finish(void);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+// Buffered stdout for builtins. Output collects in one large buffer that
+// goes out in block writes: when it fills, when the builtin returns (see
+// run_builtin()), before a fork, and, while stdout is a terminal, at the
+// end of each line so that interactive output appears as it is produced.
+// Stdio's own buffer is flushed before a builtin's first write here, so
+// its output keeps its place; a builtin that writes here shouldn't also
+// use printf() on stdout.
+
+#define OUT_IOV_MAX 64 // Most iovecs out_writev() takes at once
+
+void out_write(const char* data, size_t len);
+void out_puts(const char* s); // Like fputs(): no newline is added
+void out_putc(char c);
+void out_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+// Writes strings that stay put (a listing's arena, say) without copying
+// them when they don't fit: the buffer and the strings go out in one
+// writev(). Small ones are just copied.
+void out_writev(const struct iovec* iov, int count);
+
+// Writes out the buffer, then anything left in stdio's. Returns -1, with
+// errno set, if a write failed since the last call; output is dropped
+// after a failure, the way a closed pipe would drop it.
+int out_flush(void);
+// Ends a builtin's output: flushes, and rechecks at the next write whether
+// stdout is a terminal (it may have been redirected in between).
+int out_end(void);
+
+#endif
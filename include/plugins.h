@@ -0,0 +1,14 @@
+#ifndef PLUGINS_H
+#define PLUGINS_H
+
+#include "builtins.h"
+
+// Builtin loaded by `enable -f`, or NULL.
+const Builtin* find_plugin_builtin(const char* name);
+
+// Runs a loaded builtin on the current stdin/stdout/stderr.
+int run_plugin_builtin(const Builtin* builtin, char** args);
+
+void execute_enable(char** args);
+
+#endif
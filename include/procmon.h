@@ -0,0 +1,9 @@
+#ifndef PROCMON_H
+#define PROCMON_H
+
+// `activities --watch [-i secs] [-n count]`: live per-job CPU, memory, I/O
+// and thread counts, sampled from /proc.
+// `activities --once [-i secs]`: a single sample as tab-separated lines.
+void execute_activities_monitor(char** args);
+
+#endif
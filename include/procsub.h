@@ -0,0 +1,25 @@
+#ifndef PROCSUB_H
+#define PROCSUB_H
+
+#include <sys/types.h>
+
+// Process substitution: <(cmd) and >(cmd).
+//
+// Expansion starts each substituted command right away, connected to the
+// shell by a pipe, and puts "/dev/fd/N" in the word; the command that
+// uses it inherits fd N when it is forked.
+
+// Starts `command` with its stdout (or, with `writes` set, its stdin) on a
+// pipe. Returns the malloc'd "/dev/fd/N" path, or NULL on error.
+char* procsub_open(const char* command, int writes);
+// 1 if substitutions are waiting for the command that uses them.
+int procsub_pending(void);
+// Once the command has been forked (or run in the shell): closes the
+// shell's ends of the pipes and, if `pgid` > 0, moves the substituted
+// commands into that process group so job control reaches them.
+void procsub_close(pid_t pgid);
+// Waits for the substituted commands (`block`), or leaves them to the
+// background job reaper. Either way, forgets them.
+void procsub_finish(int block);
+
+#endif
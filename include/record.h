@@ -0,0 +1,46 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+// Session recording, for replaying real workloads with bench/shell_replay.
+// ROY_SHELL_RECORD=file logs every line the shell reads from stdin, with
+// where it ran and what it changed, one record per line:
+//
+//   roy-shell-record 1        header
+//   d <us> <path>             the working directory, at the start and
+//                             whenever it changed before a command
+//   e <us> NAME=value         an exported variable: each one at the start,
+//                             then whenever it was set or changed
+//   u <us> NAME               an exported variable went away
+//   c <us> <line>             a line that starts a command
+//   m <us> <line>             more of it: a continuation or here-doc line
+//   r <us> <status>           the command finished
+//
+// <us> is the time in microseconds since the previous record, so the
+// numbers stay short. Text runs to the end of the line, with `\` and
+// newlines escaped as `\\` and `\n`.
+//
+// Since it holds the whole exported environment, a recording is as private
+// as that environment.
+
+// Non-zero while recording; checked inline, like trace_enabled.
+extern int record_enabled;
+
+void record_input_line(const char* line, int starts_command);
+void record_command_done(int status);
+
+// `line` as read from stdin, trailing newline and all. A line that starts a
+// command is preceded by the cwd and environment changes since the last.
+static inline void record_input(const char* line, int starts_command) {
+    if (__builtin_expect(record_enabled, 0)) record_input_line(line, starts_command);
+}
+
+static inline void record_done(int status) {
+    if (__builtin_expect(record_enabled, 0)) record_command_done(status);
+}
+
+// Starts recording if ROY_SHELL_RECORD names a file. Call after
+// init_vars(), so that the environment recorded first is the one the shell
+// exports.
+void record_init_from_env(void);
+
+#endif
@@ -1,6 +1,31 @@
 #ifndef REVEAL_H
 #define REVEAL_H
 
+#include <linux/stat.h> // struct statx, usable without _GNU_SOURCE
+
+// Sort orders for reveal: by name (default), size or modification time.
+typedef enum {
+    SORT_NAME,
+    SORT_SIZE,
+    SORT_MTIME
+} RevealSort;
+
+// One directory entry together with the metadata gathered for the long listing.
+typedef struct {
+    char* name;
+    struct statx stx;
+    int stat_ok;          // 1 if statx() succeeded for this entry
+    unsigned char d_type; // Type reported by readdir (DT_UNKNOWN if not known)
+} RevealEntry;
+
 void execute_reveal(char** args);
 
-#endif
\ No newline at end of file
+// Uncached read of a directory: a sorted, NULL-terminated array the caller frees.
+char** list_and_sort_files(const char* path);
+void print_files(char* const* files, int show_hidden, int line_by_line);
+
+void stat_entry(int dirfd, RevealEntry* entry);
+void sort_entries(RevealEntry* entries, int count, RevealSort sort);
+void print_long_entry(const RevealEntry* entry);
+
+#endif
@@ -1,7 +1,14 @@
 #ifndef ROUTE_H
 #define ROUTE_H
 
+#include <sys/types.h>
+
 #include "command.h"
 void execute_pipeline(CommandPipeline* pipeline, const char* original_command);
+// Forks an already expanded pipeline in the background as job `job_id`.
+// Returns its pgid, or -1.
+pid_t start_background_pipeline(CommandPipeline* pipeline, int job_id);
+// Pipelines forked from now on join process group `pgid` (0: each its own).
+void set_job_group(pid_t pgid);
 
 #endif
\ No newline at end of file
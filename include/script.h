@@ -0,0 +1,22 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "command.h"
+
+// Command lines as trees: lists (`;`, `&`), `&&`/`||`, and the compound
+// commands `if`, `while`/`until` and `for`, over pipelines.
+
+typedef struct ScriptNode ScriptNode;
+
+// Parses a command line. Returns NULL on a syntax error, and also sets
+// *incomplete if the line merely ended inside a compound command (or right
+// after `&&`, `||` or `|`), so more lines could finish it.
+ScriptNode* script_parse(char* text, int* incomplete);
+// The tree's pipelines in source order (for here-document bodies), in a
+// malloc'd array the caller frees. Returns the count, or -1.
+int script_pipelines(ScriptNode* tree, CommandPipeline*** out);
+// Runs a tree and returns its exit status. `text` names the jobs it starts.
+int script_run(ScriptNode* tree, const char* text);
+void script_free(ScriptNode* tree);
+
+#endif
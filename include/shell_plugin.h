@@ -0,0 +1,55 @@
+#ifndef SHELL_PLUGIN_H
+#define SHELL_PLUGIN_H
+
+/*
+ * Plugin ABI for loadable builtins (`enable -f lib.so name`).
+ *
+ * A plugin is a shared object that defines
+ *
+ *     const ShellPlugin shell_plugin = {SHELL_PLUGIN_ABI_VERSION, "name", builtins};
+ *
+ * where `builtins` is an array of ShellPluginBuiltin ending in {NULL}. Each
+ * builtin runs inside the shell (or inside the forked child, for a pipeline
+ * stage) and must do its I/O through the fds in its context, not through
+ * stdio, since it may share the process with the shell. It returns the exit
+ * status. This header is the whole interface: plugins don't link against
+ * anything in the shell.
+ *
+ * Compatibility: fields are only ever appended to ShellPluginContext, and
+ * `size` says how much of it the running shell filled in.
+ */
+
+#include <stddef.h>
+
+#define SHELL_PLUGIN_ABI_VERSION 1
+#define SHELL_PLUGIN_SYMBOL "shell_plugin"
+
+typedef struct ShellPluginContext {
+    int abi_version;   // The shell's SHELL_PLUGIN_ABI_VERSION
+    size_t size;       // sizeof(ShellPluginContext) in the shell
+    int argc;
+    char** argv;       // argv[0] is the builtin's name; NULL-terminated
+    int in_fd;
+    int out_fd;
+    int err_fd;
+    void* (*alloc)(size_t size);
+    void* (*resize)(void* ptr, size_t size);
+    void (*release)(void* ptr);
+    const char* (*get_var)(const char* name); // Shell variable, or NULL
+} ShellPluginContext;
+
+typedef int (*ShellPluginFn)(ShellPluginContext* ctx);
+
+typedef struct {
+    const char* name;
+    ShellPluginFn fn;
+    const char* usage; // One line, shown by `enable`
+} ShellPluginBuiltin;
+
+typedef struct {
+    int abi_version;   // SHELL_PLUGIN_ABI_VERSION the plugin was built against
+    const char* name;
+    const ShellPluginBuiltin* builtins;
+} ShellPlugin;
+
+#endif
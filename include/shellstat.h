@@ -0,0 +1,29 @@
+#ifndef SHELLSTAT_H
+#define SHELLSTAT_H
+
+// Counters for `shellstat`. They are plain integers bumped in place, with
+// no locking, and only the shell process's own are kept: whatever a forked
+// child counts (a pipeline stage, a backgrounded loop) is lost when it exits,
+// so forks, execs and builtins in children are counted by the parent as it
+// forks them.
+typedef struct {
+    unsigned long command_lines;   // Lines run by process_command_line()
+    unsigned long parses;          // script_parse() calls on those lines
+    unsigned long long parse_ns;   // Time spent in them
+    unsigned long pipelines;       // execute_pipeline() calls
+    unsigned long forks;           // Every fork(), for commands or helpers
+    unsigned long execs;           // Commands forked to run an external program
+    unsigned long long history_bytes; // Written to the history file
+    unsigned long reveal_entries;  // Names listed by reveal
+    unsigned long jobs_started;    // Background jobs, including ones from the queue
+    unsigned long jobs_queued;     // Background jobs that had to wait for a slot
+    unsigned long jobs_finished;   // Background jobs reaped
+} ShellStats;
+
+extern ShellStats shellstat;
+
+// `shellstat [--json]`: prints the counters, the current jobs by state and
+// the hit rates of the directory and memo caches.
+void execute_shellstat(char** args);
+
+#endif
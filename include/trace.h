@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Non-zero while tracing. Checked inline so that disabled tracing costs a
+// single predictable branch per span.
+extern int trace_enabled;
+
+typedef struct {
+    const char* name;
+    uint64_t start_ns; // 0 when tracing was off at trace_begin()
+} TraceSpan;
+
+uint64_t trace_now_ns(void);
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, const char* detail);
+void trace_record_instant(const char* name, const char* detail);
+void trace_record_exec(const char* detail);
+
+static inline TraceSpan trace_begin(const char* name) {
+    TraceSpan span = {name, 0};
+    if (__builtin_expect(trace_enabled, 0)) span.start_ns = trace_now_ns();
+    return span;
+}
+
+// Records the span; `detail` (may be NULL) is shown as its argument.
+static inline void trace_end(TraceSpan span, const char* detail) {
+    if (__builtin_expect(span.start_ns != 0, 0)) {
+        trace_record(span.name, span.start_ns, trace_now_ns(), detail);
+    }
+}
+
+static inline void trace_instant(const char* name, const char* detail) {
+    if (__builtin_expect(trace_enabled, 0)) trace_record_instant(name, detail);
+}
+
+// Marks a forked child about to exec `detail`; its buffer is handed back.
+static inline void trace_exec(const char* detail) {
+    if (__builtin_expect(trace_enabled, 0)) trace_record_exec(detail);
+}
+
+// Starts recording; the trace is written to `path` by trace_stop().
+int trace_start(const char* path);
+// Writes the Chrome trace-event JSON file and stops recording.
+int trace_stop(void);
+// Starts tracing if ROY_SHELL_TRACE names an output file. The trace is
+// written when the shell exits.
+void trace_init_from_env(void);
+
+void execute_trace(char** args);
+
+#endif
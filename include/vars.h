@@ -0,0 +1,38 @@
+#ifndef VARS_H
+#define VARS_H
+
+#include "command.h"
+
+void init_vars(void);
+
+const char* vars_get(const char* name);
+int vars_set(const char* name, const char* value);
+int vars_export(const char* name);
+void vars_unset(const char* name);
+
+// Points `environ` at an up-to-date snapshot of the exported variables.
+// Cheap when nothing exported has changed since the last call.
+void vars_sync_environ(void);
+
+// Exit status of the last foreground pipeline, for $?.
+void set_last_status(int status);
+int get_last_status(void);
+
+// Returns 1 for words of the form NAME=value.
+int is_assignment(const char* word);
+// Applies NAME=value words as shell variables (exported if `export` is set).
+void apply_assignments(char** assignments, int count, int export);
+
+// Runs `command` in a forked copy of the shell and returns its stdout, with
+// trailing newlines removed. The caller frees the result.
+char* command_substitution(const char* command);
+
+// Expands $VAR, ${VAR}, $?, $$, $(...), <(...) and >(...) in a command's
+// words and moves leading NAME=value words into cmd->assignments. Returns
+// -1 on error.
+int expand_command_words(SimpleCommand* cmd);
+
+void execute_export(char** args);
+void execute_unset(char** args);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include "reveal.h" // For RevealEntry and RevealSort
+
+// One directory in the tree built by walk_tree().
+typedef struct WalkNode {
+    char* path;                 // Path as it should be displayed
+    char* name;                 // Last path component, opened relative to the parent
+    struct WalkNode* parent;
+    int fd;                     // Directory fd, kept open while children still need it
+    int pending_children;       // Children that have not yet opened themselves via fd
+    int error;                  // errno from opening/reading this directory, 0 on success
+
+    RevealEntry* entries;       // Sorted entries of this directory
+    int count;
+    struct WalkNode** children; // Subdirectories, in the same order as in entries
+    int child_count;
+} WalkNode;
+
+typedef struct {
+    int show_hidden;  // List (and descend into) dot entries
+    int want_stat;    // Gather statx metadata for every entry
+    RevealSort sort;
+    int max_threads;  // 0 means one worker per online CPU
+} WalkOptions;
+
+typedef struct {
+    long entries;     // Entries listed across all directories
+    long directories; // Directories read
+    int threads;      // Worker threads used
+} WalkStats;
+
+WalkNode* walk_tree(const char* root, const WalkOptions* options, WalkStats* stats);
+void free_walk_tree(WalkNode* root);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "command.h"
+
+// `watch [-r] [-m MAX] [-d DUR] PATH... -- pipeline`: runs the pipeline,
+// then again each time something under the paths changes, until Ctrl-C.
+// Bursts of changes within DUR of each other (0.1s unless given) make one
+// run, and a run still going when changes arrive is cancelled first.
+
+// Handles a pipeline that starts with `watch`, before its words are
+// expanded (each run expands them afresh). Returns 0 if it doesn't.
+int watch_run(CommandPipeline* pipeline, const char* original_command);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef WILDCARD_H
+#define WILDCARD_H
+
+#include "command.h"
+
+// A compiled pattern for one path component, e.g. "*.log" or "[a-c]?".
+typedef struct GlobPattern GlobPattern;
+
+int has_glob_chars(const char* word);
+
+GlobPattern* glob_compile(const char* component);
+int glob_match(const GlobPattern* pattern, const char* name);
+void glob_free(GlobPattern* pattern);
+
+// Expands a full pattern (supports `*`, `?`, `[...]` and `**`) into a sorted,
+// NULL-terminated array of matching paths, or NULL if nothing matched.
+char** glob_expand(const char* pattern, int* count);
+void free_glob_results(char** results, int count);
+
+// Replaces every wildcard argument of a command with its matches, in place.
+// Arguments that match nothing are left as they were.
+int expand_command_globs(SimpleCommand* cmd);
+
+#endif
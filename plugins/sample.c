@@ -0,0 +1,277 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Custom headers
+#include "shell_plugin.h"
+
+/*
+ * Sample plugin: `enable -f plugins/sample.so` adds
+ *
+ *   jsonfield KEY      prints the top-level KEY of each JSON object on stdin,
+ *                      one per line (or "null" if it's missing)
+ *   fnvhash [STR...]   prints the 64-bit FNV-1a hash of each STR, or of stdin
+ *
+ * Built with -DSHELL_PLUGIN_STANDALONE the same code becomes a multi-call
+ * executable (`sample-tool jsonfield KEY`), which is what the benchmarks
+ * compare the in-process builtins against.
+ */
+
+#define OUT_BUF 8192
+#define LINE_MAX_LEN 65536
+
+typedef struct {
+    int fd;
+    size_t len;
+    char data[OUT_BUF];
+} Out;
+
+static int out_flush(Out* out) {
+    size_t done = 0;
+    while (done < out->len) {
+        ssize_t n = write(out->fd, out->data + done, out->len - done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+static void out_write(Out* out, const char* s, size_t len) {
+    while (len > 0) {
+        if (out->len == OUT_BUF) {
+            out_flush(out);
+        }
+        size_t n = OUT_BUF - out->len < len ? OUT_BUF - out->len : len;
+        memcpy(out->data + out->len, s, n);
+        out->len += n;
+        s += n;
+        len -= n;
+    }
+}
+
+static void out_str(Out* out, const char* s) {
+    out_write(out, s, strlen(s));
+}
+
+static void err_str(ShellPluginContext* ctx, const char* s) {
+    ssize_t ignored = write(ctx->err_fd, s, strlen(s));
+    (void)ignored;
+}
+
+/**
+ * @brief Returns the end of the JSON value starting at `p`, or NULL if it
+ * isn't terminated within `end`.
+ */
+static const char* skip_value(const char* p, const char* end) {
+    if (p < end && *p == '"') {
+        for (p++; p < end; p++) {
+            if (*p == '\\') {
+                p++;
+            } else if (*p == '"') {
+                return p + 1;
+            }
+        }
+        return NULL;
+    }
+    int depth = 0;
+    for (; p < end; p++) {
+        if (*p == '"') {
+            const char* q = skip_value(p, end);
+            if (q == NULL) {
+                return NULL;
+            }
+            p = q - 1;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0) {
+                return p;
+            }
+            depth--;
+        } else if (*p == ',' && depth == 0) {
+            return p;
+        }
+    }
+    return depth == 0 ? p : NULL;
+}
+
+static const char* skip_space(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Writes the value of top-level `key` in the object at [p, end).
+ */
+static void emit_field(Out* out, const char* key, size_t key_len, const char* p, const char* end) {
+    p = skip_space(p, end);
+    if (p == end || *p != '{') {
+        out_str(out, "null\n");
+        return;
+    }
+    p = skip_space(p + 1, end);
+    while (p < end && *p == '"') {
+        const char* name_end = skip_value(p, end);
+        if (name_end == NULL) {
+            break;
+        }
+        const char* name = p + 1;
+        size_t name_len = (size_t)(name_end - 1 - name);
+        p = skip_space(name_end, end);
+        if (p == end || *p != ':') {
+            break;
+        }
+        const char* value = skip_space(p + 1, end);
+        const char* value_end = skip_value(value, end);
+        if (value_end == NULL) {
+            break;
+        }
+        if (name_len == key_len && memcmp(name, key, key_len) == 0) {
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+                value_end--;
+            }
+            // Strings are printed without their quotes, like `jq -r`.
+            if (value_end - value >= 2 && *value == '"') {
+                out_write(out, value + 1, (size_t)(value_end - value - 2));
+            } else {
+                out_write(out, value, (size_t)(value_end - value));
+            }
+            out_write(out, "\n", 1);
+            return;
+        }
+        p = skip_space(value_end, end);
+        if (p < end && *p == ',') {
+            p = skip_space(p + 1, end);
+        }
+    }
+    out_str(out, "null\n");
+}
+
+static int jsonfield(ShellPluginContext* ctx) {
+    if (ctx->argc != 2) {
+        err_str(ctx, "jsonfield: usage: jsonfield KEY\n");
+        return 2;
+    }
+    const char* key = ctx->argv[1];
+    size_t key_len = strlen(key);
+    char* buf = ctx->alloc(LINE_MAX_LEN);
+    Out* out = ctx->alloc(sizeof(Out));
+    if (buf == NULL || out == NULL) {
+        ctx->release(buf);
+        ctx->release(out);
+        err_str(ctx, "jsonfield: out of memory\n");
+        return 1;
+    }
+    out->fd = ctx->out_fd;
+    out->len = 0;
+
+    // Lines are split out of a read buffer; one longer than it is skipped.
+    size_t have = 0;
+    int skipping = 0;
+    for (;;) {
+        ssize_t n = read(ctx->in_fd, buf + have, LINE_MAX_LEN - have);
+        if (n < 0) {
+            break;
+        }
+        size_t total = have + (size_t)n;
+        size_t start = 0;
+        for (size_t i = have; i < total; i++) {
+            if (buf[i] == '\n') {
+                if (!skipping && i > start) {
+                    emit_field(out, key, key_len, buf + start, buf + i);
+                }
+                skipping = 0;
+                start = i + 1;
+            }
+        }
+        if (n == 0) {
+            if (!skipping && total > start) {
+                emit_field(out, key, key_len, buf + start, buf + total);
+            }
+            break;
+        }
+        have = total - start;
+        memmove(buf, buf + start, have);
+        if (have == LINE_MAX_LEN) {
+            skipping = 1;
+            have = 0;
+        }
+    }
+    int status = out_flush(out) == 0 ? 0 : 1;
+    ctx->release(buf);
+    ctx->release(out);
+    return status;
+}
+
+static uint64_t fnv1a(uint64_t h, const unsigned char* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void emit_hash(Out* out, uint64_t h) {
+    char line[24];
+    int len = snprintf(line, sizeof(line), "%016llx\n", (unsigned long long)h);
+    out_write(out, line, (size_t)len);
+}
+
+static int fnvhash(ShellPluginContext* ctx) {
+    const uint64_t basis = 14695981039346656037ull;
+    Out out = {ctx->out_fd, 0, {0}};
+    if (ctx->argc > 1) {
+        for (int i = 1; i < ctx->argc; i++) {
+            const char* s = ctx->argv[i];
+            emit_hash(&out, fnv1a(basis, (const unsigned char*)s, strlen(s)));
+        }
+    } else {
+        unsigned char buf[8192];
+        uint64_t h = basis;
+        ssize_t n;
+        while ((n = read(ctx->in_fd, buf, sizeof(buf))) > 0) {
+            h = fnv1a(h, buf, (size_t)n);
+        }
+        emit_hash(&out, h);
+    }
+    return out_flush(&out) == 0 ? 0 : 1;
+}
+
+static const ShellPluginBuiltin sample_builtins[] = {
+    {"jsonfield", jsonfield, "jsonfield KEY  -- print KEY from each JSON line on stdin"},
+    {"fnvhash", fnvhash, "fnvhash [STRING...]  -- 64-bit FNV-1a hash of the arguments or stdin"},
+    {NULL, NULL, NULL}
+};
+
+const ShellPlugin shell_plugin = {SHELL_PLUGIN_ABI_VERSION, "sample", sample_builtins};
+
+#ifdef SHELL_PLUGIN_STANDALONE
+#include <stdlib.h>
+
+static const char* get_env(const char* name) {
+    return getenv(name);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s jsonfield KEY | fnvhash [STRING...]\n", argv[0]);
+        return 2;
+    }
+    for (int i = 0; sample_builtins[i].name != NULL; i++) {
+        if (strcmp(sample_builtins[i].name, argv[1]) == 0) {
+            ShellPluginContext ctx = {SHELL_PLUGIN_ABI_VERSION, sizeof(ShellPluginContext),
+                                      argc - 1, argv + 1, 0, 1, 2,
+                                      malloc, realloc, free, get_env};
+            return sample_builtins[i].fn(&ctx);
+        }
+    }
+    fprintf(stderr, "%s: unknown command '%s'\n", argv[0], argv[1]);
+    return 2;
+}
+#endif
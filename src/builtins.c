@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Custom headers
+#include "builtins.h"
+#include "builtin_hash.h" // Generated at build time
+#include "hop.h"
+#include "log.h"
+#include "reveal.h"
+#include "jobs.h"
+#include "ping.h"
+#include "fg_bg.h"
+#include "dircache.h"
+#include "vars.h"
+#include "trace.h"
+#include "plugins.h"
+#include "coreutils.h"
+#include "jobsched.h"
+#include "capture.h"
+#include "deadline.h"
+#include "memo.h"
+#include "shellstat.h"
+#include "output.h"
+
+static const Builtin builtin_table[] = {
+#define BUILTIN(name, fn, flags) {#name, fn, flags, NULL},
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#define BUILTIN_COUNT (int)(sizeof(builtin_table) / sizeof(builtin_table[0]))
+
+static int builtin_status = 0;
+// Runs of each table entry, by index, and of all plugins together.
+static unsigned long builtin_runs[BUILTIN_COUNT];
+static unsigned long plugin_runs = 0;
+
+/**
+ * @brief Finds a builtin through the generated perfect hash: the slot gives
+ * the only candidate, and one strcmp confirms it.
+ */
+const Builtin* find_builtin(const char* name) {
+    uint32_t slot = builtin_hash(name, BUILTIN_HASH_SEED) & ((1u << BUILTIN_HASH_BITS) - 1);
+    int idx = builtin_slots[slot];
+    if (idx >= 0 && strcmp(builtin_table[idx].name, name) == 0) {
+        return &builtin_table[idx];
+    }
+    return find_plugin_builtin(name);
+}
+
+void count_builtin_call(const Builtin* builtin) {
+    if (builtin->plugin) {
+        plugin_runs++;
+    } else {
+        builtin_runs[builtin - builtin_table]++;
+    }
+}
+
+const char* builtin_calls(int i, unsigned long* calls) {
+    if (i < BUILTIN_COUNT) {
+        *calls = builtin_runs[i];
+        return builtin_table[i].name;
+    }
+    if (i == BUILTIN_COUNT) {
+        *calls = plugin_runs;
+        return "(plugins)";
+    }
+    return NULL;
+}
+
+int run_builtin(const Builtin* builtin, char** args) {
+    count_builtin_call(builtin);
+    if (builtin->plugin) {
+        return run_plugin_builtin(builtin, args);
+    }
+    builtin_status = 0;
+    builtin->fn(args);
+    // Whatever the builtin left in the output buffer goes out now.
+    if (out_end() != 0) {
+        fprintf(stderr, "%s: write error: %s\n", builtin->name, strerror(errno));
+        if (builtin_status == 0) builtin_status = 1;
+    }
+    return builtin_status;
+}
+
+void set_builtin_status(int status) {
+    builtin_status = status;
+}
+
+/**
+ * @brief Implements `exit [status]`. In a pipeline this only ends the child.
+ */
+void execute_exit(char** args) {
+    exit(args[1] ? atoi(args[1]) : 0);
+}
@@ -0,0 +1,459 @@
+#define _GNU_SOURCE // For memfd_create(), pipe2() and eventfd()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+// Custom headers
+#include "capture.h"
+#include "builtins.h"
+#include "output.h"
+
+/*
+ * Bounded per-job output capture.
+ *
+ * Each captured job writes into a pipe whose read end belongs to one drain
+ * thread, which polls all of them and appends whatever arrives to the job's
+ * ring. Rings live on the heap and grow from RING_INITIAL up to RING_MAX
+ * while the shared heap budget allows; every captured job's heap ring
+ * counts against that one budget, and finished jobs' captures are evicted,
+ * oldest first, to make room. A job that outgrows its heap ring, or can't
+ * get budget for it, spills into a memfd ring of up to SPILL_LIMIT bytes.
+ * Memfd rings have their own budget, SPILL_BUDGET, which they reserve in
+ * full when they spill, again evicting finished captures to make room; if
+ * that leaves no more than the heap ring had, the job stays where it is.
+ * Either way a ring keeps the newest output and counts what it dropped.
+ *
+ * Stored bytes are addressed by their offset in the job's output stream:
+ * byte `x` lives at `x % capacity`, and the ring holds the last
+ * min(total, capacity) bytes.
+ */
+
+#define MAX_CAPTURES 64
+#define RING_INITIAL (4 * 1024)
+#define RING_MAX (256 * 1024)
+#define SPILL_LIMIT (16 * 1024 * 1024)
+#define SPILL_BUDGET (64 * 1024 * 1024)
+#define DEFAULT_BUDGET (4 * 1024 * 1024)
+#define DRAIN_CHUNK (64 * 1024)
+#define SETTLE_NS (200 * 1000 * 1000L) // How long fg waits for a finished job's last output
+
+typedef struct {
+    int used;
+    int job_id;
+    int fd;                   // Read end of the job's pipe; -1 once it closed
+    int follow;               // In the foreground: also copy output to stdout
+    char* ring;               // Heap ring, NULL when empty or spilled
+    size_t ring_cap;
+    int spill_fd;             // memfd ring, -1 until spilled
+    size_t spill_cap;         // Its size, reserved from SPILL_BUDGET
+    unsigned long long total; // Bytes the job has written
+    unsigned long seq;        // Attach order, for evicting the oldest
+} Capture;
+
+static Capture captures[MAX_CAPTURES];
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capture_closed = PTHREAD_COND_INITIALIZER;
+static pthread_once_t capture_once = PTHREAD_ONCE_INIT;
+static int wake_fd = -1;      // eventfd: the set of pipes changed
+static int enabled = 0;
+static size_t budget = DEFAULT_BUDGET;
+static size_t heap_used = 0;
+static size_t spill_used = 0;
+static unsigned long next_seq = 0;
+
+static size_t capacity(const Capture* c) {
+    return c->spill_fd >= 0 ? c->spill_cap : c->ring_cap;
+}
+
+static size_t stored(const Capture* c) {
+    size_t cap = capacity(c);
+    return c->total < cap ? (size_t)c->total : cap;
+}
+
+/**
+ * @brief Copies `len` stored bytes starting at stream offset `from` into
+ * `out`. The range must be stored.
+ */
+static int ring_read(const Capture* c, unsigned long long from, char* out, size_t len) {
+    size_t cap = capacity(c);
+    while (len > 0) {
+        size_t pos = (size_t)(from % cap);
+        size_t n = cap - pos < len ? cap - pos : len;
+        if (c->spill_fd >= 0) {
+            if (pread(c->spill_fd, out, n, (off_t)pos) != (ssize_t)n) return -1;
+        } else {
+            memcpy(out, c->ring + pos, n);
+        }
+        out += n;
+        from += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Stores `data` as the bytes at stream offset `total` onwards.
+static void ring_write(Capture* c, const char* data, size_t len) {
+    size_t cap = capacity(c);
+    if (cap == 0) {
+        c->total += len;
+        return;
+    }
+    if (len > cap) { // Only the newest `cap` bytes can be kept
+        c->total += len - cap;
+        data += len - cap;
+        len = cap;
+    }
+    while (len > 0) {
+        size_t pos = (size_t)(c->total % cap);
+        size_t n = cap - pos < len ? cap - pos : len;
+        if (c->spill_fd >= 0) {
+            if (pwrite(c->spill_fd, data, n, (off_t)pos) != (ssize_t)n) n = len; // Lost
+        } else {
+            memcpy(c->ring + pos, data, n);
+        }
+        c->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void release(Capture* c) {
+    if (c->fd >= 0) close(c->fd);
+    if (c->spill_fd >= 0) close(c->spill_fd);
+    heap_used -= c->ring_cap;
+    spill_used -= c->spill_cap;
+    free(c->ring);
+    memset(c, 0, sizeof(*c));
+    c->fd = c->spill_fd = -1;
+}
+
+/**
+ * @brief Frees the oldest finished capture other than `keep`; with
+ * `spilled`, the oldest finished one in a memfd.
+ * @return 0, or -1 if there was none.
+ */
+static int evict_finished(const Capture* keep, int spilled) {
+    Capture* oldest = NULL;
+    for (int i = 0; i < MAX_CAPTURES; i++) {
+        Capture* c = &captures[i];
+        if (c->used && c->fd < 0 && c != keep && (!spilled || c->spill_fd >= 0) &&
+            (!oldest || c->seq < oldest->seq)) {
+            oldest = c;
+        }
+    }
+    if (!oldest) return -1;
+    release(oldest);
+    return 0;
+}
+
+// Takes `bytes` more of the heap budget, evicting finished captures if needed.
+static int reserve_heap(const Capture* keep, size_t bytes) {
+    while (heap_used + bytes > budget) {
+        if (evict_finished(keep, 0) != 0) return -1;
+    }
+    heap_used += bytes;
+    return 0;
+}
+
+/**
+ * @brief Takes up to SPILL_LIMIT bytes of the spill budget, evicting
+ * finished spilled captures if needed.
+ * @return The bytes taken, or 0 if no more than `min` were free.
+ */
+static size_t reserve_spill(const Capture* keep, size_t min) {
+    while (spill_used + SPILL_LIMIT > SPILL_BUDGET && evict_finished(keep, 1) == 0) {
+    }
+    size_t available = SPILL_BUDGET - spill_used;
+    size_t bytes = available < SPILL_LIMIT ? available : SPILL_LIMIT;
+    if (bytes <= min) return 0;
+    spill_used += bytes;
+    return bytes;
+}
+
+/**
+ * @brief Moves the stored bytes into a new ring of `new_cap` bytes: on the
+ * heap, or with `spill_fd` >= 0, in that memfd. The caller settles
+ * heap_used and spill_used.
+ */
+static int relayout(Capture* c, size_t new_cap, int spill_fd) {
+    size_t keep = stored(c);
+    char* old = malloc(keep ? keep : 1);
+    char* ring = spill_fd < 0 ? malloc(new_cap) : NULL;
+    if (!old || (spill_fd < 0 && !ring) || ring_read(c, c->total - keep, old, keep) != 0) {
+        free(old);
+        free(ring);
+        return -1;
+    }
+    free(c->ring);
+    c->ring = ring;
+    c->ring_cap = spill_fd < 0 ? new_cap : 0;
+    c->spill_cap = spill_fd < 0 ? 0 : new_cap;
+    c->spill_fd = spill_fd;
+    c->total -= keep;
+    ring_write(c, old, keep);
+    free(old);
+    return 0;
+}
+
+/**
+ * @brief Makes room for `incoming` more bytes: grow the heap ring within
+ * the budget, else spill to a memfd within the spill budget, else let the
+ * ring overwrite itself.
+ */
+static void make_room(Capture* c, size_t incoming) {
+    if (c->spill_fd >= 0) return;
+    size_t want = stored(c) + incoming;
+    while (c->ring_cap < want && c->ring_cap < RING_MAX) {
+        size_t old_cap = c->ring_cap;
+        size_t new_cap = old_cap ? old_cap * 2 : RING_INITIAL;
+        if (reserve_heap(c, new_cap - old_cap) != 0) break;
+        if (relayout(c, new_cap, -1) != 0) {
+            heap_used -= new_cap - old_cap;
+            break;
+        }
+    }
+    if (c->ring_cap >= want) return;
+    size_t spill_cap = reserve_spill(c, c->ring_cap);
+    if (spill_cap == 0) return;
+    int fd = memfd_create("roy-shell-job-output", MFD_CLOEXEC);
+    size_t old_cap = c->ring_cap;
+    if (fd < 0 || relayout(c, spill_cap, fd) != 0) {
+        if (fd >= 0) close(fd);
+        spill_used -= spill_cap;
+        return;
+    }
+    heap_used -= old_cap;
+}
+
+static void append(Capture* c, const char* data, size_t len) {
+    if (c->follow) {
+        for (size_t done = 0; done < len;) {
+            ssize_t n = write(STDOUT_FILENO, data + done, len - done);
+            if (n < 0 && errno != EINTR) break;
+            if (n > 0) done += (size_t)n;
+        }
+    }
+    make_room(c, len);
+    ring_write(c, data, len);
+}
+
+static void* drain_thread(void* arg) {
+    static char chunk[DRAIN_CHUNK];
+    for (;;) {
+        struct pollfd fds[MAX_CAPTURES + 1];
+        int owner[MAX_CAPTURES + 1];
+        int nfds = 0;
+        fds[nfds++] = (struct pollfd){wake_fd, POLLIN, 0};
+        pthread_mutex_lock(&capture_lock);
+        for (int i = 0; i < MAX_CAPTURES; i++) {
+            if (captures[i].used && captures[i].fd >= 0) {
+                owner[nfds] = i;
+                fds[nfds++] = (struct pollfd){captures[i].fd, POLLIN, 0};
+            }
+        }
+        pthread_mutex_unlock(&capture_lock);
+
+        if (poll(fds, (nfds_t)nfds, -1) < 0) continue;
+        if (fds[0].revents) {
+            uint64_t ignored;
+            ssize_t r = read(wake_fd, &ignored, sizeof(ignored));
+            (void)r;
+        }
+        for (int k = 1; k < nfds; k++) {
+            if (!fds[k].revents) continue;
+            ssize_t n = read(fds[k].fd, chunk, sizeof(chunk));
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            pthread_mutex_lock(&capture_lock);
+            Capture* c = &captures[owner[k]];
+            if (c->fd == fds[k].fd) {
+                if (n > 0) {
+                    append(c, chunk, (size_t)n);
+                } else {
+                    close(c->fd); // Every writer has exited
+                    c->fd = -1;
+                    pthread_cond_broadcast(&capture_closed);
+                }
+            }
+            pthread_mutex_unlock(&capture_lock);
+        }
+    }
+    return NULL;
+}
+
+// A child forked while the drain thread held the lock would inherit it held.
+static void before_fork(void) { pthread_mutex_lock(&capture_lock); }
+static void after_fork(void) { pthread_mutex_unlock(&capture_lock); }
+
+static void start_drain_thread(void) {
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    pthread_t thread;
+    if (wake_fd < 0 || pthread_create(&thread, NULL, drain_thread, NULL) != 0) {
+        perror("jobs: capture thread");
+        enabled = 0;
+        return;
+    }
+    pthread_detach(thread);
+    pthread_atfork(before_fork, after_fork, after_fork);
+}
+
+static Capture* find_capture(int job_id) {
+    for (int i = 0; i < MAX_CAPTURES; i++) {
+        if (captures[i].used && captures[i].job_id == job_id) return &captures[i];
+    }
+    return NULL;
+}
+
+// A free slot, evicting the oldest finished capture if all are taken.
+static Capture* free_slot(void) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < MAX_CAPTURES; i++) {
+            if (!captures[i].used) return &captures[i];
+        }
+        if (evict_finished(NULL, 0) != 0) break;
+    }
+    return NULL;
+}
+
+int capture_open(int* read_fd) {
+    if (!enabled) return -1;
+    pthread_once(&capture_once, start_drain_thread);
+    pthread_mutex_lock(&capture_lock);
+    int available = enabled && free_slot() != NULL;
+    pthread_mutex_unlock(&capture_lock);
+    int fds[2];
+    if (!available || pipe2(fds, O_CLOEXEC) < 0) return -1;
+    *read_fd = fds[0];
+    return fds[1];
+}
+
+void capture_attach(int job_id, int read_fd) {
+    pthread_mutex_lock(&capture_lock);
+    Capture* c = free_slot();
+    if (c == NULL) {
+        pthread_mutex_unlock(&capture_lock);
+        close(read_fd);
+        return;
+    }
+    memset(c, 0, sizeof(*c));
+    c->used = 1;
+    c->job_id = job_id;
+    c->fd = read_fd;
+    c->spill_fd = -1;
+    c->seq = next_seq++;
+    pthread_mutex_unlock(&capture_lock);
+    uint64_t one = 1;
+    ssize_t r = write(wake_fd, &one, sizeof(one));
+    (void)r;
+}
+
+// Writes everything `c` holds to stdout, noting any dropped prefix.
+static void print_capture(const Capture* c) {
+    size_t len = stored(c);
+    if (c->total > len) {
+        fprintf(stderr, "[... %llu bytes dropped ...]\n", c->total - len);
+    }
+    char* data = malloc(len ? len : 1);
+    if (data && ring_read(c, c->total - len, data, len) == 0) {
+        fwrite(data, 1, len, stdout);
+    }
+    free(data);
+    fflush(stdout);
+}
+
+void capture_follow(int job_id, int follow) {
+    pthread_mutex_lock(&capture_lock);
+    Capture* c = find_capture(job_id);
+    if (c) {
+        // Under the lock, so no output is both replayed and passed through.
+        if (follow && !c->follow) print_capture(c);
+        c->follow = follow;
+    }
+    pthread_mutex_unlock(&capture_lock);
+}
+
+void capture_settle(int job_id) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += SETTLE_NS;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&capture_lock);
+    Capture* c = find_capture(job_id);
+    while (c && c->used && c->job_id == job_id && c->fd >= 0 &&
+           pthread_cond_timedwait(&capture_closed, &capture_lock, &deadline) == 0) {
+    }
+    if (c && c->used && c->job_id == job_id) {
+        c->follow = 0;
+    }
+    pthread_mutex_unlock(&capture_lock);
+}
+
+static void print_usage_line(const Capture* c) {
+    out_printf("[%d] %s  %zu bytes in %s", c->job_id, c->fd >= 0 ? "running" : "done   ",
+               stored(c), c->spill_fd >= 0 ? "memfd" : "memory");
+    if (c->total > stored(c)) out_printf(", %llu dropped", c->total - stored(c));
+    out_printf("\n");
+}
+
+/**
+ * @brief Implements `jobs` (capture status), `jobs capture on|off`,
+ * `jobs budget <bytes>` and `jobs output <job>`.
+ */
+void execute_jobs(char** args) {
+    if (args[1] == NULL) {
+        pthread_mutex_lock(&capture_lock);
+        out_printf("capture: %s\n", enabled ? "on" : "off");
+        out_printf("memory: %zu / %zu bytes\n", heap_used, budget);
+        out_printf("memfd: %zu / %zu bytes\n", spill_used, (size_t)SPILL_BUDGET);
+        for (int i = 0; i < MAX_CAPTURES; i++) {
+            if (captures[i].used) print_usage_line(&captures[i]);
+        }
+        pthread_mutex_unlock(&capture_lock);
+    } else if (strcmp(args[1], "capture") == 0 && args[2] != NULL) {
+        int on = strcmp(args[2], "on") == 0;
+        if (!on && strcmp(args[2], "off") != 0) {
+            fprintf(stderr, "jobs: expected 'on' or 'off'\n");
+            set_builtin_status(1);
+            return;
+        }
+        enabled = on; // Jobs already started keep their destination
+    } else if (strcmp(args[1], "budget") == 0 && args[2] != NULL) {
+        char* end;
+        unsigned long long bytes = strtoull(args[2], &end, 10);
+        if (*end != '\0' || bytes < RING_INITIAL) {
+            fprintf(stderr, "jobs: invalid budget '%s'\n", args[2]);
+            set_builtin_status(1);
+            return;
+        }
+        pthread_mutex_lock(&capture_lock);
+        budget = (size_t)bytes;
+        while (heap_used > budget && evict_finished(NULL, 0) == 0) {
+        }
+        pthread_mutex_unlock(&capture_lock);
+    } else if (strcmp(args[1], "output") == 0 && args[2] != NULL) {
+        int job_id = atoi(args[2][0] == '%' ? args[2] + 1 : args[2]);
+        pthread_mutex_lock(&capture_lock);
+        Capture* c = find_capture(job_id);
+        if (c) {
+            print_capture(c);
+        }
+        pthread_mutex_unlock(&capture_lock);
+        if (!c) {
+            fprintf(stderr, "jobs: no captured output for job %s\n", args[2]);
+            set_builtin_status(1);
+        }
+    } else {
+        fprintf(stderr, "jobs: invalid argument. Usage: jobs [capture on|off | budget <bytes> | output <job>]\n");
+        set_builtin_status(1);
+    }
+}
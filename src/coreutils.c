@@ -0,0 +1,975 @@
+#define _GNU_SOURCE // For splice() and copy_file_range()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Custom headers
+#include "coreutils.h"
+#include "builtins.h"
+#include "output.h"
+#include "main.h" // For interrupted
+
+/*
+ * Native echo, printf, true, false, cat, head, wc and sleep.
+ *
+ * These run in the shell itself when alone and in the forked child as a
+ * pipeline stage, so the common case costs no fork/exec at all. Output and
+ * error messages follow GNU coreutils in the C locale for the flags handled
+ * here; anything more exotic needs `command NAME` to get the real binary.
+ * Output goes through the builtin output buffer (output.h), which is
+ * flushed before anything is written to the fd directly (cat's and head's
+ * copies) and before messages on stderr that should follow it.
+ */
+
+#define COPY_CHUNK (128 * 1024)
+
+static const char* input_name(const char* file) {
+    return strcmp(file, "-") == 0 ? "standard input" : file;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// --- echo and printf ---
+
+/**
+ * @brief Prints the backslash escape that starts at `p` (just past the
+ * backslash), the way coreutils does for echo -e, printf's format and %b.
+ * With `octal_0`, \0NNN takes up to three digits after the 0 (echo, %b).
+ * Sets *stop on \c, which ends all output.
+ * @return The first character after the escape.
+ */
+static const char* put_escape(const char* p, int octal_0, int* stop) {
+    int c;
+    switch (*p) {
+    case 'a': c = '\a'; break;
+    case 'b': c = '\b'; break;
+    case 'e': c = 27; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+    case 'v': c = '\v'; break;
+    case '\\': c = '\\'; break;
+    case 'c':
+        *stop = 1;
+        return p + 1;
+    case 'x':
+        if (!isxdigit((unsigned char)p[1])) {
+            out_putc('\\');
+            return p;
+        }
+        c = 0;
+        p++;
+        for (int n = 0; n < 2 && isxdigit((unsigned char)*p); n++, p++) {
+            c = c * 16 + (isdigit((unsigned char)*p) ? *p - '0' : tolower((unsigned char)*p) - 'a' + 10);
+        }
+        out_putc(c);
+        return p;
+    case '0': case '1': case '2': case '3':
+    case '4': case '5': case '6': case '7':
+        if (octal_0 && *p == '0') {
+            p++;
+        }
+        c = 0;
+        for (int n = 0; n < 3 && *p >= '0' && *p <= '7'; n++, p++) {
+            c = c * 8 + (*p - '0');
+        }
+        out_putc(c & 0xff);
+        return p;
+    default:
+        // Not an escape: keep the backslash, the character follows as is.
+        out_putc('\\');
+        return p;
+    }
+    out_putc(c);
+    return p + 1;
+}
+
+// Prints `s` with escapes decoded. Returns 1 if \c stopped the output.
+static int put_escaped(const char* s, int octal_0) {
+    int stop = 0;
+    while (*s && !stop) {
+        if (*s == '\\') {
+            s = put_escape(s + 1, octal_0, &stop);
+        } else {
+            out_putc(*s++);
+        }
+    }
+    return stop;
+}
+
+/**
+ * @brief Implements `echo [-neE] [string...]`. Like coreutils, an argument
+ * is only an option if it is made entirely of n, e and E.
+ */
+void execute_echo(char** args) {
+    int i = 1;
+    int newline = 1, escapes = 0;
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        const char* opts = args[i] + 1;
+        if (strspn(opts, "neE") != strlen(opts)) {
+            break;
+        }
+        for (; *opts; opts++) {
+            if (*opts == 'n') newline = 0;
+            else if (*opts == 'e') escapes = 1;
+            else escapes = 0;
+        }
+    }
+    for (int first = i; args[i]; i++) {
+        if (i > first) {
+            out_putc(' ');
+        }
+        if (!escapes) {
+            out_puts(args[i]);
+        } else if (put_escaped(args[i], 1)) {
+            out_flush();
+            return;
+        }
+    }
+    if (newline) {
+        out_putc('\n');
+    }
+    out_flush();
+}
+
+/**
+ * @brief Checks how much of a numeric printf argument was converted and
+ * reports it like coreutils. Returns 0 if the whole argument was used.
+ */
+static int check_numeric_arg(const char* arg, const char* end) {
+    if (end == arg) {
+        fprintf(stderr, "printf: '%s': expected a numeric value\n", arg);
+    } else if (errno == ERANGE) {
+        fprintf(stderr, "printf: '%s': %s\n", arg, strerror(ERANGE));
+    } else if (*end != '\0') {
+        fprintf(stderr, "printf: '%s': value not completely converted\n", arg);
+    } else {
+        return 0;
+    }
+    return -1;
+}
+
+// A leading quote makes the value the next character's code, as in POSIX.
+static int is_char_constant(const char* arg) {
+    return (arg[0] == '\'' || arg[0] == '"') && arg[1] != '\0';
+}
+
+static long long signed_arg(const char* arg, int* status) {
+    if (is_char_constant(arg)) return (unsigned char)arg[1];
+    if (*arg == '\0') return 0;
+    char* end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 0);
+    if (check_numeric_arg(arg, end) != 0) *status = 1;
+    return value;
+}
+
+static unsigned long long unsigned_arg(const char* arg, int* status) {
+    if (is_char_constant(arg)) return (unsigned char)arg[1];
+    if (*arg == '\0') return 0;
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 0);
+    if (check_numeric_arg(arg, end) != 0) *status = 1;
+    return value;
+}
+
+static long double float_arg(const char* arg, int* status) {
+    if (is_char_constant(arg)) return (unsigned char)arg[1];
+    if (*arg == '\0') return 0;
+    char* end;
+    errno = 0;
+    long double value = strtold(arg, &end);
+    if (check_numeric_arg(arg, end) != 0) *status = 1;
+    return value;
+}
+
+/**
+ * @brief Prints `format` once, taking conversions' values from `argv`.
+ * Sets *stop on \c or an invalid conversion.
+ * @return The first unused argument.
+ */
+static char** printf_once(const char* format, char** argv, int* status, int* stop) {
+    const char* p = format;
+    while (*p && !*stop) {
+        if (*p == '\\') {
+            p = put_escape(p + 1, 0, stop);
+            continue;
+        }
+        if (*p != '%') {
+            out_putc(*p++);
+            continue;
+        }
+        const char* spec = p++;
+        if (*p == '%') {
+            out_putc('%');
+            p++;
+            continue;
+        }
+
+        // Rebuild the directive with '*' fields filled in, then add the
+        // length modifier that matches how the value is passed.
+        char fmt[64];
+        size_t len = 0;
+        fmt[len++] = '%';
+        while (*p && strchr("-+ #0'", *p) && len < 16) {
+            fmt[len++] = *p++;
+        }
+        if (*p == '*') {
+            long long width = *argv ? signed_arg(*argv++, status) : 0;
+            len += snprintf(fmt + len, sizeof(fmt) - len, "%d", (int)width);
+            p++;
+        } else {
+            while (isdigit((unsigned char)*p) && len < 32) fmt[len++] = *p++;
+        }
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                long long prec = *argv ? signed_arg(*argv++, status) : 0;
+                if (prec >= 0) {
+                    len += snprintf(fmt + len, sizeof(fmt) - len, ".%d", (int)prec);
+                }
+                p++;
+            } else {
+                fmt[len++] = '.';
+                while (isdigit((unsigned char)*p) && len < 48) fmt[len++] = *p++;
+            }
+        }
+        while (*p && strchr("hlLjtz", *p)) {
+            p++; // Values are always passed at full width
+        }
+
+        char conv = *p;
+        if (conv == 'q') {
+            // Shell quoting follows quotearg's rules; leave it to the real printf.
+            out_flush();
+            fprintf(stderr, "printf: %%q: not supported natively; use 'command printf'\n");
+            *status = 1;
+            *stop = 1;
+            return argv;
+        }
+        if (conv == '\0' || !strchr("diouxXfFeEgGaAcsb", conv)) {
+            out_flush();
+            fprintf(stderr, "printf: %.*s: invalid conversion specification\n",
+                    (int)(p - spec) + (conv ? 1 : 0), spec);
+            *status = 1;
+            *stop = 1;
+            return argv;
+        }
+        p++;
+        const char* arg = *argv ? *argv++ : NULL;
+        switch (conv) {
+        case 'd': case 'i':
+            strcpy(fmt + len, "ll");
+            fmt[len + 2] = conv; fmt[len + 3] = '\0';
+            out_printf(fmt, arg ? signed_arg(arg, status) : 0LL);
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            strcpy(fmt + len, "ll");
+            fmt[len + 2] = conv; fmt[len + 3] = '\0';
+            out_printf(fmt, arg ? unsigned_arg(arg, status) : 0ULL);
+            break;
+        case 'c':
+            fmt[len] = 'c'; fmt[len + 1] = '\0';
+            out_printf(fmt, arg ? arg[0] : '\0');
+            break;
+        case 's':
+            fmt[len] = 's'; fmt[len + 1] = '\0';
+            out_printf(fmt, arg ? arg : "");
+            break;
+        case 'b':
+            if (arg && put_escaped(arg, 1)) {
+                *stop = 1;
+            }
+            break;
+        default: // Floating point
+            fmt[len] = 'L'; fmt[len + 1] = conv; fmt[len + 2] = '\0';
+            out_printf(fmt, arg ? float_arg(arg, status) : 0.0L);
+            break;
+        }
+    }
+    return argv;
+}
+
+/**
+ * @brief Implements `printf FORMAT [argument...]`. The format is reused
+ * until the arguments run out, as in coreutils.
+ */
+void execute_printf(char** args) {
+    if (args[1] == NULL) {
+        fprintf(stderr, "printf: missing operand\n");
+        set_builtin_status(1);
+        return;
+    }
+    int status = 0, stop = 0;
+    char** argv = &args[2];
+    for (;;) {
+        char** next = printf_once(args[1], argv, &status, &stop);
+        if (stop || next == argv || *next == NULL) {
+            break;
+        }
+        argv = next;
+    }
+    out_flush();
+    set_builtin_status(status);
+}
+
+void execute_true(char** args) {
+}
+
+void execute_false(char** args) {
+    set_builtin_status(1);
+}
+
+// --- cat ---
+
+/**
+ * @brief Copies `in` to `out` without passing the data through user space
+ * where the kernel allows: splice() when either side is a pipe,
+ * copy_file_range() between regular files. Anything else, or a fast path
+ * that fails, falls back to read()/write().
+ * @return 0, or -1 with errno set and `*write_failed` saying which side.
+ */
+static int copy_fd(int in, int out, int* write_failed) {
+    struct stat in_st, out_st;
+    int have_st = fstat(in, &in_st) == 0 && fstat(out, &out_st) == 0;
+    ssize_t n;
+    if (have_st && (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode))) {
+        while ((n = splice(in, NULL, out, NULL, COPY_CHUNK * 8, SPLICE_F_MOVE)) > 0) {
+        }
+        if (n == 0) return 0;
+    } else if (have_st && S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode)) {
+        while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK * 8, 0)) > 0) {
+        }
+        if (n == 0) return 0;
+    }
+
+    static char buf[COPY_CHUNK];
+    while ((n = read(in, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            *write_failed = 0;
+            return -1;
+        }
+        if (write_all(out, buf, (size_t)n) != 0) {
+            *write_failed = 1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    int number, number_nonblank, squeeze, show_ends, show_tabs, show_nonprinting;
+    long line;        // Last line number printed
+    int at_line_start;
+    int blank_lines;  // Consecutive empty lines just seen
+} CatFormat;
+
+// Prints `c` for -v: ^X for control characters, M- for the high half.
+static void put_visible(int c) {
+    if (c >= 128) {
+        out_puts("M-");
+        c -= 128;
+        if (c == '\t' || c == '\n') {
+            out_printf("^%c", c + 64);
+            return;
+        }
+    }
+    if (c == 127) {
+        out_puts("^?");
+    } else if (c < 32 && c != '\t' && c != '\n') {
+        out_printf("^%c", c + 64);
+    } else {
+        out_putc(c);
+    }
+}
+
+// The slow path for -n, -b, -s, -E, -T and -v. Numbering carries across files.
+static void cat_formatted(FILE* in, CatFormat* f) {
+    int c;
+    while ((c = getc(in)) != EOF) {
+        if (f->at_line_start) {
+            if (c == '\n') {
+                if (f->squeeze && f->blank_lines > 0) {
+                    continue;
+                }
+                f->blank_lines++;
+            } else {
+                f->blank_lines = 0;
+            }
+            if (f->number && !(f->number_nonblank && c == '\n')) {
+                out_printf("%6ld\t", ++f->line);
+            }
+        }
+        f->at_line_start = c == '\n';
+        if (c == '\n') {
+            if (f->show_ends) out_putc('$');
+            out_putc('\n');
+        } else if (c == '\t' && f->show_tabs) {
+            out_puts("^I");
+        } else if (f->show_nonprinting) {
+            put_visible(c);
+        } else {
+            out_putc(c);
+        }
+    }
+}
+
+/**
+ * @brief Implements `cat [-AbeEnstTuv] [file...]`.
+ */
+void execute_cat(char** args) {
+    CatFormat f = {0};
+    f.at_line_start = 1;
+    int i = 1;
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char* o = args[i] + 1; *o; o++) {
+            switch (*o) {
+            case 'A': f.show_nonprinting = f.show_ends = f.show_tabs = 1; break;
+            case 'b': f.number = f.number_nonblank = 1; break;
+            case 'e': f.show_nonprinting = f.show_ends = 1; break;
+            case 'E': f.show_ends = 1; break;
+            case 'n': f.number = 1; break;
+            case 's': f.squeeze = 1; break;
+            case 't': f.show_nonprinting = f.show_tabs = 1; break;
+            case 'T': f.show_tabs = 1; break;
+            case 'u': break;
+            case 'v': f.show_nonprinting = 1; break;
+            default:
+                fprintf(stderr, "cat: invalid option -- '%c'\n"
+                                "Try 'cat --help' for more information.\n", *o);
+                set_builtin_status(1);
+                return;
+            }
+        }
+    }
+    int formatted = f.number || f.squeeze || f.show_ends || f.show_tabs || f.show_nonprinting;
+
+    static char* const stdin_only[] = {"-", NULL};
+    char* const* files = args[i] ? &args[i] : stdin_only;
+    int status = 0;
+    out_flush();
+    for (; *files; files++) {
+        const char* file = *files;
+        int fd = strcmp(file, "-") == 0 ? STDIN_FILENO : open(file, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "cat: %s: %s\n", file, strerror(errno));
+            status = 1;
+            continue;
+        }
+        if (formatted) {
+            FILE* in = fd == STDIN_FILENO ? stdin : fdopen(fd, "r");
+            cat_formatted(in, &f);
+            if (ferror(in)) {
+                out_flush();
+                fprintf(stderr, "cat: %s: %s\n", file, strerror(errno));
+                status = 1;
+            }
+            if (in == stdin) clearerr(stdin);
+            else fclose(in);
+            continue;
+        }
+        int write_failed = 0;
+        if (copy_fd(fd, STDOUT_FILENO, &write_failed) != 0) {
+            if (write_failed) {
+                fprintf(stderr, "cat: write error: %s\n", strerror(errno));
+                if (fd != STDIN_FILENO) close(fd);
+                set_builtin_status(1);
+                return;
+            }
+            fprintf(stderr, "cat: %s: %s\n", file, strerror(errno));
+            status = 1;
+        }
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    out_flush();
+    set_builtin_status(status);
+}
+
+// --- head ---
+
+/**
+ * @brief Parses head's -n/-c value. A leading '-' means "all but the last".
+ * @return 0, or -1 if it isn't a number.
+ */
+static int parse_head_count(const char* s, long long* count, int* all_but_last) {
+    *all_but_last = *s == '-';
+    if (*s == '-' || *s == '+') s++;
+    if (!isdigit((unsigned char)*s)) return -1;
+    char* end;
+    errno = 0;
+    *count = strtoll(s, &end, 10);
+    return *end == '\0' && errno == 0 ? 0 : -1;
+}
+
+// Reads all of `fd` into a malloc'd buffer. Returns NULL on a read error.
+static char* read_all(int fd, size_t* len) {
+    size_t cap = COPY_CHUNK;
+    char* buf = malloc(cap);
+    *len = 0;
+    while (buf) {
+        if (*len == cap) {
+            char* grown = realloc(buf, cap *= 2);
+            if (!grown) break;
+            buf = grown;
+        }
+        ssize_t n = read(fd, buf + *len, cap - *len);
+        if (n == 0) return buf;
+        if (n < 0 && errno != EINTR) break;
+        if (n > 0) *len += (size_t)n;
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * @brief Writes the first `count` lines (or bytes) of `fd`. Input read past
+ * that point is given back with lseek() when `fd` is seekable, so a
+ * following command sharing the file starts where head stopped.
+ */
+static int head_fd(int fd, long long count, int bytes, char delim) {
+    static char buf[COPY_CHUNK];
+    while (count > 0) {
+        ssize_t n = read(fd, buf, bytes && count < (long long)sizeof(buf) ? (size_t)count : sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n == 0 ? 0 : -1;
+        size_t take = (size_t)n;
+        if (bytes) {
+            count -= n;
+        } else {
+            const char* p = buf;
+            const char* end = buf + n;
+            while (count > 0 && (p = memchr(p, delim, (size_t)(end - p))) != NULL) {
+                p++;
+                count--;
+            }
+            if (count == 0) {
+                take = (size_t)(p - buf);
+                lseek(fd, (off_t)take - n, SEEK_CUR);
+            }
+        }
+        if (write_all(STDOUT_FILENO, buf, take) != 0) return -1;
+    }
+    return 0;
+}
+
+// All but the last `count` lines (or bytes) of `fd`, which needs all of it.
+static int head_all_but_last(int fd, long long count, int bytes, char delim) {
+    size_t len;
+    char* data = read_all(fd, &len);
+    if (!data) return -1;
+    size_t end = len;
+    if (bytes) {
+        end = (unsigned long long)count < len ? len - (size_t)count : 0;
+    } else {
+        for (long long n = 0; n < count && end > 0; n++) {
+            size_t start = end - 1;
+            while (start > 0 && data[start - 1] != delim) start--;
+            end = start;
+        }
+    }
+    int result = write_all(STDOUT_FILENO, data, end);
+    free(data);
+    return result;
+}
+
+/**
+ * @brief Implements `head [-qvz] [-n [-]N | -c [-]N | -N] [file...]`.
+ */
+void execute_head(char** args) {
+    long long count = 10;
+    int bytes = 0, all_but_last = 0;
+    int verbose = -1; // -1: headers only with several files
+    char delim = '\n';
+    int i = 1;
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        if (isdigit((unsigned char)args[i][1])) {
+            if (parse_head_count(args[i] + 1, &count, &all_but_last) != 0) {
+                fprintf(stderr, "head: invalid number of lines: '%s'\n", args[i] + 1);
+                set_builtin_status(1);
+                return;
+            }
+            bytes = 0;
+            continue;
+        }
+        for (const char* o = args[i] + 1; *o; o++) {
+            if (*o == 'q' || *o == 'v') {
+                verbose = *o == 'v';
+                continue;
+            }
+            if (*o == 'z') {
+                delim = '\0';
+                continue;
+            }
+            if (*o != 'n' && *o != 'c') {
+                fprintf(stderr, "head: invalid option -- '%c'\n"
+                                "Try 'head --help' for more information.\n", *o);
+                set_builtin_status(1);
+                return;
+            }
+            bytes = *o == 'c';
+            const char* value = o[1] ? o + 1 : args[++i];
+            if (value == NULL) {
+                fprintf(stderr, "head: option requires an argument -- '%c'\n"
+                                "Try 'head --help' for more information.\n", *o);
+                set_builtin_status(1);
+                return;
+            }
+            if (parse_head_count(value, &count, &all_but_last) != 0) {
+                fprintf(stderr, "head: invalid number of %s: '%s'\n", bytes ? "bytes" : "lines", value);
+                set_builtin_status(1);
+                return;
+            }
+            break;
+        }
+    }
+
+    static char* const stdin_only[] = {"-", NULL};
+    char* const* files = args[i] ? &args[i] : stdin_only;
+    int headers = verbose == 1 || (verbose == -1 && files[1] != NULL);
+    int first = 1, status = 0;
+    out_flush();
+    for (; *files; files++) {
+        const char* file = *files;
+        int fd = strcmp(file, "-") == 0 ? STDIN_FILENO : open(file, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "head: cannot open '%s' for reading: %s\n", file, strerror(errno));
+            status = 1;
+            continue;
+        }
+        if (headers) {
+            char header[4200];
+            int len = snprintf(header, sizeof(header), "%s==> %s <==\n", first ? "" : "\n", input_name(file));
+            write_all(STDOUT_FILENO, header, len < (int)sizeof(header) ? (size_t)len : sizeof(header) - 1);
+        }
+        first = 0;
+        int result = all_but_last ? head_all_but_last(fd, count, bytes, delim)
+                                  : head_fd(fd, count, bytes, delim);
+        if (result != 0) {
+            fprintf(stderr, "head: error reading '%s': %s\n", input_name(file), strerror(errno));
+            status = 1;
+        }
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    set_builtin_status(status);
+}
+
+// --- wc ---
+
+typedef struct {
+    unsigned long long lines, words, chars, bytes, max_length;
+} WcCounts;
+
+enum { WC_LINES = 1, WC_WORDS = 2, WC_CHARS = 4, WC_BYTES = 8, WC_MAX_LENGTH = 16 };
+
+/**
+ * @brief Counts '\n' bytes, 16 at a time with SSE2 where available. Matches
+ * accumulate as per-byte counters, summed before they can overflow.
+ */
+static unsigned long long count_newlines(const char* p, size_t n) {
+    unsigned long long count = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= n) {
+        __m128i acc = zero;
+        for (int blocks = 0; blocks < 255 && i + 16 <= n; blocks++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, newline));
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (unsigned long long)_mm_cvtsi128_si32(sums) +
+                 (unsigned long long)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+#endif
+    for (; i < n; i++) {
+        count += p[i] == '\n';
+    }
+    return count;
+}
+
+/**
+ * @brief Counts what `which` asks for in `fd`. Byte counts of regular files
+ * come from their size; lines alone go through count_newlines(); words,
+ * characters and line length need the byte-by-byte loop.
+ */
+static int wc_fd(int fd, int which, int utf8, WcCounts* c) {
+    memset(c, 0, sizeof(*c));
+    struct stat st;
+    if (which == WC_BYTES && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        off_t pos = lseek(fd, 0, SEEK_CUR);
+        if (pos >= 0) {
+            c->bytes = pos < st.st_size ? (unsigned long long)(st.st_size - pos) : 0;
+            lseek(fd, 0, SEEK_END);
+            return 0;
+        }
+    }
+
+    static char buf[COPY_CHUNK];
+    int slow = which & (WC_WORDS | WC_CHARS | WC_MAX_LENGTH);
+    int in_word = 0;
+    unsigned long long line_length = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->bytes += (unsigned long long)n;
+        if (!slow) {
+            c->lines += count_newlines(buf, (size_t)n);
+            continue;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            unsigned char ch = (unsigned char)buf[i];
+            c->chars += !utf8 || (ch & 0xc0) != 0x80; // Continuation bytes aren't characters
+            if (ch == '\n') {
+                c->lines++;
+            }
+            if (isspace(ch)) {
+                in_word = 0;
+                if (ch == '\n' || ch == '\r' || ch == '\f') {
+                    if (line_length > c->max_length) c->max_length = line_length;
+                    line_length = 0;
+                } else if (ch == '\t') {
+                    line_length += 8 - line_length % 8;
+                } else if (ch == ' ') {
+                    line_length++;
+                }
+            } else if (isprint(ch)) {
+                // Unprintable bytes neither start nor end a word.
+                c->words += !in_word;
+                in_word = 1;
+                line_length++;
+            }
+        }
+    }
+    if (line_length > c->max_length) c->max_length = line_length;
+    return 0;
+}
+
+/**
+ * @brief The shell never calls setlocale(), so -m decides between bytes and
+ * UTF-8 characters from the environment, as coreutils would see it.
+ */
+static int locale_is_utf8(void) {
+    const char* names[] = {"LC_ALL", "LC_CTYPE", "LANG"};
+    for (int i = 0; i < 3; i++) {
+        const char* value = getenv(names[i]);
+        if (value && *value) {
+            return strstr(value, "UTF-8") || strstr(value, "utf8") || strstr(value, "UTF8");
+        }
+    }
+    return 0;
+}
+
+static void wc_print(const WcCounts* c, int which, int width, const char* name) {
+    const unsigned long long values[] = {c->lines, c->words, c->chars, c->bytes, c->max_length};
+    int first = 1;
+    for (int k = 0; k < 5; k++) {
+        if (which & (1 << k)) {
+            out_printf(first ? "%*llu" : " %*llu", width, values[k]);
+            first = 0;
+        }
+    }
+    if (name) out_printf(" %s", name);
+    out_putc('\n');
+}
+
+/**
+ * @brief The column width coreutils uses: enough for the total size of the
+ * regular files, at least 7 if any input isn't one, and 1 when a single
+ * count of a single input is printed.
+ */
+static int wc_width(char* const* files, int nfiles, int which) {
+    if (nfiles == 1 && (which & (which - 1)) == 0) return 1;
+    int width = 1, minimum = 1;
+    unsigned long long total = 0;
+    for (int i = 0; i < nfiles; i++) {
+        struct stat st;
+        int failed = files[i] && strcmp(files[i], "-") != 0 ? stat(files[i], &st)
+                                                            : fstat(STDIN_FILENO, &st);
+        if (failed) {
+            continue;
+        }
+        if (S_ISREG(st.st_mode)) total += (unsigned long long)st.st_size;
+        else minimum = 7;
+    }
+    for (; total >= 10; total /= 10) width++;
+    return width < minimum ? minimum : width;
+}
+
+/**
+ * @brief Implements `wc [-clmwL] [file...]`.
+ */
+void execute_wc(char** args) {
+    int which = 0;
+    int i = 1;
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        const char* a = args[i];
+        if (strcmp(a, "--") == 0) { i++; break; }
+        if (strcmp(a, "--lines") == 0) { which |= WC_LINES; continue; }
+        if (strcmp(a, "--words") == 0) { which |= WC_WORDS; continue; }
+        if (strcmp(a, "--chars") == 0) { which |= WC_CHARS; continue; }
+        if (strcmp(a, "--bytes") == 0) { which |= WC_BYTES; continue; }
+        if (strcmp(a, "--max-line-length") == 0) { which |= WC_MAX_LENGTH; continue; }
+        for (const char* o = a + 1; *o; o++) {
+            switch (*o) {
+            case 'l': which |= WC_LINES; break;
+            case 'w': which |= WC_WORDS; break;
+            case 'm': which |= WC_CHARS; break;
+            case 'c': which |= WC_BYTES; break;
+            case 'L': which |= WC_MAX_LENGTH; break;
+            default:
+                fprintf(stderr, "wc: invalid option -- '%c'\n"
+                                "Try 'wc --help' for more information.\n", *o);
+                set_builtin_status(1);
+                return;
+            }
+        }
+    }
+    if (which == 0) {
+        which = WC_LINES | WC_WORDS | WC_BYTES;
+    }
+
+    // A NULL entry is stdin given no operands, which prints no name.
+    char* no_operands[] = {NULL};
+    char** files = no_operands;
+    int nfiles = 1;
+    if (args[i]) {
+        files = &args[i];
+        for (nfiles = 0; files[nfiles]; nfiles++) {
+        }
+    }
+
+    int width = wc_width(files, nfiles, which);
+    int utf8 = (which & WC_CHARS) && locale_is_utf8();
+    WcCounts total = {0, 0, 0, 0, 0};
+    int status = 0;
+    for (int f = 0; f < nfiles; f++) {
+        const char* file = files[f];
+        int use_stdin = file == NULL || strcmp(file, "-") == 0;
+        int fd = use_stdin ? STDIN_FILENO : open(file, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            out_flush();
+            fprintf(stderr, "wc: %s: %s\n", file, strerror(errno));
+            status = 1;
+            continue;
+        }
+        WcCounts c;
+        if (wc_fd(fd, which, utf8, &c) != 0) {
+            out_flush();
+            fprintf(stderr, "wc: %s: %s\n", file ? file : "standard input", strerror(errno));
+            status = 1;
+        }
+        wc_print(&c, which, width, file);
+        total.lines += c.lines;
+        total.words += c.words;
+        total.chars += c.chars;
+        total.bytes += c.bytes;
+        if (c.max_length > total.max_length) total.max_length = c.max_length;
+        if (!use_stdin) close(fd);
+    }
+    if (nfiles > 1) {
+        wc_print(&total, which, width, "total");
+    }
+    out_flush();
+    set_builtin_status(status);
+}
+
+// --- sleep ---
+
+int parse_duration(const char* word, double* seconds) {
+    char* end;
+    double value = strtod(word, &end);
+    double scale = 1;
+    if (end != word && *end && end[1] == '\0') {
+        switch (*end) {
+        case 's': end++; break;
+        case 'm': scale = 60; end++; break;
+        case 'h': scale = 3600; end++; break;
+        case 'd': scale = 86400; end++; break;
+        }
+    }
+    if (end == word || *end != '\0' || value < 0 || isnan(value)) {
+        return -1;
+    }
+    *seconds = value * scale;
+    return 0;
+}
+
+/**
+ * @brief Implements `sleep NUMBER[smhd]...`, sleeping for the sum. Ctrl-C
+ * interrupts it with status 130; other signals (a job finishing, say) don't.
+ * On a terminal it runs in a child (BUILTIN_WAITS), which Ctrl-Z stops.
+ */
+void execute_sleep(char** args) {
+    if (args[1] == NULL) {
+        fprintf(stderr, "sleep: missing operand\nTry 'sleep --help' for more information.\n");
+        set_builtin_status(1);
+        return;
+    }
+    double seconds = 0;
+    int invalid = 0;
+    for (int i = 1; args[i]; i++) {
+        double value;
+        if (parse_duration(args[i], &value) != 0) {
+            fprintf(stderr, "sleep: invalid time interval '%s'\n", args[i]);
+            invalid = 1;
+            continue;
+        }
+        seconds += value;
+    }
+    if (invalid) {
+        fprintf(stderr, "Try 'sleep --help' for more information.\n");
+        set_builtin_status(1);
+        return;
+    }
+
+    struct timespec ts;
+    if (seconds >= (double)(1LL << 62)) {
+        ts.tv_sec = (time_t)(1LL << 62);
+        ts.tv_nsec = 0;
+    } else {
+        ts.tv_sec = (time_t)seconds;
+        ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    }
+    while (nanosleep(&ts, &ts) != 0) {
+        if (errno != EINTR || interrupted) {
+            set_builtin_status(130);
+            break;
+        }
+    }
+}
@@ -0,0 +1,412 @@
+#define _GNU_SOURCE // For ppoll()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "deadline.h"
+#include "coreutils.h" // For parse_duration
+#include "jobs.h"
+#include "builtins.h"
+#include "output.h"
+
+/*
+ * Every deadline, foreground or background, sits in one min-heap ordered by
+ * due time, and a single timerfd is armed for the earliest. Nothing runs per
+ * job: the shell notices the timerfd wherever it blocks (waiting for a
+ * foreground job, in `fg` and `wait`, and at an interactive prompt), and
+ * otherwise checks it once per command line. Adding or cancelling a
+ * deadline is O(log n) plus a scan to find it by process group.
+ *
+ * A deadline that fired stays in the heap, due "never", until its job is
+ * over, so the job's exit can be reported as a timeout (status 124).
+ */
+
+#define DEFAULT_GRACE 5.0 // Seconds from the first signal to SIGKILL
+#define NEVER LLONG_MAX
+
+typedef enum {
+    DEADLINE_PENDING,  // The first signal is due
+    DEADLINE_ESCALATE, // The first signal was sent; SIGKILL is due
+    DEADLINE_PASSED    // All signals sent
+} DeadlineStage;
+
+typedef struct {
+    pid_t pgid;
+    long long due;        // CLOCK_MONOTONIC nanoseconds
+    int sig;
+    long long grace;      // Nanoseconds; 0 for no SIGKILL
+    DeadlineStage stage;
+} Deadline;
+
+static Deadline* heap = NULL;
+static int heap_count = 0;
+static int heap_capacity = 0;
+static int timer_fd = -1;
+static volatile sig_atomic_t child_changed = 0;
+
+static const struct {
+    const char* name;
+    int sig;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long to_ns(double seconds) {
+    return seconds >= 9e9 ? NEVER / 2 : (long long)(seconds * 1e9);
+}
+
+static const char* signal_name(int sig) {
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++) {
+        if (signal_names[i].sig == sig) return signal_names[i].name;
+    }
+    return NULL;
+}
+
+// Parses TERM, SIGTERM or 15. Returns -1 if it's none of those.
+static int parse_signal(const char* word) {
+    if (strncmp(word, "SIG", 3) == 0) word += 3;
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++) {
+        if (strcmp(signal_names[i].name, word) == 0) return signal_names[i].sig;
+    }
+    char* end;
+    long sig = strtol(word, &end, 10);
+    return *word && *end == '\0' && sig > 0 && sig < NSIG ? (int)sig : -1;
+}
+
+// --- The heap ---
+
+static void swap(int a, int b) {
+    Deadline tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+static void sift_up(int i) {
+    while (i > 0 && heap[(i - 1) / 2].due > heap[i].due) {
+        swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_down(int i) {
+    for (;;) {
+        int least = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap_count && heap[left].due < heap[least].due) least = left;
+        if (right < heap_count && heap[right].due < heap[least].due) least = right;
+        if (least == i) return;
+        swap(i, least);
+        i = least;
+    }
+}
+
+static void heap_remove(int i) {
+    heap[i] = heap[--heap_count];
+    if (i < heap_count) {
+        sift_up(i);
+        sift_down(i);
+    }
+}
+
+static int find_deadline(pid_t pgid) {
+    for (int i = 0; i < heap_count; i++) {
+        if (heap[i].pgid == pgid) return i;
+    }
+    return -1;
+}
+
+// Points the timerfd at the earliest due deadline, or disarms it.
+static void rearm(void) {
+    if (timer_fd < 0) return;
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+    if (heap_count > 0 && heap[0].due != NEVER) {
+        long long due = heap[0].due > 0 ? heap[0].due : 1; // 0 would disarm
+        spec.it_value.tv_sec = (time_t)(due / 1000000000LL);
+        spec.it_value.tv_nsec = (long)(due % 1000000000LL);
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void deadline_add(pid_t pgid, double seconds, int sig, double grace) {
+    if (timer_fd < 0) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (timer_fd < 0) {
+            perror("shell: timerfd_create");
+            return;
+        }
+    }
+    int existing = find_deadline(pgid);
+    if (existing >= 0) {
+        heap_remove(existing);
+    }
+    if (heap_count == heap_capacity) {
+        int new_capacity = heap_capacity ? heap_capacity * 2 : 16;
+        Deadline* tmp = realloc(heap, (size_t)new_capacity * sizeof(Deadline));
+        if (!tmp) {
+            perror("shell: deadline");
+            return;
+        }
+        heap = tmp;
+        heap_capacity = new_capacity;
+    }
+    Deadline* d = &heap[heap_count];
+    d->pgid = pgid;
+    d->due = now_ns() + to_ns(seconds);
+    d->sig = sig;
+    d->grace = to_ns(grace);
+    d->stage = DEADLINE_PENDING;
+    sift_up(heap_count++);
+    rearm();
+}
+
+int deadline_cancel(pid_t pgid) {
+    int i = find_deadline(pgid);
+    if (i < 0) return 0;
+    int passed = heap[i].stage != DEADLINE_PENDING;
+    // SIGKILL stays due only while something in the group outlived its leader.
+    if (heap[i].stage != DEADLINE_ESCALATE || kill(-pgid, 0) != 0) {
+        heap_remove(i);
+        rearm();
+    }
+    return passed;
+}
+
+int deadline_fd(void) {
+    return heap_count > 0 && heap[0].due != NEVER ? timer_fd : -1;
+}
+
+void deadline_expire(void) {
+    if (heap_count == 0) return;
+    uint64_t expirations;
+    ssize_t n = read(timer_fd, &expirations, sizeof(expirations));
+    (void)n; // Due deadlines are found by time, not by this count
+    long long now = now_ns();
+    while (heap_count > 0 && heap[0].due <= now) {
+        Deadline* d = &heap[0];
+        if (d->stage == DEADLINE_PENDING) {
+            kill(-d->pgid, d->sig);
+            kill(-d->pgid, SIGCONT); // A stopped job must run to act on it
+            d->stage = d->grace > 0 && d->sig != SIGKILL ? DEADLINE_ESCALATE : DEADLINE_PASSED;
+            d->due = d->stage == DEADLINE_ESCALATE ? now + d->grace : NEVER;
+            sift_down(0);
+        } else {
+            kill(-d->pgid, SIGKILL);
+            if (get_job_by_pgid(d->pgid)) {
+                d->stage = DEADLINE_PASSED;
+                d->due = NEVER;
+                sift_down(0);
+            } else {
+                heap_remove(0); // Its job is already over
+            }
+        }
+    }
+    rearm();
+}
+
+// --- Waiting ---
+
+static void note_child(int sig) {
+    child_changed = 1;
+}
+
+// 1 if the shell's SIGINT handler would interrupt a blocking waitpid().
+static int sigint_interrupts(void) {
+    struct sigaction sa;
+    sigaction(SIGINT, NULL, &sa);
+    return sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN && !(sa.sa_flags & SA_RESTART);
+}
+
+/**
+ * @brief Blocks the way waitpid() would, but in ppoll() on the timerfd, so
+ * due deadlines are enforced meanwhile. SIGCHLD stays blocked except inside
+ * ppoll(), so a child changing state between the WNOHANG check and the
+ * ppoll() still wakes it.
+ */
+pid_t deadline_waitpid(pid_t pid, int* status, int options) {
+    if (deadline_fd() < 0 || (options & WNOHANG)) {
+        return waitpid(pid, status, options);
+    }
+    sigset_t chld, saved_mask;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &saved_mask);
+    struct sigaction sa, saved_action;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = note_child;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, &saved_action);
+    sigset_t unblocked = saved_mask;
+    sigdelset(&unblocked, SIGCHLD);
+
+    pid_t result;
+    int saved_errno = 0;
+    for (;;) {
+        result = waitpid(pid, status, options | WNOHANG);
+        if (result != 0 || deadline_fd() < 0) {
+            saved_errno = errno;
+            break;
+        }
+        child_changed = 0;
+        struct pollfd pfd = {timer_fd, POLLIN, 0};
+        int ready = ppoll(&pfd, 1, NULL, &unblocked);
+        if (ready > 0) {
+            deadline_expire();
+        } else if (ready < 0 && errno == EINTR && !child_changed && sigint_interrupts()) {
+            result = -1;
+            saved_errno = EINTR;
+            break;
+        }
+    }
+
+    sigaction(SIGCHLD, &saved_action, NULL);
+    sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+    if (result == 0) {
+        return waitpid(pid, status, options); // No deadline left to watch
+    }
+    errno = saved_errno;
+    return result;
+}
+
+// --- Syntax ---
+
+/**
+ * @brief Parses `[-s SIG] [-k DUR] DUR` starting at args[*i], for `who`.
+ * @return 0, or -1 after printing an error.
+ */
+static int parse_limits(char** args, int* i, const char* who, double* seconds, int* sig, double* grace) {
+    *sig = SIGTERM;
+    *grace = DEFAULT_GRACE;
+    for (; args[*i] && args[*i][0] == '-' && args[*i][1] != '\0'; *i += 2) {
+        const char* value = args[*i + 1];
+        if (strcmp(args[*i], "-s") == 0 && value) {
+            if ((*sig = parse_signal(value)) < 0) {
+                fprintf(stderr, "%s: %s: invalid signal\n", who, value);
+                return -1;
+            }
+        } else if (strcmp(args[*i], "-k") == 0 && value) {
+            if (parse_duration(value, grace) != 0) {
+                fprintf(stderr, "%s: invalid time interval '%s'\n", who, value);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "%s: invalid option '%s'\n", who, args[*i]);
+            return -1;
+        }
+    }
+    if (args[*i] == NULL) {
+        fprintf(stderr, "%s: missing duration\n", who);
+        return -1;
+    }
+    if (parse_duration(args[*i], seconds) != 0) {
+        fprintf(stderr, "%s: invalid time interval '%s'\n", who, args[*i]);
+        return -1;
+    }
+    (*i)++;
+    return 0;
+}
+
+int deadline_take_prefix(CommandPipeline* pipeline) {
+    SimpleCommand* cmd = &pipeline->commands[0];
+    if (cmd->arg_count == 0 || strcmp(cmd->args[0], "timeout") != 0) {
+        return 0;
+    }
+    int i = 1;
+    double seconds, grace;
+    int sig;
+    if (parse_limits(cmd->args, &i, "timeout", &seconds, &sig, &grace) != 0) {
+        return -1;
+    }
+    if (cmd->args[i] == NULL) {
+        fprintf(stderr, "timeout: missing command\n");
+        return -1;
+    }
+    for (int j = 0; j < i; j++) {
+        free(cmd->args[j]);
+    }
+    memmove(cmd->args, cmd->args + i, (size_t)(cmd->arg_count - i + 1) * sizeof(char*));
+    cmd->arg_count -= i;
+    pipeline->timeout = seconds; // 0, like coreutils, means no timeout
+    pipeline->timeout_signal = sig;
+    pipeline->timeout_grace = grace;
+    return 0;
+}
+
+static void print_deadline(const Deadline* d, long long now) {
+    Job* job = get_job_by_pgid(d->pgid);
+    const char* name = signal_name(d->sig);
+    if (job) {
+        out_printf("[%d] %s: ", job->job_id, job->command);
+    } else {
+        out_printf("(pgid %d): ", (int)d->pgid);
+    }
+    if (d->stage == DEADLINE_PENDING) {
+        out_printf("SIG%s in %.1fs", name ? name : "?", (double)(d->due - now) / 1e9);
+        if (d->grace > 0 && d->sig != SIGKILL) {
+            out_printf(", SIGKILL %.1fs later", (double)d->grace / 1e9);
+        }
+    } else if (d->stage == DEADLINE_ESCALATE) {
+        out_printf("timed out, SIGKILL in %.1fs", (double)(d->due - now) / 1e9);
+    } else {
+        out_printf("timed out");
+    }
+    out_printf("\n");
+}
+
+/**
+ * @brief Implements `deadline` (list deadlines), `deadline <job> [-s SIG]
+ * [-k DUR] <duration>` and `deadline <job> off`, for background jobs.
+ */
+void execute_deadline(char** args) {
+    if (args[1] == NULL) {
+        long long now = now_ns();
+        for (int i = 0; i < heap_count; i++) {
+            print_deadline(&heap[i], now);
+        }
+        return;
+    }
+    const char* id = args[1][0] == '%' ? args[1] + 1 : args[1];
+    Job* job = get_job_by_id(atoi(id));
+    if (job == NULL || job->pgid == 0) {
+        fprintf(stderr, "deadline: %s: no such job\n", args[1]);
+        set_builtin_status(1);
+        return;
+    }
+    if (args[2] != NULL && strcmp(args[2], "off") == 0 && args[3] == NULL) {
+        int i = find_deadline(job->pgid);
+        if (i >= 0) {
+            heap_remove(i);
+            rearm();
+        }
+        return;
+    }
+    int i = 2;
+    double seconds, grace;
+    int sig;
+    if (parse_limits(args, &i, "deadline", &seconds, &sig, &grace) != 0) {
+        set_builtin_status(1);
+        return;
+    }
+    if (args[i] != NULL) {
+        fprintf(stderr, "deadline: invalid argument. Usage: deadline [<job> [-s SIG] [-k DUR] <duration> | <job> off]\n");
+        set_builtin_status(1);
+        return;
+    }
+    deadline_add(job->pgid, seconds, sig, grace);
+}
@@ -0,0 +1,456 @@
+#define _GNU_SOURCE // For inotify_init1() flags and O_DIRECTORY
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+// Custom headers
+#include "dircache.h"
+#include "output.h"
+
+/*
+ * Cache of sorted directory listings.
+ *
+ * Listings are keyed on the directory's (st_dev, st_ino) and validated with
+ * its st_mtim, so a repeated lookup of an unchanged directory costs a single
+ * fstatat(). Because mtime has limited granularity, a listing read within
+ * RACY_WINDOW_NS of the directory's last modification can't be trusted on
+ * mtime alone and is re-read until it ages (unless an inotify watch vouches
+ * for it). Memory is bounded by a byte budget with LRU eviction.
+ */
+
+#define DEFAULT_BUDGET (8u * 1024 * 1024)
+#define INITIAL_BUCKETS 256
+#define RACY_WINDOW_NS 1000000000LL
+
+static DirListing** buckets = NULL;
+static int num_buckets = 0;
+static int num_listings = 0;
+
+// Most recently used at the head.
+static DirListing* lru_head = NULL;
+static DirListing* lru_tail = NULL;
+
+static size_t cache_bytes = 0;
+static size_t cache_budget = DEFAULT_BUDGET;
+static int inotify_fd = -1;
+
+static unsigned long stat_hits = 0;
+static unsigned long stat_misses = 0;
+static unsigned long stat_evictions = 0;
+static unsigned long stat_invalidations = 0;
+
+
+static unsigned int hash_key(dev_t dev, ino_t ino) {
+    unsigned long long h = (unsigned long long)ino * 0x9E3779B97F4A7C15ULL;
+    h ^= (unsigned long long)dev + (h >> 29);
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+static int timespec_equal(const struct timespec* a, const struct timespec* b) {
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+static long long timespec_diff_ns(const struct timespec* later, const struct timespec* earlier) {
+    return (later->tv_sec - earlier->tv_sec) * 1000000000LL + (later->tv_nsec - earlier->tv_nsec);
+}
+
+
+// --- LRU list ---
+
+static void lru_unlink(DirListing* l) {
+    if (l->lru_prev) l->lru_prev->lru_next = l->lru_next;
+    else lru_head = l->lru_next;
+    if (l->lru_next) l->lru_next->lru_prev = l->lru_prev;
+    else lru_tail = l->lru_prev;
+    l->lru_prev = l->lru_next = NULL;
+}
+
+static void lru_push_front(DirListing* l) {
+    l->lru_prev = NULL;
+    l->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = l;
+    lru_head = l;
+    if (!lru_tail) lru_tail = l;
+}
+
+
+// --- Hash table ---
+
+static int grow_buckets(void) {
+    int new_count = num_buckets ? num_buckets * 2 : INITIAL_BUCKETS;
+    DirListing** new_buckets = calloc(new_count, sizeof(DirListing*));
+    if (!new_buckets) return -1;
+
+    for (int i = 0; i < num_buckets; i++) {
+        DirListing* l = buckets[i];
+        while (l) {
+            DirListing* next = l->hash_next;
+            unsigned int b = hash_key(l->dev, l->ino) % new_count;
+            l->hash_next = new_buckets[b];
+            new_buckets[b] = l;
+            l = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_count;
+    return 0;
+}
+
+static DirListing* table_find(dev_t dev, ino_t ino) {
+    if (num_buckets == 0) return NULL;
+    for (DirListing* l = buckets[hash_key(dev, ino) % num_buckets]; l; l = l->hash_next) {
+        if (l->dev == dev && l->ino == ino) return l;
+    }
+    return NULL;
+}
+
+static void table_remove(DirListing* target) {
+    DirListing** link = &buckets[hash_key(target->dev, target->ino) % num_buckets];
+    while (*link) {
+        if (*link == target) {
+            *link = target->hash_next;
+            target->hash_next = NULL;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+
+static void free_listing(DirListing* l) {
+    free(l->names); // The strings live in the same block
+    free(l->types);
+    free(l);
+}
+
+// Drops a listing from the cache. It is freed now, or on its last release.
+static void evict(DirListing* l) {
+    table_remove(l);
+    lru_unlink(l);
+    if (l->wd >= 0 && inotify_fd >= 0) {
+        inotify_rm_watch(inotify_fd, l->wd);
+    }
+    l->wd = -1;
+    l->in_cache = 0;
+    cache_bytes -= l->bytes;
+    num_listings--;
+    if (l->refcount == 0) {
+        free_listing(l);
+    }
+}
+
+static void enforce_budget(void) {
+    DirListing* l = lru_tail;
+    while (l && cache_bytes > cache_budget) {
+        DirListing* prev = l->lru_prev;
+        evict(l);
+        stat_evictions++;
+        l = prev;
+    }
+}
+
+
+// --- inotify ---
+
+// Marks listings stale for every pending event. Never blocks.
+static void drain_inotify(void) {
+    if (inotify_fd < 0) return;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len; ) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            for (DirListing* l = lru_head; l; l = l->lru_next) {
+                if (l->wd == ev->wd) {
+                    l->stale = 1;
+                    if (ev->mask & IN_IGNORED) l->wd = -1;
+                    break;
+                }
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+
+// --- Reading ---
+
+typedef struct {
+    char* name;
+    unsigned char type;
+} RawEntry;
+
+static int raw_comparator(const void* a, const void* b) {
+    return strcmp(((const RawEntry*)a)->name, ((const RawEntry*)b)->name);
+}
+
+/**
+ * @brief Reads and sorts a directory into a new listing. The names are packed
+ * into one block right after the pointer array, so a listing is two mallocs.
+ */
+static DirListing* read_listing(int fd, const struct stat* st) {
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return NULL;
+    }
+
+    int count = 0, capacity = 64;
+    size_t name_bytes = 0;
+    RawEntry* raw = malloc(capacity * sizeof(RawEntry));
+    if (!raw) {
+        closedir(dir);
+        return NULL;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (count == capacity) {
+            capacity *= 2;
+            RawEntry* tmp = realloc(raw, capacity * sizeof(RawEntry));
+            if (!tmp) goto fail;
+            raw = tmp;
+        }
+        raw[count].name = strdup(de->d_name);
+        if (!raw[count].name) goto fail;
+        raw[count].type = de->d_type;
+        name_bytes += strlen(de->d_name) + 1;
+        count++;
+    }
+    closedir(dir);
+    dir = NULL;
+
+    qsort(raw, count, sizeof(RawEntry), raw_comparator);
+
+    DirListing* l = calloc(1, sizeof(DirListing));
+    size_t pointer_bytes = (count + 1) * sizeof(char*);
+    char** names = malloc(pointer_bytes + name_bytes);
+    unsigned char* types = malloc(count > 0 ? count : 1);
+    if (!l || !names || !types) {
+        free(l);
+        free(names);
+        free(types);
+        goto fail;
+    }
+
+    char* arena = (char*)names + pointer_bytes;
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(raw[i].name) + 1;
+        memcpy(arena, raw[i].name, len);
+        names[i] = arena;
+        types[i] = raw[i].type;
+        arena += len;
+        free(raw[i].name);
+    }
+    names[count] = NULL;
+    free(raw);
+
+    l->names = names;
+    l->types = types;
+    l->count = count;
+    l->dev = st->st_dev;
+    l->ino = st->st_ino;
+    l->mtime = st->st_mtim;
+    l->bytes = sizeof(DirListing) + pointer_bytes + name_bytes + count;
+    l->wd = -1;
+    return l;
+
+fail:
+    if (dir) closedir(dir);
+    for (int i = 0; i < count; i++) free(raw[i].name);
+    free(raw);
+    return NULL;
+}
+
+static int is_trustworthy(const DirListing* l, const struct stat* st) {
+    if (l->stale || !timespec_equal(&l->mtime, &st->st_mtim)) {
+        return 0;
+    }
+    if (l->wd >= 0) {
+        return 1; // inotify would have told us about any change
+    }
+    // A change in the same timestamp tick as our read would be invisible.
+    return timespec_diff_ns(&l->read_time, &l->mtime) >= RACY_WINDOW_NS;
+}
+
+
+/**
+ * @brief Returns the sorted listing of `path`, from the cache when the
+ * directory is unchanged. Returns NULL with errno set on failure.
+ * The caller must dircache_release() the result.
+ */
+DirListing* dircache_get(const char* path) {
+    drain_inotify();
+
+    struct stat st;
+    if (fstatat(AT_FDCWD, path, &st, 0) != 0) {
+        return NULL;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return NULL;
+    }
+
+    DirListing* cached = table_find(st.st_dev, st.st_ino);
+    if (cached) {
+        if (is_trustworthy(cached, &st)) {
+            stat_hits++;
+            lru_unlink(cached);
+            lru_push_front(cached);
+            cached->refcount++;
+            return cached;
+        }
+        stat_invalidations++;
+        evict(cached);
+    }
+    stat_misses++;
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    // Stat the fd itself: the path could have been replaced since fstatat().
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // With inotify the watch has to exist before reading, or we could miss a change.
+    int wd = -1;
+    if (inotify_fd >= 0) {
+        char proc_path[64];
+        snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+        wd = inotify_add_watch(inotify_fd, proc_path,
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    }
+
+    DirListing* l = read_listing(fd, &st);
+    if (!l) {
+        if (wd >= 0) inotify_rm_watch(inotify_fd, wd);
+        return NULL;
+    }
+    clock_gettime(CLOCK_REALTIME, &l->read_time);
+
+    l->wd = wd;
+    l->refcount = 1;
+
+    if (l->bytes > cache_budget) {
+        // Too big to cache at all; the caller gets a private copy.
+        if (wd >= 0) inotify_rm_watch(inotify_fd, wd);
+        l->wd = -1;
+        return l;
+    }
+
+    if (num_listings >= num_buckets && grow_buckets() != 0) {
+        if (wd >= 0) inotify_rm_watch(inotify_fd, wd);
+        l->wd = -1;
+        return l;
+    }
+    unsigned int b = hash_key(l->dev, l->ino) % num_buckets;
+    l->hash_next = buckets[b];
+    buckets[b] = l;
+    lru_push_front(l);
+    l->in_cache = 1;
+    cache_bytes += l->bytes;
+    num_listings++;
+    enforce_budget();
+    return l;
+}
+
+void dircache_release(DirListing* listing) {
+    if (!listing) return;
+    listing->refcount--;
+    if (listing->refcount == 0 && !listing->in_cache) {
+        free_listing(listing);
+    }
+}
+
+void dircache_clear(void) {
+    while (lru_head) {
+        evict(lru_head);
+    }
+}
+
+void dircache_set_budget(size_t bytes) {
+    cache_budget = bytes;
+    enforce_budget();
+}
+
+/**
+ * @brief Turns inotify-backed freshness on or off. Listings cached before
+ * enabling keep relying on mtime validation.
+ * @return 0 on success, -1 if inotify is unavailable.
+ */
+int dircache_set_inotify(int enabled) {
+    if (enabled && inotify_fd < 0) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        return inotify_fd < 0 ? -1 : 0;
+    }
+    if (!enabled && inotify_fd >= 0) {
+        for (DirListing* l = lru_head; l; l = l->lru_next) {
+            l->wd = -1;
+        }
+        close(inotify_fd); // Closing drops every watch
+        inotify_fd = -1;
+    }
+    return 0;
+}
+
+void dircache_get_stats(DirCacheStats* stats) {
+    stats->hits = stat_hits;
+    stats->misses = stat_misses;
+    stats->evictions = stat_evictions;
+    stats->invalidations = stat_invalidations;
+    stats->bytes = cache_bytes;
+    stats->budget = cache_budget;
+    stats->listings = num_listings;
+    stats->inotify_enabled = inotify_fd >= 0;
+}
+
+/**
+ * @brief Implements the 'dircache' built-in.
+ * Usage: dircache [clear | budget <bytes> | inotify on|off]
+ */
+void execute_dircache(char** args) {
+    if (args[1] == NULL) {
+        DirCacheStats s;
+        dircache_get_stats(&s);
+        unsigned long lookups = s.hits + s.misses;
+        out_printf("listings: %d\n", s.listings);
+        out_printf("memory: %zu / %zu bytes\n", s.bytes, s.budget);
+        out_printf("hits: %lu  misses: %lu  (%.1f%% hit rate)\n", s.hits, s.misses,
+                   lookups ? 100.0 * s.hits / lookups : 0.0);
+        out_printf("invalidations: %lu  evictions: %lu\n", s.invalidations, s.evictions);
+        out_printf("inotify: %s\n", s.inotify_enabled ? "on" : "off");
+    } else if (strcmp(args[1], "clear") == 0) {
+        dircache_clear();
+    } else if (strcmp(args[1], "budget") == 0 && args[2] != NULL) {
+        char* end;
+        unsigned long long bytes = strtoull(args[2], &end, 10);
+        if (*end != '\0') {
+            fprintf(stderr, "dircache: invalid budget '%s'\n", args[2]);
+            return;
+        }
+        dircache_set_budget((size_t)bytes);
+    } else if (strcmp(args[1], "inotify") == 0 && args[2] != NULL) {
+        int on = strcmp(args[2], "on") == 0;
+        if (!on && strcmp(args[2], "off") != 0) {
+            fprintf(stderr, "dircache: expected 'on' or 'off'\n");
+            return;
+        }
+        if (dircache_set_inotify(on) != 0) {
+            perror("dircache: inotify");
+        }
+    } else {
+        fprintf(stderr, "dircache: invalid argument. Usage: dircache [clear | budget <bytes> | inotify on|off]\n");
+    }
+}
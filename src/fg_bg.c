@@ -8,6 +8,9 @@
 #include "fg_bg.h"
 #include "jobs.h"
 #include "main.h" // For access to foreground_pgid
+#include "capture.h"
+#include "deadline.h"
+#include "output.h"
 
 /**
  * @brief Waits for a specific job to either terminate or stop again.
@@ -18,15 +21,18 @@ static void wait_for_job(Job* job) {
     int status;
     // We wait specifically for any process within the job's process group.
     // WUNTRACED allows us to also detect if the job is stopped again by Ctrl-Z.
-    if (waitpid(-job->pgid, &status, WUNTRACED) > 0) {
+    if (deadline_waitpid(-job->pgid, &status, WUNTRACED) > 0) {
         if (WIFSTOPPED(status)) {
             // The job was stopped again.
             job->status = JOB_STOPPED;
+            capture_follow(job->job_id, 0);
             printf("\n[%d] Stopped %s\n", job->job_id, job->command);
         } else {
             // The job terminated. Mark it for removal.
             // reap_finished_jobs will print the "Done" message.
-            job->pgid = 0; 
+            capture_settle(job->job_id);
+            deadline_cancel(job->pgid);
+            job->pgid = 0;
         }
     }
 }
@@ -45,12 +51,16 @@ void execute_fg(char** args) {
     }
 
     if (job == NULL) {
-        printf("fg: No such job\n");
+        out_printf("fg: No such job\n");
         return;
     }
 
     // Requirement: Print the command being brought to the foreground.
-    printf("%s\n", job->command);
+    out_printf("%s\n", job->command);
+    out_flush();
+
+    // Replay what the job wrote in the background, then show the rest live.
+    capture_follow(job->job_id, 1);
 
     // Give control of the terminal to the job's process group.
     tcsetpgrp(STDIN_FILENO, job->pgid);
@@ -59,6 +69,7 @@ void execute_fg(char** args) {
     // Send the "continue" signal to the process group in case it was stopped.
     if (kill(-job->pgid, SIGCONT) < 0) {
         perror("fg: kill (SIGCONT)");
+        capture_follow(job->job_id, 0);
         tcsetpgrp(STDIN_FILENO, getpgrp()); // Take control back on error
         return;
     }
@@ -89,12 +100,12 @@ void execute_bg(char** args) {
     }
 
     if (job == NULL) {
-        printf("bg: No such job\n");
+        out_printf("bg: No such job\n");
         return;
     }
 
     if (job->status == JOB_RUNNING) {
-        printf("bg: Job already running\n");
+        out_printf("bg: Job already running\n");
         return;
     }
 
@@ -106,5 +117,5 @@ void execute_bg(char** args) {
     }
 
     // Requirement: Print the resume message.
-    printf("[%d] %s &\n", job->job_id, job->command);
+    out_printf("[%d] %s &\n", job->job_id, job->command);
 }
\ No newline at end of file
@@ -0,0 +1,433 @@
+#define _GNU_SOURCE // For strcasestr() and flock()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// Custom headers
+#include "frecency.h"
+
+/*
+ * Persistent "frecency" database of visited directories, used by `hop <query>`.
+ *
+ * The file is memory-mapped and laid out as a header followed by variable-size
+ * entries, each a fixed record plus the NUL-terminated path. A repeat visit
+ * bumps the counters in place; a new directory is appended. Nothing is ever
+ * rewritten wholesale except when aging leaves too many dead entries.
+ * Each entry carries a hash of its path (for the visit lookup) and a bitmask
+ * of the characters in it (so most entries are rejected by a query with one
+ * AND). Writers take an exclusive flock, queries a shared one, so several
+ * shells can share the file.
+ */
+
+#define DB_FILENAME ".roy_shell_dirs"
+#define DB_MAGIC 0x42445352u // "RSDB"
+#define DB_VERSION 1
+#define INITIAL_DB_SIZE (64 * 1024)
+#define MAX_TOTAL_VISITS 10000 // Past this, all counts decay by 10%
+#define MAX_QUERY_RETRIES 8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t used;         // Bytes in use, including this header
+    uint32_t count;        // Live entries
+    uint32_t deleted;      // Dead entries, reclaimed by compaction
+    uint64_t total_visits;
+} DbHeader;
+
+typedef struct {
+    uint32_t visits;
+    uint32_t last_visit;   // Unix time
+    uint64_t char_mask;    // Characters present in the path, see char_bit()
+    uint32_t path_hash;
+    uint16_t path_len;
+    uint16_t base_offset;  // Start of the last path component
+    uint16_t size;         // Whole entry, including path, NUL and padding
+    uint16_t deleted;
+    uint32_t reserved;
+    // The path follows the record.
+} DbEntry;
+
+static int db_fd = -1;
+static char* db_map = NULL;
+static size_t db_size = 0;
+
+
+#define DB_HEADER() ((DbHeader*)db_map)
+#define ENTRY_PATH(e) ((char*)(e) + sizeof(DbEntry))
+
+static int char_bit(unsigned char c) {
+    c = (unsigned char)tolower(c);
+    if (c >= 'a' && c <= 'z') return c - 'a';
+    if (c >= '0' && c <= '9') return 26 + (c - '0');
+    if (c == '.') return 36;
+    if (c == '_') return 37;
+    if (c == '-') return 38;
+    return 39;
+}
+
+static uint64_t char_mask(const char* s) {
+    uint64_t mask = 0;
+    for (; *s; s++) mask |= 1ULL << char_bit((unsigned char)*s);
+    return mask;
+}
+
+// FNV-1a; only needs to make most non-matching paths compare unequal.
+static uint32_t path_hash(const char* s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int map_db(size_t size) {
+    if (db_map) {
+        munmap(db_map, db_size);
+        db_map = NULL;
+    }
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, db_fd, 0);
+    if (map == MAP_FAILED) {
+        db_size = 0;
+        return -1;
+    }
+    db_map = map;
+    db_size = size;
+    return 0;
+}
+
+static void init_header(void) {
+    DbHeader* h = DB_HEADER();
+    memset(h, 0, sizeof(*h));
+    h->magic = DB_MAGIC;
+    h->version = DB_VERSION;
+    h->used = sizeof(DbHeader);
+}
+
+static int open_db(void) {
+    if (db_fd >= 0) return 0;
+
+    char path[1024];
+    const char* home = getenv("HOME");
+    if (home) {
+        snprintf(path, sizeof(path), "%s/%s", home, DB_FILENAME);
+    } else {
+        snprintf(path, sizeof(path), "%s", DB_FILENAME);
+    }
+
+    db_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (db_fd < 0) return -1;
+
+    flock(db_fd, LOCK_EX);
+    struct stat st;
+    int ok = fstat(db_fd, &st) == 0;
+    int fresh = ok && (size_t)st.st_size < sizeof(DbHeader);
+    if (ok && fresh) {
+        ok = ftruncate(db_fd, INITIAL_DB_SIZE) == 0;
+        st.st_size = INITIAL_DB_SIZE;
+    }
+    if (ok) {
+        ok = map_db(st.st_size) == 0;
+    }
+    if (ok && (fresh || DB_HEADER()->magic != DB_MAGIC || DB_HEADER()->version != DB_VERSION ||
+               DB_HEADER()->used < sizeof(DbHeader) || DB_HEADER()->used > db_size)) {
+        init_header(); // New, foreign or corrupt file: start over
+    }
+    flock(db_fd, LOCK_UN);
+
+    if (!ok) {
+        if (db_map) munmap(db_map, db_size);
+        db_map = NULL;
+        close(db_fd);
+        db_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Another shell may have grown the file since we mapped it.
+static int ensure_mapped(void) {
+    struct stat st;
+    if (fstat(db_fd, &st) != 0) return -1;
+    if ((size_t)st.st_size != db_size) {
+        return map_db(st.st_size);
+    }
+    return 0;
+}
+
+static int grow_db(size_t needed) {
+    size_t new_size = db_size;
+    while (new_size < needed) new_size *= 2;
+    if (ftruncate(db_fd, new_size) != 0) return -1;
+    return map_db(new_size);
+}
+
+/**
+ * @brief The entry at `off`, or NULL if it can't be one: too small for its
+ * path, misaligned, or running past the entries in use. A corrupt or torn
+ * file would otherwise have the walks below loop forever on a zero size or
+ * read past the end.
+ */
+static DbEntry* entry_at(size_t off) {
+    DbHeader* h = DB_HEADER();
+    if (off + sizeof(DbEntry) > h->used) return NULL;
+    DbEntry* e = (DbEntry*)(db_map + off);
+    if (e->size < sizeof(DbEntry) + (size_t)e->path_len + 1 || e->size % 8 != 0 ||
+        off + e->size > h->used) {
+        return NULL;
+    }
+    return e;
+}
+
+// Whether some entry is broken; see entry_at().
+static int db_corrupt(void) {
+    DbHeader* h = DB_HEADER();
+    for (size_t off = sizeof(DbHeader); off < h->used; ) {
+        DbEntry* e = entry_at(off);
+        if (!e) return 1;
+        off += e->size;
+    }
+    return 0;
+}
+
+// Starts over on a corrupt file, found under a shared lock (which can't
+// write), unless another shell has done it since.
+static void reset_corrupt_db(void) {
+    flock(db_fd, LOCK_EX);
+    if (ensure_mapped() == 0 && db_corrupt()) {
+        init_header();
+    }
+    flock(db_fd, LOCK_UN);
+}
+
+// Slides live entries over dead ones. Caller holds the exclusive lock.
+static void compact_db(void) {
+    DbHeader* h = DB_HEADER();
+    size_t write = sizeof(DbHeader);
+    for (size_t off = sizeof(DbHeader); off < h->used; ) {
+        DbEntry* e = entry_at(off);
+        if (!e) { // Corrupt: start over
+            init_header();
+            return;
+        }
+        size_t size = e->size;
+        if (!e->deleted) {
+            if (write != off) memmove(db_map + write, e, size);
+            write += size;
+        }
+        off += size;
+    }
+    h->used = write;
+    h->deleted = 0;
+}
+
+// Decays every count so old habits fade. Caller holds the exclusive lock.
+static void age_db(void) {
+    DbHeader* h = DB_HEADER();
+    uint64_t total = 0;
+    for (size_t off = sizeof(DbHeader); off < h->used; ) {
+        DbEntry* e = entry_at(off);
+        if (!e) { // Corrupt: start over
+            init_header();
+            return;
+        }
+        off += e->size;
+        if (e->deleted) continue;
+        e->visits = e->visits * 9 / 10;
+        if (e->visits == 0) {
+            e->deleted = 1;
+            h->count--;
+            h->deleted++;
+        }
+        total += e->visits;
+    }
+    h->total_visits = total;
+    if (h->deleted > h->count) {
+        compact_db();
+    }
+}
+
+// Caller holds the exclusive lock: a corrupt file is started over.
+static DbEntry* find_entry(const char* path, uint32_t hash, size_t len) {
+    DbHeader* h = DB_HEADER();
+    for (size_t off = sizeof(DbHeader); off < h->used; ) {
+        DbEntry* e = entry_at(off);
+        if (!e) {
+            init_header();
+            return NULL;
+        }
+        if (!e->deleted && e->path_hash == hash && e->path_len == len &&
+            memcmp(ENTRY_PATH(e), path, len) == 0) {
+            return e;
+        }
+        off += e->size;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Records a visit: bumps the entry in place, or appends a new one.
+ */
+void frecency_add_visit(const char* path) {
+    size_t len = strlen(path);
+    if (len == 0 || len >= UINT16_MAX || open_db() != 0) return;
+
+    flock(db_fd, LOCK_EX);
+    if (ensure_mapped() != 0) {
+        flock(db_fd, LOCK_UN);
+        return;
+    }
+
+    uint32_t hash = path_hash(path);
+    uint32_t now = (uint32_t)time(NULL);
+    DbEntry* e = find_entry(path, hash, len);
+    if (e) {
+        e->visits++;
+        e->last_visit = now;
+    } else {
+        size_t size = (sizeof(DbEntry) + len + 1 + 7) & ~(size_t)7;
+        if (DB_HEADER()->used + size > db_size && grow_db(DB_HEADER()->used + size) != 0) {
+            flock(db_fd, LOCK_UN);
+            return;
+        }
+        DbHeader* h = DB_HEADER();
+        e = (DbEntry*)(db_map + h->used);
+        memset(e, 0, size);
+        e->visits = 1;
+        e->last_visit = now;
+        e->char_mask = char_mask(path);
+        e->path_hash = hash;
+        e->path_len = (uint16_t)len;
+        const char* base = strrchr(path, '/');
+        e->base_offset = (uint16_t)(base ? base - path + 1 : 0);
+        e->size = (uint16_t)size;
+        memcpy(ENTRY_PATH(e), path, len + 1);
+        h->used += size; // Publish only after the entry is complete
+        h->count++;
+    }
+
+    DbHeader* h = DB_HEADER();
+    if (++h->total_visits > MAX_TOTAL_VISITS) {
+        age_db();
+    }
+    flock(db_fd, LOCK_UN);
+}
+
+void frecency_remove(const char* path) {
+    if (open_db() != 0) return;
+    flock(db_fd, LOCK_EX);
+    if (ensure_mapped() == 0) {
+        DbEntry* e = find_entry(path, path_hash(path), strlen(path));
+        if (e) {
+            DbHeader* h = DB_HEADER();
+            h->total_visits -= e->visits;
+            e->deleted = 1;
+            h->count--;
+            h->deleted++;
+        }
+    }
+    flock(db_fd, LOCK_UN);
+}
+
+static double frecency_score(const DbEntry* e, uint32_t now) {
+    uint32_t age = now > e->last_visit ? now - e->last_visit : 0;
+    if (age < 3600) return e->visits * 4.0;
+    if (age < 86400) return e->visits * 2.0;
+    if (age < 604800) return e->visits * 0.5;
+    return e->visits * 0.25;
+}
+
+/**
+ * @brief How well a path matches: 4 if the query is a substring of the last
+ * component, 2 if a substring anywhere, 1 if its characters appear in order,
+ * 0 if not at all. Case-insensitive.
+ */
+static int match_quality(const char* path, size_t base_offset, const char* query) {
+    const char* hit = strcasestr(path, query);
+    if (hit) {
+        if (strcasestr(path + base_offset, query)) return 4;
+        return 2;
+    }
+    const char* q = query;
+    for (const char* p = path; *p && *q; p++) {
+        if (tolower((unsigned char)*p) == tolower((unsigned char)*q)) q++;
+    }
+    return *q == '\0' ? 1 : 0;
+}
+
+/**
+ * @brief Finds the highest scoring directory for `query`. Directories that
+ * have disappeared are dropped from the database and the next best is tried.
+ */
+int frecency_query(const char* query, const char* exclude, char* out, size_t out_size) {
+    if (query[0] == '\0' || open_db() != 0) return 0;
+
+    uint64_t query_mask = char_mask(query);
+
+    for (int attempt = 0; attempt < MAX_QUERY_RETRIES; attempt++) {
+        flock(db_fd, LOCK_SH);
+        if (ensure_mapped() != 0) {
+            flock(db_fd, LOCK_UN);
+            return 0;
+        }
+
+        uint32_t now = (uint32_t)time(NULL);
+        double best_score = 0.0;
+        const DbEntry* best = NULL;
+        DbHeader* h = DB_HEADER();
+        int corrupt = 0;
+        for (size_t off = sizeof(DbHeader); off < h->used; ) {
+            const DbEntry* e = entry_at(off);
+            if (!e) {
+                corrupt = 1;
+                break;
+            }
+            off += e->size;
+            if (e->deleted || (e->char_mask & query_mask) != query_mask) continue;
+
+            // Even a perfect match (quality 4) couldn't beat the best so far.
+            double frecency = frecency_score(e, now);
+            if (frecency * 4 <= best_score) continue;
+
+            const char* path = ENTRY_PATH(e);
+            if (exclude && strcmp(path, exclude) == 0) continue;
+
+            int quality = match_quality(path, e->base_offset, query);
+            if (quality == 0) continue;
+            double score = frecency * quality;
+            if (score > best_score) {
+                best_score = score;
+                best = e;
+            }
+        }
+
+        int found = 0;
+        if (best && best->path_len < out_size) {
+            memcpy(out, ENTRY_PATH(best), best->path_len + 1);
+            found = 1;
+        }
+        flock(db_fd, LOCK_UN);
+
+        if (corrupt) {
+            reset_corrupt_db();
+            return 0;
+        }
+        if (!found) return 0;
+
+        struct stat st;
+        if (stat(out, &st) == 0 && S_ISDIR(st.st_mode)) {
+            return 1;
+        }
+        frecency_remove(out); // Stale entry; try the next best
+    }
+    return 0;
+}
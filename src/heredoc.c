@@ -0,0 +1,286 @@
+#define _GNU_SOURCE // For memfd_create(), pipe2() and the F_*SEAL* / F_GETPIPE_SZ fcntls
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Custom headers
+#include "heredoc.h"
+#include "command.h"
+#include "record.h"
+
+/*
+ * Here-documents (`cmd <<EOF`) and here-strings (`cmd <<<word`).
+ *
+ * Neither touches the filesystem. A body that fits in a pipe is kept in
+ * memory and written into a fresh pipe when the command starts. A bigger
+ * body is written line by line straight into a memfd as it is read, so a
+ * multi-megabyte here-doc is never held in the shell's own memory; the memfd
+ * is then sealed and each command that uses it gets its own read-only open
+ * of it.
+ */
+
+#define HERE_PIPE_MAX (64 * 1024) // Default Linux pipe capacity
+#define HERE_SEALS (F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int create_memfd(void) {
+    return memfd_create("roy-shell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+}
+
+static HereDoc* new_here_doc(void) {
+    HereDoc* doc = calloc(1, sizeof(HereDoc));
+    if (doc) doc->memfd = -1;
+    return doc;
+}
+
+// Moves the in-memory body into a memfd; later appends go straight there.
+static int spill_to_memfd(HereDoc* doc) {
+    int fd = create_memfd();
+    if (fd < 0) return -1;
+    if (write_all(fd, doc->data, doc->len) != 0) {
+        close(fd);
+        return -1;
+    }
+    free(doc->data);
+    doc->data = NULL;
+    doc->cap = 0;
+    doc->memfd = fd;
+    return 0;
+}
+
+static int here_doc_append(HereDoc* doc, const char* s, size_t n) {
+    if (doc->memfd < 0 && doc->len + n > HERE_PIPE_MAX && spill_to_memfd(doc) != 0) {
+        return -1;
+    }
+    if (doc->memfd >= 0) {
+        if (write_all(doc->memfd, s, n) != 0) return -1;
+        doc->len += n;
+        return 0;
+    }
+    if (doc->len + n > doc->cap) {
+        size_t new_cap = doc->cap ? doc->cap : 256;
+        while (new_cap < doc->len + n) new_cap *= 2;
+        char* tmp = realloc(doc->data, new_cap);
+        if (!tmp) return -1;
+        doc->data = tmp;
+        doc->cap = new_cap;
+    }
+    memcpy(doc->data + doc->len, s, n);
+    doc->len += n;
+    return 0;
+}
+
+static int here_doc_finish(HereDoc* doc) {
+    if (doc->memfd >= 0 && fcntl(doc->memfd, F_ADD_SEALS, HERE_SEALS) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+HereDoc* copy_here_doc(const HereDoc* doc) {
+    HereDoc* copy = new_here_doc();
+    if (!copy) return NULL;
+    copy->len = doc->len;
+    if (doc->memfd >= 0) {
+        copy->memfd = dup(doc->memfd); // Readers open it afresh; see here_doc_open()
+        if (copy->memfd < 0 || fcntl(copy->memfd, F_SETFD, FD_CLOEXEC) != 0) {
+            free_here_doc(copy);
+            return NULL;
+        }
+    } else if (doc->len > 0) {
+        copy->data = malloc(doc->len);
+        if (!copy->data) {
+            free_here_doc(copy);
+            return NULL;
+        }
+        memcpy(copy->data, doc->data, doc->len);
+        copy->cap = doc->len;
+    }
+    return copy;
+}
+
+void free_here_doc(HereDoc* doc) {
+    if (!doc) return;
+    if (doc->memfd >= 0) close(doc->memfd);
+    free(doc->data);
+    free(doc);
+}
+
+/**
+ * @brief Reads one here-document body up to a line holding only `delim`.
+ * End of input also ends the body, with a warning, as in other shells.
+ */
+static HereDoc* read_here_doc(const char* delim, FILE* in, char** line, size_t* line_cap) {
+    HereDoc* doc = new_here_doc();
+    if (!doc) return NULL;
+
+    int interactive = isatty(fileno(in));
+    size_t delim_len = strlen(delim);
+    while (1) {
+        if (interactive) {
+            printf("> ");
+            fflush(stdout);
+        }
+        ssize_t n = getline(line, line_cap, in);
+        if (n >= 0 && in == stdin) record_input(*line, 0);
+        if (n < 0) {
+            fprintf(stderr, "shell: warning: here-document delimited by end-of-file (wanted '%s')\n", delim);
+            break;
+        }
+        size_t text_len = (n > 0 && (*line)[n - 1] == '\n') ? (size_t)n - 1 : (size_t)n;
+        if (text_len == delim_len && memcmp(*line, delim, delim_len) == 0) {
+            break;
+        }
+        if (here_doc_append(doc, *line, n) != 0) {
+            free_here_doc(doc);
+            return NULL;
+        }
+        if ((*line)[n - 1] != '\n' && here_doc_append(doc, "\n", 1) != 0) {
+            free_here_doc(doc);
+            return NULL;
+        }
+    }
+    if (here_doc_finish(doc) != 0) {
+        free_here_doc(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+int read_here_docs(CommandPipeline** sequence, int count, FILE* in) {
+    char* line = NULL;
+    size_t line_cap = 0;
+    int status = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        for (int j = 0; j < sequence[i]->num_commands; j++) {
+            SimpleCommand* cmd = &sequence[i]->commands[j];
+            if (!cmd->here_delim) continue;
+            HereDoc* doc = read_here_doc(cmd->here_delim, in, &line, &line_cap);
+            if (!doc) {
+                perror("shell: here-document");
+                status = -1;
+                break;
+            }
+            free_here_doc(cmd->here_doc);
+            cmd->here_doc = doc;
+        }
+    }
+    free(line);
+    return status;
+}
+
+int copy_here_doc_bodies(const char* line, FILE* in, FILE* out) {
+    char* body_line = NULL;
+    size_t body_cap = 0;
+    for (const char* p = strstr(line, "<<"); p; p = strstr(p, "<<")) {
+        if (p[2] == '<') { // A here-string
+            p += 3;
+            continue;
+        }
+        p += 2;
+        while (*p == ' ' || *p == '\t') p++;
+        size_t delim_len = strcspn(p, " \t\n|&;<>");
+        if (delim_len == 0) continue;
+        int interactive = isatty(fileno(in));
+        ssize_t n;
+        do {
+            if (interactive) {
+                printf("> ");
+                fflush(stdout);
+            }
+            if ((n = getline(&body_line, &body_cap, in)) < 0) break;
+            if (in == stdin) record_input(body_line, 0);
+            fputs(body_line, out);
+        } while (!((size_t)n >= delim_len && memcmp(body_line, p, delim_len) == 0 &&
+                   (body_line[delim_len] == '\n' || body_line[delim_len] == '\0')));
+        p += delim_len;
+        if (n < 0) break; // read_here_doc() warns about the missing delimiter
+    }
+    free(body_line);
+    return ferror(out) ? -1 : 0;
+}
+
+int prepare_here_strings(CommandPipeline* pipeline) {
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        SimpleCommand* cmd = &pipeline->commands[i];
+        if (!cmd->here_string) continue;
+        HereDoc* doc = new_here_doc();
+        if (!doc || here_doc_append(doc, cmd->here_string, strlen(cmd->here_string)) != 0 ||
+            here_doc_append(doc, "\n", 1) != 0 || here_doc_finish(doc) != 0) {
+            perror("shell: here-string");
+            free_here_doc(doc);
+            return -1;
+        }
+        free_here_doc(cmd->here_doc);
+        cmd->here_doc = doc;
+    }
+    return 0;
+}
+
+// Fresh memfd holding `data`, sealed and rewound, for bodies a pipe can't hold.
+static int memfd_with(const char* data, size_t len) {
+    int fd = create_memfd();
+    if (fd < 0) return -1;
+    if (write_all(fd, data, len) != 0 || fcntl(fd, F_ADD_SEALS, HERE_SEALS) != 0 ||
+        lseek(fd, 0, SEEK_SET) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Opens a here-doc for reading from the start. In-memory bodies are
+ * written into a new pipe in one go; they are small enough that this never
+ * blocks. A memfd is reopened through /proc so that every reader gets its
+ * own file offset.
+ */
+int here_doc_open(const HereDoc* doc) {
+    if (doc->memfd >= 0) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", doc->memfd);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) return fd;
+
+        // No /proc: share the original's offset, which is fine for one reader.
+        fd = dup(doc->memfd);
+        if (fd >= 0 && lseek(fd, 0, SEEK_SET) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) return -1;
+    int capacity = fcntl(fds[1], F_GETPIPE_SZ);
+    if (capacity >= 0 && doc->len > (size_t)capacity) {
+        // The pipe was shrunk below the default (pipe-user-pages-soft).
+        close(fds[0]);
+        close(fds[1]);
+        return memfd_with(doc->data, doc->len);
+    }
+    if (write_all(fds[1], doc->data, doc->len) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    close(fds[1]);
+    return fds[0];
+}
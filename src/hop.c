@@ -6,9 +6,44 @@
 
 // Custom headers
 #include "main.h" // For access to the global 'info' struct
+#include "frecency.h"
+#include "output.h"
+
+#define DIR_STACK_SIZE 16
 
 char prev_path[1000] = {0};
 
+// Directories we hopped away from, most recent first. `hop +N` returns to one.
+static char dir_stack[DIR_STACK_SIZE][1000];
+static int dir_stack_count = 0;
+
+
+// Pushes the directory we just left, dropping the oldest when the stack is full.
+static void push_dir_stack(const char* dir) {
+    if (dir[0] == '\0') return;
+    int keep = (dir_stack_count < DIR_STACK_SIZE) ? dir_stack_count : DIR_STACK_SIZE - 1;
+    memmove(dir_stack[1], dir_stack[0], keep * sizeof(dir_stack[0]));
+    strncpy(dir_stack[0], dir, sizeof(dir_stack[0]) - 1);
+    dir_stack[0][sizeof(dir_stack[0]) - 1] = '\0';
+    dir_stack_count = keep + 1;
+}
+
+// Bookkeeping after every successful chdir: remember where we came from and
+// record the visit in the frecency database.
+static void record_hop(const char* from) {
+    push_dir_stack(from);
+    char now[1000];
+    if (getcwd(now, sizeof(now)) != NULL) {
+        frecency_add_visit(now);
+    }
+}
+
+static void print_dir_stack(void) {
+    for (int i = 0; i < dir_stack_count; i++) {
+        out_printf("+%d %s\n", i + 1, dir_stack[i]);
+    }
+}
+
 
 void execute_hop(char** args) 
 {
@@ -22,6 +57,8 @@ void execute_hop(char** args)
         if (chdir(info.home) != 0) {
             // This should rarely fail, but handle it just in case.
             perror("hop: chdir to home failed");
+        } else {
+            record_hop(prev_path);
         }
     } else {
         // Process each argument in the sequence provided by the user.
@@ -46,13 +83,35 @@ void execute_hop(char** args)
                 chdir_result = 0; // Success, no operation needed.
             } else if (strcmp(arg, "-") == 0) {
                 if (prev_path[0] == '\0') {
-                    printf("hop: OLDPWD not set\n");
+                    out_printf("hop: OLDPWD not set\n");
                     continue; // Skip this argument and move to the next.
                 }
                 chdir_result = chdir(prev_path);
+            } else if (arg[0] == '+') {
+                // "+N" goes back to the N-th directory on the stack; "+" lists it.
+                if (arg[1] == '\0') {
+                    print_dir_stack();
+                    continue;
+                }
+                char* end;
+                long n = strtol(arg + 1, &end, 10);
+                if (*end != '\0' || n < 1 || n > dir_stack_count) {
+                    out_printf("hop: directory stack has no entry %s\n", arg);
+                    return;
+                }
+                char target[1000];
+                strcpy(target, dir_stack[n - 1]);
+                chdir_result = chdir(target);
             } else {
                 // This is a path name like "src" or "/etc/".
                 chdir_result = chdir(arg);
+
+                // Not a path: treat it as a fuzzy query against visited directories.
+                char match[1000];
+                if (chdir_result != 0 &&
+                    frecency_query(arg, cwd_before_change, match, sizeof(match))) {
+                    chdir_result = chdir(match);
+                }
             }
 
             // Check if the directory change was successful.
@@ -61,9 +120,12 @@ void execute_hop(char** args)
                 // The new 'prev_path' is the directory we were just in.
                 strncpy(prev_path, cwd_before_change, sizeof(prev_path) - 1);
                 prev_path[sizeof(prev_path) - 1] = '\0';
+                if (strcmp(arg, ".") != 0) {
+                    record_hop(cwd_before_change);
+                }
             } else {
                 // Failure! Print the error and stop processing further arguments.
-                printf("hop: No such directory: %s\n", arg);
+                out_printf("hop: No such directory: %s\n", arg);
                 // We don't change info.cwd, as the directory was not changed.
                 return;
             }
@@ -6,13 +6,15 @@
 ///// CUSTOM HEADERS //////
 #include "route.h"
 #include "command.h"
+#include "heredoc.h"
 /** RULES
  * shell_cmd -> cmd_group ((& | &&) cmd_group)* &?
  * cmd_group -> atomic (\| atomic)*
  * atomic    -> name (name | input | output)*
- * input     -> < name | <name
+ * input     -> < name | <name | << name | <<< name
  * output    -> > name | >name | >> name | >>name
- * name      -> r"[^|&><;]+"
+ * name      -> r"[^|&><;]+"   (a $(...), ${...}, <(...) or >(...) group may
+ *                             contain anything)
  */
 
 ////// UTILITY FUNCTIONS //////
@@ -27,6 +29,12 @@ void skip_whitespace(char** str)
     }
 }
 
+/// <(...) and >(...) are process substitutions, not redirections.
+static int at_process_substitution(const char* str)
+{
+    return (str[0] == '<' || str[0] == '>') && str[1] == '(';
+}
+
 /// From the current position, match a token and advacne the pointer if matched.
 int match_token(char** str, char* token) 
 {
@@ -46,13 +54,35 @@ int parse_name(char** str, char** name_buffer)
     skip_whitespace(str);
     char* start = *str;
     // A name must have at least one character and cannot start with a delimiter.
-    if (**str == '\0' || strchr("|&><;", **str) != NULL) 
+    if (**str == '\0' || (strchr("|&><;", **str) != NULL && !at_process_substitution(*str)))
     {
         return 0;
     }
     // Consume characters until a delimiter or whitespace is found.
-    while (**str != '\0' && !isspace(**str) && strchr("|&><;", **str) == NULL) 
+    while (**str != '\0' && !isspace(**str) &&
+           (strchr("|&><;", **str) == NULL || at_process_substitution(*str)))
     {
+        // $(...), ${...}, <(...) and >(...) are part of the word even if they
+        // contain spaces or delimiters; expansion takes them apart later.
+        if ((**str == '$' && ((*str)[1] == '(' || (*str)[1] == '{')) || at_process_substitution(*str))
+        {
+            char open = (*str)[1];
+            char close = (open == '(') ? ')' : '}';
+            int depth = 0;
+            (*str)++;
+            do
+            {
+                if (**str == open) depth++;
+                else if (**str == close) depth--;
+                (*str)++;
+            } while (depth > 0 && **str != '\0');
+            if (depth > 0)
+            {
+                *str = start;
+                return 0; // Unterminated substitution
+            }
+            continue;
+        }
         (*str)++;
     }
     if (*str > start) // Ensure we consumed at least one character.
@@ -70,12 +100,33 @@ int parse_name(char** str, char** name_buffer)
 int parse_input(char** str, SimpleCommand* cmd) 
 {
     char* saved_pos = *str;
-    if (match_token(str, "<")) 
+    char** target = NULL;
+    skip_whitespace(str);
+    if (at_process_substitution(*str))
     {
-        free(cmd->input_file);
-        cmd->input_file = NULL;
-        if (parse_name(str, &cmd->input_file)) 
+        *str = saved_pos;
+        return 0; // An argument, not a redirection
+    }
+    if (match_token(str, "<<<")) 
+    {
+        target = &cmd->here_string; // Here-string
+    }
+    else if (match_token(str, "<<")) 
+    {
+        target = &cmd->here_delim; // Here-document; the body is read after parsing
+    }
+    else if (match_token(str, "<")) 
+    {
+        target = &cmd->input_file;
+    }
+
+    if (target)
+    {
+        char* name = NULL;
+        if (parse_name(str, &name)) 
         {
+            free(*target);
+            *target = name;
             return 1; // Successfully parsed input redirection
         }
     }
@@ -89,6 +140,12 @@ int parse_output(char** str, SimpleCommand* cmd)
     char* saved_pos = *str;
 
     int is_append = 0;
+    skip_whitespace(str);
+    if (at_process_substitution(*str))
+    {
+        *str = saved_pos;
+        return 0; // An argument, not a redirection
+    }
     if (match_token(str, ">>")) 
     {
         is_append = 1;
@@ -115,14 +172,41 @@ int parse_output(char** str, SimpleCommand* cmd)
 }
 
 
+/// Appends an argument to a command, growing the argument list as needed.
+int append_arg(SimpleCommand* cmd, char* arg)
+{
+    // Always keep room for the NULL terminator.
+    if (cmd->arg_count + 2 > cmd->arg_capacity)
+    {
+        int new_capacity = cmd->arg_capacity ? cmd->arg_capacity * 2 : INITIAL_ARGS;
+        char** tmp = realloc(cmd->args, new_capacity * sizeof(char*));
+        if (!tmp)
+        {
+            return 0;
+        }
+        cmd->args = tmp;
+        cmd->arg_capacity = new_capacity;
+    }
+    cmd->args[cmd->arg_count++] = arg;
+    cmd->args[cmd->arg_count] = NULL;
+    return 1;
+}
+
+
 int parse_atomic(char** str, SimpleCommand* cmd) 
 {
+    char* name = NULL;
+
     // An atomic must start with a name.
-    if (!parse_name(str, &cmd->args[cmd->arg_count]))
+    if (!parse_name(str, &name))
     {
         return 0; // Failed to parse the command name
     }
-    cmd->arg_count++;
+    if (!append_arg(cmd, name))
+    {
+        free(name);
+        return 0;
+    }
 
     while (1)
     {
@@ -135,9 +219,13 @@ int parse_atomic(char** str, SimpleCommand* cmd)
         }
 
         // If no redirection was found, try parsing another argument.
-        if (parse_name(str, &cmd->args[cmd->arg_count])) 
+        if (parse_name(str, &name)) 
         {
-            cmd->arg_count++;
+            if (!append_arg(cmd, name))
+            {
+                free(name);
+                return 0;
+            }
             continue; // Successfully parsed an argument, continue the loop
         }
 
@@ -146,7 +234,7 @@ int parse_atomic(char** str, SimpleCommand* cmd)
         break;
     }
 
-    cmd->args[cmd->arg_count] = NULL; // Null-terminate the args array
+    // append_arg keeps the args array NULL-terminated.
     return 1;
 }
 
@@ -159,8 +247,13 @@ int parse_cmd_group(char** str, CommandPipeline* pipeline)
     }
     pipeline->num_commands++;
 
-    while (match_token(str, "|")) 
+    while (1)
     {
+        skip_whitespace(str);
+        if (strncmp(*str, "||", 2) == 0 || !match_token(str, "|"))
+        {
+            break; // `||` ends the pipeline; see script.c
+        }
         if (pipeline->num_commands >= MAX_PIPED_CMDS) 
         {
             return 0; // Exceeded maximum number of piped commands
@@ -241,13 +334,70 @@ void free_pipeline(CommandPipeline* pipeline)
         {
             free(cmd->args[j]);
         }
+        free(cmd->args);
+        for (int j = 0; j < cmd->assignment_count; j++) 
+        {
+            free(cmd->assignments[j]);
+        }
+        free(cmd->assignments);
         free(cmd->input_file);
         free(cmd->output_file);
+        free(cmd->here_delim);
+        free(cmd->here_string);
+        free_here_doc(cmd->here_doc);
     }
     free(pipeline);
 }
 
 
+// Copies a string that may be NULL.
+static int copy_string(char** dst, const char* src)
+{
+    *dst = NULL;
+    return src == NULL || (*dst = strdup(src)) != NULL;
+}
+
+// Deep copy of a parsed (not yet expanded) pipeline, for running it again.
+CommandPipeline* copy_pipeline(const CommandPipeline* pipeline)
+{
+    CommandPipeline* copy = malloc(sizeof(CommandPipeline));
+    if (!copy)
+    {
+        return NULL;
+    }
+    *copy = *pipeline;
+    copy->num_commands = 0;
+    for (int i = 0; i < pipeline->num_commands; i++)
+    {
+        const SimpleCommand* from = &pipeline->commands[i];
+        SimpleCommand* to = &copy->commands[i];
+        memset(to, 0, sizeof(*to));
+        copy->num_commands++;
+        to->append_mode = from->append_mode;
+        for (int j = 0; j < from->arg_count; j++)
+        {
+            char* arg = strdup(from->args[j]);
+            if (!arg || !append_arg(to, arg))
+            {
+                free(arg);
+                free_pipeline(copy);
+                return NULL;
+            }
+        }
+        if (!copy_string(&to->input_file, from->input_file) ||
+            !copy_string(&to->output_file, from->output_file) ||
+            !copy_string(&to->here_delim, from->here_delim) ||
+            !copy_string(&to->here_string, from->here_string) ||
+            (from->here_doc && !(to->here_doc = copy_here_doc(from->here_doc))))
+        {
+            free_pipeline(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+
 CommandPipeline** parse_command_sequence(char* input, int* sequence_count) {
     *sequence_count = 0;
     char* str = input;
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <sys/wait.h>
 #include "jobs.h"
+#include "procmon.h"
+#include "jobsched.h"
+#include "deadline.h"
+#include "shellstat.h"
+#include "ndjson.h"
+#include "output.h"
 #include <signal.h>
 
 // --- Global Variables ---
@@ -15,43 +21,88 @@ void init_jobs() {
     }
 }
 
-// Adds a new job to the table
-void add_job(pid_t pgid, const char* command_line) {
+// Job numbers are handed out when a job is submitted, even if it is queued.
+int allocate_job_id(void) {
+    return next_job_id++;
+}
+
+static Job* insert_job(pid_t pgid, const char* command_line, int job_id) {
     for (int i = 0; i < MAX_JOBS; i++) {
         if (job_table[i].pgid == 0) { // Find an empty slot
             job_table[i].pgid = pgid;
-            job_table[i].job_id = next_job_id++;
+            job_table[i].job_id = job_id;
             strncpy(job_table[i].command, command_line, sizeof(job_table[i].command) - 1);
             job_table[i].command[sizeof(job_table[i].command) - 1] = '\0';
 
             job_table[i].status = JOB_RUNNING;
-            // Per requirements, print the job ID and process ID
-            printf("[%d] %d\n", job_table[i].job_id, job_table[i].pgid);
-            return;
+            shellstat.jobs_started++;
+            return &job_table[i];
         }
     }
     fprintf(stderr, "shell: Error: too many background jobs.\n");
+    return NULL;
+}
+
+// Adds a new job to the table
+void add_job(pid_t pgid, const char* command_line) {
+    Job* job = insert_job(pgid, command_line, allocate_job_id());
+    if (job) {
+        // Per requirements, print the job ID and process ID
+        printf("[%d] %d\n", job->job_id, job->pgid);
+    }
+}
+
+void add_job_with_id(pid_t pgid, const char* command_line, int job_id) {
+    insert_job(pgid, command_line, job_id);
+}
+
+int job_finished(pid_t pid, int status, int* exit_status) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (job_table[i].pgid == pid) {
+            if (WIFEXITED(status)) {
+                printf("%s with pid %d exited normally\n", job_table[i].command, pid);
+                *exit_status = WEXITSTATUS(status);
+            } else {
+                printf("%s with pid %d exited abnormally\n", job_table[i].command, pid);
+                *exit_status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1;
+            }
+            if (deadline_cancel(pid)) {
+                *exit_status = 124; // Timed out, as `timeout` reports it
+            }
+            job_table[i].pgid = 0; // Mark the slot as free
+            shellstat.jobs_finished++;
+            return job_table[i].job_id;
+        }
+    }
+    return 0;
 }
 
 // Checks for any completed background jobs and prints their status
 void reap_finished_jobs() {
-    int status;
+    int status, exit_status;
     pid_t pid;
 
     // waitpid with WNOHANG checks for any terminated child without blocking the shell.
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        for (int i = 0; i < MAX_JOBS; i++) {
-            if (job_table[i].pgid == pid) {
-                if (WIFEXITED(status)) {
-                    printf("%s with pid %d exited normally\n", job_table[i].command, pid);
-                } else {
-                    printf("%s with pid %d exited abnormally\n", job_table[i].command, pid);
-                }
-                job_table[i].pgid = 0; // Mark the slot as free
-                break;
-            }
-        }
+        job_finished(pid, status, &exit_status);
     }
+    // Finished jobs make room for queued ones.
+    jobsched_start_queued();
+}
+
+int count_running_jobs(void) {
+    int count = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        count += job_table[i].pgid != 0 && job_table[i].status == JOB_RUNNING;
+    }
+    return count;
+}
+
+int has_free_job_slot(void) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (job_table[i].pgid == 0) return 1;
+    }
+    return 0;
 }
 
 
@@ -65,43 +116,93 @@ static int compare_jobs_by_name(const void* a, const void* b) {
     return strcmp(jobA->command, jobB->command);
 }
 
+/**
+ * @brief Copies every running or stopped job into `out` (MAX_JOBS slots),
+ * in table order. Returns how many there are.
+ */
+int get_active_jobs(Job* out) {
+    int count = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (job_table[i].pgid != 0) { // A non-zero pgid means the slot is in use.
+            out[count++] = job_table[i];
+        }
+    }
+    return count;
+}
+
 /**
  * @brief Implements the 'activities' built-in command.
  * It lists all currently running or stopped background jobs, sorted by name.
+ * `--json` lists them as one JSON object per job. `--watch` and `--once`
+ * report their resource usage instead.
  */
-void execute_activities() {
+void execute_activities(char** args) {
+    if (args[1] && (strcmp(args[1], "--watch") == 0 || strcmp(args[1], "--once") == 0)) {
+        execute_activities_monitor(args);
+        return;
+    }
+    int json = args[1] && strcmp(args[1], "--json") == 0;
+
     // First, clean up any jobs that might have finished since the last prompt.
     reap_finished_jobs();
 
-    // Create a temporary array to hold copies of the active jobs for sorting.
-    Job active_jobs[MAX_JOBS];
-    int count = 0;
-
-    // Collect all active jobs from the global job table.
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_table[i].pgid != 0) { // A non-zero pgid means the slot is in use.
-            active_jobs[count++] = job_table[i];
-        }
+    // Collect copies of the active and queued jobs for sorting.
+    int queued = jobsched_queue_length();
+    Job* active_jobs = malloc((MAX_JOBS + queued) * sizeof(Job));
+    if (active_jobs == NULL) {
+        perror("activities");
+        return;
     }
+    int count = get_active_jobs(active_jobs);
+    count += jobsched_get_queued_jobs(active_jobs + count, queued);
 
     if (count == 0) {
+        free(active_jobs);
         return; // Nothing to print if no jobs are active.
     }
 
     // Sort the temporary array of active jobs lexicographically by command name.
     qsort(active_jobs, count, sizeof(Job), compare_jobs_by_name);
 
+    if (json) {
+        for (int i = 0; i < count; i++) {
+            const Job* job = &active_jobs[i];
+            ndjson_begin();
+            ndjson_int("job", job->job_id);
+            if (job->status == JOB_QUEUED) {
+                ndjson_string("pid", NULL);
+            } else {
+                ndjson_int("pid", job->pgid);
+            }
+            ndjson_string("command", job->command);
+            ndjson_string("state", job->status == JOB_RUNNING ? "running" :
+                                   job->status == JOB_STOPPED ? "stopped" : "queued");
+            ndjson_end();
+        }
+        if (ndjson_finish() != 0) {
+            perror("activities: write");
+        }
+        free(active_jobs);
+        return;
+    }
+
     // Print the sorted list in the required format.
     for (int i = 0; i < count; i++) {
         // Determine the string representation of the job's state.
-        const char* state_str = (active_jobs[i].status == JOB_RUNNING) ? "Running" : "Stopped";
-        
-        // The format is: [pid] : command_name - State
-        printf("[%d] : %s - %s\n", 
-               active_jobs[i].pgid, 
-               active_jobs[i].command, 
-               state_str);
+        const char* state_str = active_jobs[i].status == JOB_RUNNING ? "Running" :
+                                active_jobs[i].status == JOB_STOPPED ? "Stopped" : "Queued";
+
+        // The format is: [pid] : command_name - State. Queued jobs have no pid yet.
+        if (active_jobs[i].status == JOB_QUEUED) {
+            out_printf("[-] : %s - %s\n", active_jobs[i].command, state_str);
+        } else {
+            out_printf("[%d] : %s - %s\n",
+                       active_jobs[i].pgid,
+                       active_jobs[i].command,
+                       state_str);
+        }
     }
+    free(active_jobs);
 }
 
 /**
@@ -132,6 +233,7 @@ void update_job_status(pid_t pgid, JobStatus status) {
  * @brief Sends SIGKILL to all active background jobs. Called on Ctrl-D.
  */
 void kill_all_jobs() {
+    jobsched_clear();
     for (int i = 0; i < MAX_JOBS; i++) {
         if (job_table[i].pgid != 0) {
             kill(-job_table[i].pgid, SIGKILL);
@@ -0,0 +1,341 @@
+#define _GNU_SOURCE // For syscall() and pidfd_open
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "jobsched.h"
+#include "input_parser.h"
+#include "route.h"
+#include "builtins.h"
+#include "deadline.h"
+#include "shellstat.h"
+#include "output.h"
+
+/*
+ * Background job scheduler.
+ *
+ * A trailing `&` starts the job right away only while fewer than
+ * `max_running` jobs are running (stopped ones don't count) and nothing is
+ * already queued; otherwise the pipeline, already expanded, waits in a queue
+ * and gets its job number at once. Queued jobs start as running ones are
+ * reaped: at each prompt, inside `wait`, and, while the shell sits at an
+ * interactive prompt, as soon as a job's pidfd says it exited.
+ *
+ * The queue is FIFO, or with `sched policy priority`, highest priority
+ * first (ties in submission order).
+ */
+
+typedef enum {
+    QUEUE_FIFO,
+    QUEUE_PRIORITY
+} QueuePolicy;
+
+typedef struct QueuedJob {
+    int job_id;
+    int priority;
+    char command[1024];
+    CommandPipeline* pipeline;
+    struct QueuedJob* next;
+} QueuedJob;
+
+static QueuedJob* queue_head = NULL;
+static QueuedJob* queue_tail = NULL;
+static int queue_length = 0;
+static int max_running = 1;     // 0 means no limit
+static QueuePolicy policy = QUEUE_FIFO;
+
+void init_jobsched(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_running = cpus > 0 ? (int)cpus : 1;
+}
+
+static int below_limit(void) {
+    return (max_running == 0 || count_running_jobs() < max_running) && has_free_job_slot();
+}
+
+int jobsched_can_start(void) {
+    return queue_length == 0 && below_limit();
+}
+
+void jobsched_enqueue(CommandPipeline* pipeline, const char* command_line) {
+    QueuedJob* job = malloc(sizeof(QueuedJob));
+    CommandPipeline* owned = malloc(sizeof(CommandPipeline));
+    if (job == NULL || owned == NULL) {
+        perror("shell: queue job");
+        free(job);
+        free(owned);
+        return;
+    }
+    *owned = *pipeline;
+    pipeline->num_commands = 0; // The caller's free_pipeline() now frees nothing inside
+
+    job->job_id = allocate_job_id();
+    job->priority = 0;
+    strncpy(job->command, command_line, sizeof(job->command) - 1);
+    job->command[sizeof(job->command) - 1] = '\0';
+    job->pipeline = owned;
+    job->next = NULL;
+    if (queue_tail) {
+        queue_tail->next = job;
+    } else {
+        queue_head = job;
+    }
+    queue_tail = job;
+    queue_length++;
+    shellstat.jobs_queued++;
+    printf("[%d] queued\n", job->job_id);
+}
+
+/**
+ * @brief Unlinks and returns the next job to start under the current policy.
+ */
+static QueuedJob* dequeue(void) {
+    QueuedJob* prev_best = NULL;
+    QueuedJob* best = queue_head;
+    if (policy == QUEUE_PRIORITY) {
+        for (QueuedJob *prev = queue_head, *q = queue_head ? queue_head->next : NULL; q; prev = q, q = q->next) {
+            if (q->priority > best->priority) {
+                best = q;
+                prev_best = prev;
+            }
+        }
+    }
+    if (best == NULL) {
+        return NULL;
+    }
+    if (prev_best) {
+        prev_best->next = best->next;
+    } else {
+        queue_head = best->next;
+    }
+    if (queue_tail == best) {
+        queue_tail = prev_best;
+    }
+    queue_length--;
+    return best;
+}
+
+void jobsched_start_queued(void) {
+    while (queue_length > 0 && below_limit()) {
+        QueuedJob* job = dequeue();
+        pid_t pgid = start_background_pipeline(job->pipeline, job->job_id);
+        if (pgid > 0) {
+            add_job_with_id(pgid, job->command, job->job_id);
+        }
+        free_pipeline(job->pipeline);
+        free(job);
+    }
+}
+
+int jobsched_queue_length(void) {
+    return queue_length;
+}
+
+int jobsched_get_queued_jobs(Job* out, int max) {
+    int count = 0;
+    for (QueuedJob* q = queue_head; q && count < max; q = q->next, count++) {
+        out[count].pgid = 0;
+        out[count].job_id = q->job_id;
+        strcpy(out[count].command, q->command);
+        out[count].status = JOB_QUEUED;
+    }
+    return count;
+}
+
+void jobsched_clear(void) {
+    while (queue_head) {
+        QueuedJob* next = queue_head->next;
+        free_pipeline(queue_head->pipeline);
+        free(queue_head);
+        queue_head = next;
+    }
+    queue_tail = NULL;
+    queue_length = 0;
+}
+
+static QueuedJob* find_queued(int job_id) {
+    for (QueuedJob* q = queue_head; q; q = q->next) {
+        if (q->job_id == job_id) return q;
+    }
+    return NULL;
+}
+
+void jobsched_wait_for_input(void) {
+    deadline_expire(); // Deadlines that passed while the shell was busy
+    while ((queue_length > 0 || deadline_fd() >= 0) && isatty(STDIN_FILENO)) {
+        // The deadline timer, then one pidfd per running job: each turns
+        // readable when its leader exits.
+        struct pollfd fds[MAX_JOBS + 2];
+        int nfds = 0;
+        fds[nfds++] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+        fds[nfds++] = (struct pollfd){deadline_fd(), POLLIN, 0}; // Ignored if -1
+        Job jobs[MAX_JOBS];
+        int count = get_active_jobs(jobs);
+        for (int i = 0; i < count; i++) {
+            if (jobs[i].status != JOB_RUNNING) continue;
+            int fd = (int)syscall(SYS_pidfd_open, jobs[i].pgid, 0);
+            if (fd >= 0) {
+                fds[nfds++] = (struct pollfd){fd, POLLIN, 0};
+            }
+        }
+        int ready = poll(fds, (nfds_t)nfds, -1);
+        for (int i = 2; i < nfds; i++) {
+            close(fds[i].fd);
+        }
+        if ((ready < 0 && errno != EINTR) || fds[0].revents) {
+            return; // Input (or an error) wins; the prompt carries on
+        }
+        deadline_expire();
+        reap_finished_jobs(); // Also starts queued jobs
+    }
+}
+
+/**
+ * @brief 1 while a job in `ids` is queued or running. With no ids, while
+ * any job is (or, with `queue_only`, while any is still queued).
+ */
+static int waiting_on(const int* ids, int count, int queue_only) {
+    if (count == 0) {
+        return queue_length > 0 || (!queue_only && count_running_jobs() > 0);
+    }
+    for (int i = 0; i < count; i++) {
+        Job* job = get_job_by_id(ids[i]);
+        if (find_queued(ids[i]) || (job && job->pgid != 0 && job->status == JOB_RUNNING)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Blocks in waitpid() until waiting_on() is satisfied, starting
+ * queued jobs as slots free up. Stopped jobs aren't waited for.
+ * @return The exit status of the last job in `ids` to finish, 130 if
+ * interrupted, 127 if a job can never finish.
+ */
+static int wait_for_jobs(const int* ids, int count, int queue_only) {
+    int result = 0;
+    while (waiting_on(ids, count, queue_only)) {
+        int status, exit_status;
+        pid_t pid = deadline_waitpid(-1, &status, 0);
+        if (pid < 0) {
+            // EINTR is Ctrl-C; ECHILD means nothing left can free a slot.
+            result = errno == EINTR ? 130 : 127;
+            break;
+        }
+        int job_id = job_finished(pid, status, &exit_status);
+        for (int i = 0; i < count; i++) {
+            if (ids[i] == job_id) result = exit_status;
+        }
+        if (count == 0 && job_id) {
+            result = exit_status;
+        }
+        jobsched_start_queued();
+    }
+    return result;
+}
+
+void jobsched_drain(void) {
+    if (queue_length > 0) {
+        wait_for_jobs(NULL, 0, 1);
+    }
+}
+
+static int parse_job_id(const char* arg) {
+    if (*arg == '%') arg++;
+    char* end;
+    long id = strtol(arg, &end, 10);
+    return *arg && *end == '\0' && id > 0 && id < 1000000000 ? (int)id : -1;
+}
+
+/**
+ * @brief Implements `wait [job...]`: blocks until the given jobs (or all
+ * queued and running jobs) have finished. Jobs are numbers, with or
+ * without a leading %.
+ */
+void execute_wait(char** args) {
+    int count = 0;
+    while (args[count + 1]) count++;
+    int* ids = malloc((size_t)(count ? count : 1) * sizeof(int));
+    if (ids == NULL) {
+        perror("wait");
+        set_builtin_status(1);
+        return;
+    }
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        int id = parse_job_id(args[i + 1]);
+        Job* job = id > 0 ? get_job_by_id(id) : NULL;
+        if (id > 0 && (find_queued(id) || (job && job->pgid != 0))) {
+            if (job && job->status == JOB_STOPPED) {
+                fprintf(stderr, "wait: job %d is stopped\n", id);
+            }
+            ids[valid++] = id;
+        } else {
+            fprintf(stderr, "wait: %s: no such job\n", args[i + 1]);
+            set_builtin_status(127);
+        }
+    }
+    if (count == 0 || valid > 0) {
+        set_builtin_status(wait_for_jobs(ids, valid, 0));
+    }
+    free(ids);
+}
+
+/**
+ * @brief Implements `sched` (show the limit and queue), `sched limit <n>`
+ * (0 for none), `sched policy fifo|priority` and `sched priority <job> <n>`.
+ */
+void execute_sched(char** args) {
+    if (args[1] == NULL) {
+        if (max_running == 0) {
+            out_printf("running: %d (no limit)\n", count_running_jobs());
+        } else {
+            out_printf("running: %d / %d\n", count_running_jobs(), max_running);
+        }
+        out_printf("queued: %d\n", queue_length);
+        out_printf("policy: %s\n", policy == QUEUE_FIFO ? "fifo" : "priority");
+    } else if (strcmp(args[1], "limit") == 0 && args[2] != NULL) {
+        char* end;
+        long limit = strtol(args[2], &end, 10);
+        if (*end != '\0' || limit < 0 || limit > 1000000) {
+            fprintf(stderr, "sched: invalid limit '%s'\n", args[2]);
+            set_builtin_status(1);
+            return;
+        }
+        max_running = (int)limit;
+        jobsched_start_queued();
+    } else if (strcmp(args[1], "policy") == 0 && args[2] != NULL) {
+        if (strcmp(args[2], "fifo") == 0) {
+            policy = QUEUE_FIFO;
+        } else if (strcmp(args[2], "priority") == 0) {
+            policy = QUEUE_PRIORITY;
+        } else {
+            fprintf(stderr, "sched: expected 'fifo' or 'priority'\n");
+            set_builtin_status(1);
+        }
+    } else if (strcmp(args[1], "priority") == 0 && args[2] != NULL && args[3] != NULL) {
+        int id = parse_job_id(args[2]);
+        QueuedJob* job = id > 0 ? find_queued(id) : NULL;
+        char* end;
+        long priority = strtol(args[3], &end, 10);
+        if (job == NULL) {
+            fprintf(stderr, "sched: %s: no such queued job\n", args[2]);
+            set_builtin_status(1);
+        } else if (*end != '\0' || end == args[3]) {
+            fprintf(stderr, "sched: invalid priority '%s'\n", args[3]);
+            set_builtin_status(1);
+        } else {
+            job->priority = (int)priority;
+        }
+    } else {
+        fprintf(stderr, "sched: invalid argument. Usage: sched [limit <n> | policy fifo|priority | priority <job> <n>]\n");
+        set_builtin_status(1);
+    }
+}
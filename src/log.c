@@ -4,6 +4,10 @@
 #include <unistd.h>
 #include "log.h"
 #include "main.h" // For access to process_command_line
+#include "trace.h"
+#include "shellstat.h"
+#include "ndjson.h"
+#include "output.h"
 
 
 #define MAX_HISTORY 15
@@ -21,7 +25,7 @@ static void get_history_filepath(char* path_buffer, size_t size) {
 }
 
 // Adds a command to the history file, managing the 15-line limit.
-void add_to_log(const char* command) {
+static void append_history(const char* command) {
     // Requirement: Do not store empty commands or 'log' commands.
     if (command == NULL || command[0] == '\0' || strncmp(command, "log", 3) == 0) {
         return;
@@ -74,10 +78,54 @@ void add_to_log(const char* command) {
     
     // Write the new command
     fprintf(file, "%s\n", command);
+    long written = ftell(file);
+    if (written > 0) {
+        shellstat.history_bytes += written;
+    }
+    fclose(file);
+}
+
+void add_to_log(const char* command) {
+    TraceSpan span = trace_begin("add_to_log");
+    append_history(command);
+    trace_end(span, NULL);
+}
+
+// Reads the history, oldest first, into `lines` (to free). Returns the
+// count, or -1 if there is no history file.
+static int read_history(const char* history_path, char* lines[MAX_HISTORY]) {
+    FILE* file = fopen(history_path, "r");
+    if (!file) {
+        return -1;
+    }
+    int line_count = 0;
+    char buffer[1024];
+    while (line_count < MAX_HISTORY && fgets(buffer, sizeof(buffer), file)) {
+        buffer[strcspn(buffer, "\n")] = 0;
+        lines[line_count++] = strdup(buffer);
+    }
     fclose(file);
+    return line_count;
 }
 
-// Handles the logic for `log`, `log purge`, and `log execute <index>`
+// `log --json`: one object per command, oldest first, each with the index
+// `log execute` takes for it.
+static void print_history_json(const char* history_path) {
+    char* lines[MAX_HISTORY];
+    int line_count = read_history(history_path, lines);
+    for (int i = 0; i < line_count; i++) {
+        ndjson_begin();
+        ndjson_int("index", line_count - i);
+        ndjson_string("command", lines[i]);
+        ndjson_end();
+        free(lines[i]);
+    }
+    if (ndjson_finish() != 0) {
+        perror("log: write");
+    }
+}
+
+// Handles the logic for `log`, `log --json`, `log purge`, and `log execute <index>`
 void execute_log(char** args) {
     char history_path[1024];
     get_history_filepath(history_path, sizeof(history_path));
@@ -86,12 +134,15 @@ void execute_log(char** args) {
         // --- Behavior: log (no arguments) ---
         FILE* file = fopen(history_path, "r");
         if (file) {
-            char buffer[1024];
-            while (fgets(buffer, sizeof(buffer), file)) {
-                printf("%s", buffer);
+            char buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                out_write(buffer, n);
             }
             fclose(file);
         }
+    } else if (strcmp(args[1], "--json") == 0) {
+        print_history_json(history_path);
     } else if (strcmp(args[1], "purge") == 0) {
         // --- Behavior: log purge ---
         FILE* file = fopen(history_path, "w"); // Opening in write mode truncates the file
@@ -112,34 +163,27 @@ void execute_log(char** args) {
         }
 
         char* lines[MAX_HISTORY];
-        int line_count = 0;
-        FILE* file = fopen(history_path, "r");
-        if (!file) {
+        int line_count = read_history(history_path, lines);
+        if (line_count < 0) {
             fprintf(stderr, "log: history is empty.\n");
             return;
         }
 
-        char buffer[1024];
-        while (line_count < MAX_HISTORY && fgets(buffer, sizeof(buffer), file)) {
-            buffer[strcspn(buffer, "\n")] = 0;
-            lines[line_count++] = strdup(buffer);
-        }
-        fclose(file);
-
         if (index > line_count) {
             fprintf(stderr, "log: index %d is out of bounds (history has %d items).\n", index, line_count);
         } else {
             // Index is 1-based from newest to oldest.
             // Newest is at line_count - 1. So we want lines[line_count - index].
             char* command_to_run = lines[line_count - index];
-            printf("Executing: %s\n", command_to_run);
-            
+            out_printf("Executing: %s\n", command_to_run);
+            out_flush(); // Before the command's own output
+
             process_command_line(command_to_run, 0); // 0 means do not re-add to history
            
         }
 
         for (int i = 0; i < line_count; i++) free(lines[i]);
     } else {
-        fprintf(stderr, "log: invalid argument '%s'. Usage: log [purge | execute <index>]\n", args[1]);
+        fprintf(stderr, "log: invalid argument '%s'. Usage: log [--json | purge | execute <index>]\n", args[1]);
     }
 }
@@ -11,10 +11,18 @@
 #include "route.h"
 #include "log.h"
 #include "jobs.h"
+#include "vars.h"
+#include "heredoc.h"
+#include "trace.h"
+#include "jobsched.h"
+#include "script.h"
+#include "shellstat.h"
+#include "record.h"
 
 // --- NEW: Global variable to track the foreground process group ---
 // `volatile` is crucial because this is modified by a signal handler.
 volatile pid_t foreground_pgid = 0;
+volatile sig_atomic_t interrupted = 0;
 
 // --- NEW: Signal handler for Ctrl-C (SIGINT) ---
 void sigint_handler(int sig) {
@@ -22,6 +30,7 @@ void sigint_handler(int sig) {
     if (foreground_pgid > 0) {
         kill(-foreground_pgid, SIGINT);
     }
+    interrupted = 1;
     // The shell itself does nothing, allowing it to reprint the prompt.
     printf("\n"); // Print a newline to look clean
 }
@@ -39,8 +48,15 @@ void sigtstp_handler(int sig) {
 // Define the global struct here
 struct shell_info info;
 
+// Here-document bodies of a command line that took several lines to type;
+// see read_rest_of_command(). NULL means they are still to come on stdin.
+static FILE* pending_here_docs = NULL;
+static char* pending_bodies = NULL;
+static size_t pending_bodies_size = 0;
+
 
 void init_shell(struct shell_info* info) {
+    info->pid = getpid();
     char* user = getenv("USER");
     if (user != NULL)
     {
@@ -68,14 +84,157 @@ void init_shell(struct shell_info* info) {
 }
 
 
+// Parses a command line, timed for shellstat and traced. See script_parse().
+static ScriptNode* parse_command_line(char* text, int* incomplete) {
+    TraceSpan parse_span = trace_begin("script_parse");
+    uint64_t parse_start = trace_now_ns();
+    ScriptNode* tree = script_parse(text, incomplete);
+    shellstat.parse_ns += trace_now_ns() - parse_start;
+    shellstat.parses++;
+    trace_end(parse_span, NULL);
+    return tree;
+}
+
+/**
+ * @brief Runs a command line already parsed into `tree` (NULL if it didn't
+ * parse), and frees the tree.
+ * @param line The line, without its newline, as it goes into the log.
+ * @param add_to_history A flag (1 or 0) to control if this command is saved.
+ */
+static void run_command_line(const char* line, ScriptNode* tree, int add_to_history) {
+    TraceSpan line_span = trace_begin("process_command_line");
+    shellstat.command_lines++;
+
+    // Handle exit here, as it should terminate the shell immediately.
+    if (strcmp(line, "exit") == 0) {
+        exit(0);
+    }
+
+    // Add to the log ONLY if the flag is set.
+    // This prevents commands run via `log execute` from being re-added.
+    if (add_to_history) {
+        add_to_log(line);
+    }
+
+    // Here-document bodies follow the command line in the input.
+    CommandPipeline** pipelines = NULL;
+    int count = tree ? script_pipelines(tree, &pipelines) : 0;
+    if (tree && (count < 0 ||
+                 read_here_docs(pipelines, count, pending_here_docs ? pending_here_docs : stdin) != 0)) {
+        free(pipelines);
+        script_free(tree);
+        trace_end(line_span, line);
+        return;
+    }
+    free(pipelines);
+
+    if (tree) {
+        script_run(tree, line);
+
+        // Clean up all memory used by the parser.
+        script_free(tree);
+    } else {
+        // Only print error for non-empty commands.
+        if (line[strspn(line, " \t")] != '\0') {
+            printf("Invalid Syntax.\n");
+        }
+    }
+    trace_end(line_span, line);
+}
+
+/**
+ * @brief Reads lines until `line` and they make a whole command (a loop up
+ * to its `done`, and so on), joined into one line: with "; " where a newline
+ * ended a command, with a space after `|`, `&&` or `||`. Here-document
+ * bodies come before the lines after the one that starts them, so they are
+ * set aside, in order, for run_command_line() to read instead of stdin.
+ * Each version of the line is parsed once, and the last parse is the one
+ * that runs: *tree is the whole command's tree, or NULL if it doesn't parse.
+ * @return The joined line (to free), or NULL if `line` is whole by itself.
+ */
+static char* read_rest_of_command(char* line, ScriptNode** tree) {
+    int incomplete;
+    *tree = parse_command_line(line, &incomplete);
+    if (!incomplete) {
+        return NULL;
+    }
+    size_t len = strcspn(line, "\n");
+    size_t cap = len + 1;
+    char* joined = malloc(cap);
+    FILE* here_docs = open_memstream(&pending_bodies, &pending_bodies_size);
+    if (!joined || !here_docs) {
+        perror("shell: read_rest_of_command");
+        free(joined);
+        if (here_docs) fclose(here_docs);
+        return NULL;
+    }
+    memcpy(joined, line, len);
+    joined[len] = '\0';
+    copy_here_doc_bodies(line, stdin, here_docs);
+
+    char* next = NULL;
+    size_t next_cap = 0;
+    do {
+        if (isatty(STDIN_FILENO)) {
+            printf("> ");
+            fflush(stdout);
+        }
+        if (getline(&next, &next_cap, stdin) < 0) {
+            break; // The syntax error is reported as usual
+        }
+        record_input(next, 0);
+        next[strcspn(next, "\n")] = '\0';
+        if (next[strspn(next, " \t")] == '\0') {
+            continue;
+        }
+        copy_here_doc_bodies(next, stdin, here_docs);
+
+        while (len > 0 && (joined[len - 1] == ' ' || joined[len - 1] == '\t')) len--;
+        int continues = (len > 0 && joined[len - 1] == '|') || // `|` and `||`
+                        (len > 1 && strncmp(joined + len - 2, "&&", 2) == 0);
+        const char* separator = continues ? " " : "; ";
+        size_t next_len = strlen(next);
+        if (len + strlen(separator) + next_len + 1 > cap) {
+            cap = (len + strlen(separator) + next_len + 1) * 2;
+            char* tmp = realloc(joined, cap);
+            if (!tmp) {
+                perror("shell: realloc");
+                break;
+            }
+            joined = tmp;
+        }
+        len += sprintf(joined + len, "%s%s", separator, next);
+        *tree = parse_command_line(joined, &incomplete);
+    } while (incomplete);
+    free(next);
+    fclose(here_docs);
+
+    if (pending_bodies_size > 0) {
+        pending_here_docs = fmemopen(pending_bodies, pending_bodies_size, "r");
+    }
+    return joined;
+}
+
 int main() {
     init_shell(&info);
     init_jobs(); // Initialize the job table
+    init_jobsched(); // Limit running background jobs to the CPU count
+    init_vars(); // Import the environment as shell variables
+    trace_init_from_env(); // ROY_SHELL_TRACE=file.json traces the whole session
+    record_init_from_env(); // ROY_SHELL_RECORD=file logs the session for bench/shell_replay
     
     //  // --- NEW: Install the signal handlers ---
     // // The shell will now catch SIGINT and SIGTSTP and run our functions.
-    signal(SIGINT, sigint_handler);
-    signal(SIGTSTP, sigtstp_handler);
+    // sigaction() rather than signal(), which under -std=c99 resets the
+    // handler after one signal: a second Ctrl-Z would stop the shell. No
+    // SA_RESTART, so that waits see EINTR and can check `interrupted`.
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = sigint_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = sigtstp_handler;
+    sigaction(SIGTSTP, &sa, NULL);
 
     
     char command_line[1024];
@@ -91,60 +250,64 @@ int main() {
         printf("%s", info.cwd);
         printf("\033[36m> \033[0m");
         fflush(stdout);
+        jobsched_wait_for_input(); // Keeps queued jobs moving while idle
 
         // 2. Get user input (using fgets is safer)
         if (fgets(command_line, sizeof(command_line), stdin) == NULL) {
             printf("logout\n");
+            jobsched_drain(); // Queued jobs still get to start
             break; // Handle EOF (Ctrl+D)
         }
+        record_input(command_line, 1);
+        command_line[strcspn(command_line, "\n")] = '\0';
 
-        // 3. Call the main processing function.
+        // An unfinished `if`, loop, `&&` or `|` goes on over the next lines.
+        // Either way the line is parsed just once.
+        ScriptNode* tree;
+        char* full_line = read_rest_of_command(command_line, &tree);
+
+        // 3. Run it.
         // For commands typed by the user, we always want to add them to the log (flag = 1).
-        process_command_line(command_line, 1);
+        run_command_line(full_line ? full_line : command_line, tree, 1);
+        record_done(get_last_status());
+        if (pending_here_docs) {
+            fclose(pending_here_docs);
+            pending_here_docs = NULL;
+        }
+        free(pending_bodies);
+        pending_bodies = NULL;
+        pending_bodies_size = 0;
+        free(full_line);
     }
     return 0;
 }
 
 /**
- * @brief This NEW function contains the core logic from your old main loop.
- * It parses and executes a command line. It can be called from main()
- * or from execute_log().
+ * @brief Parses and executes a command line that didn't come from the
+ * prompt: `log execute`, and the children of `$(...)` and `<(...)`.
  * @param line The command string to process.
  * @param add_to_history A flag (1 or 0) to control if this command is saved.
  */
-void process_command_line(char* line, int add_to_history) {
+void process_command_line(const char* line, int add_to_history) {
     // Create a mutable copy of the command line for parsing and logging.
-    char command_copy[1024];
-    strncpy(command_copy, line, sizeof(command_copy) - 1);
-    command_copy[strcspn(command_copy, "\n")] = 0; // Remove trailing newline
-
-    // Handle exit here, as it should terminate the shell immediately.
-    if (strcmp(command_copy, "exit") == 0) {
-        exit(0);
-    }
-
-    // Add to the log ONLY if the flag is set.
-    // This prevents commands run via `log execute` from being re-added.
-    if (add_to_history) {
-        add_to_log(command_copy);
+    char* command_copy = strdup(line);
+    if (!command_copy) {
+        perror("shell: strdup");
+        return;
     }
+    command_copy[strcspn(command_copy, "\n")] = 0; // Remove trailing newline
 
-    int sequence_count = 0;
-    // The parser creates an array of pipelines, separated by ';'.
-    CommandPipeline** pipeline_sequence = parse_command_sequence(command_copy, &sequence_count);
-
-    if (pipeline_sequence) {
-        // Loop through and execute each pipeline in the sequence.
-        for (int i = 0; i < sequence_count; i++) {
-            execute_pipeline(pipeline_sequence[i], command_copy);
-        }
+    // The parser turns the line into a tree of lists, `&&`/`||`, loops and
+    // conditionals over pipelines.
+    run_command_line(command_copy, parse_command_line(command_copy, NULL), add_to_history);
+    free(command_copy);
+}
 
-        // Clean up all memory used by the parser.
-        free_pipeline_sequence(pipeline_sequence, sequence_count);
-    } else {
-        // Only print error for non-empty commands.
-        if (strlen(command_copy) > 0) {
-            printf("Invalid Syntax.\n");
-        }
-    }
-}
\ No newline at end of file
+/**
+ * @brief Runs `line` as the whole work of a forked child and exits with its
+ * status. process_command_line() copies the line, so it can be any length.
+ */
+void run_subshell_line(const char* line) {
+    process_command_line(line, 0);
+    exit(get_last_status());
+}
@@ -0,0 +1,598 @@
+#define _GNU_SOURCE // For pipe2() and O_CLOEXEC under -std=c99
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "memo.h"
+#include "heredoc.h"
+#include "procsub.h"
+#include "vars.h"
+#include "builtins.h"
+#include "shellstat.h"
+#include "output.h"
+
+/*
+ * The store lives in ~/.roy_shell_memo and is content-addressed:
+ *
+ *   objects/<hash of the output>   the stdout of a successful run
+ *   keys/<hash of the key>         the name of that run's object
+ *
+ * Runs with the same output share one object. A miss runs the pipeline
+ * with its last command's stdout going to a small copying process (part
+ * of the job, so Ctrl-Z and Ctrl-C reach it) that passes the output on
+ * and also writes it to a temporary file; if the pipeline succeeds, the
+ * file is renamed to its hash. A hit touches the object's mtime, and the
+ * store is trimmed to its size limit by dropping the least recently used
+ * objects, along with the keys that named them.
+ */
+
+#define MEMO_DIRNAME ".roy_shell_memo"
+#define DEFAULT_MAX_SIZE (64ULL * 1024 * 1024)
+#define HASH_HEX 32                 // 128-bit hashes, in hex
+#define STALE_TEMP_SECONDS (24 * 60 * 60) // Left by a shell that died mid-run
+#define COPY_BUFFER (64 * 1024)
+
+__extension__ typedef unsigned __int128 Hash;
+
+struct Memo {
+    char key[HASH_HEX + 1];
+    int dest_fd;   // Where the output goes: the last command's `>` file, or -1 for stdout
+    int read_fd;   // The copying process's end of the output pipe
+    int write_fd;  // The last command's end
+    int temp_fd;
+    char temp_path[PATH_MAX + 32];
+    pid_t copier;
+};
+
+static unsigned long long max_size = DEFAULT_MAX_SIZE;
+static unsigned long long hits = 0, misses = 0, stores = 0, bytes_replayed = 0;
+static unsigned int temp_counter = 0;
+
+// --- Hashing: 128-bit FNV-1a ---
+
+static Hash hash_init(void) {
+    return ((Hash)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+}
+
+static Hash hash_bytes(Hash h, const void* data, size_t len) {
+    const Hash prime = ((Hash)1 << 88) | 0x13b; // 2^88 + 2^8 + 0x3b
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= prime;
+    }
+    return h;
+}
+
+// Includes the terminating NUL, so that ("ab", "c") and ("a", "bc") differ.
+static Hash hash_string(Hash h, const char* s) {
+    return hash_bytes(h, s ? s : "\x01", strlen(s ? s : "\x01") + 1);
+}
+
+static void hash_hex(Hash h, char* out) {
+    for (int i = HASH_HEX - 1; i >= 0; i--) {
+        out[i] = "0123456789abcdef"[h & 0xf];
+        h >>= 4;
+    }
+    out[HASH_HEX] = '\0';
+}
+
+static Hash hash_file_identity(Hash h, const char* path) {
+    struct stat st;
+    char identity[128];
+    if (stat(path, &st) == 0) {
+        snprintf(identity, sizeof(identity), "%llu:%llu:%lld:%lld.%09ld",
+                 (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+                 (long long)st.st_size, (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    } else {
+        snprintf(identity, sizeof(identity), "missing");
+    }
+    h = hash_string(h, path);
+    return hash_string(h, identity);
+}
+
+static Hash hash_env(Hash h, const char* name) {
+    h = hash_string(h, name);
+    return hash_string(h, getenv(name)); // Unset hashes differently from empty
+}
+
+static Hash hash_here_doc(Hash h, const HereDoc* doc) {
+    if (doc->memfd < 0) {
+        return hash_bytes(h, doc->data ? doc->data : "", doc->len);
+    }
+    char buf[COPY_BUFFER];
+    ssize_t n;
+    for (off_t at = 0; (n = pread(doc->memfd, buf, sizeof(buf), at)) > 0; at += n) {
+        h = hash_bytes(h, buf, (size_t)n);
+    }
+    return h;
+}
+
+// Everything that decides what the pipeline prints, as far as the shell can tell.
+static Hash hash_pipeline(Hash h, const CommandPipeline* pipeline) {
+    char cwd[PATH_MAX];
+    h = hash_string(h, "cwd");
+    h = hash_string(h, getcwd(cwd, sizeof(cwd)) ? cwd : NULL);
+    h = hash_env(h, "PATH");
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        const SimpleCommand* cmd = &pipeline->commands[i];
+        h = hash_string(h, "|");
+        for (int j = 0; j < cmd->assignment_count; j++) {
+            h = hash_string(h, cmd->assignments[j]);
+        }
+        h = hash_string(h, "args");
+        for (int j = 0; j < cmd->arg_count; j++) {
+            h = hash_string(h, cmd->args[j]);
+        }
+        if (cmd->input_file) { // Its words become arguments; see execute_child_command()
+            h = hash_string(h, "<");
+            h = hash_file_identity(h, cmd->input_file);
+        }
+        if (cmd->output_file && i < pipeline->num_commands - 1) {
+            h = hash_string(h, ">");
+            h = hash_string(h, cmd->output_file);
+        }
+        if (cmd->here_doc) {
+            h = hash_string(h, "<<");
+            h = hash_here_doc(h, cmd->here_doc);
+        }
+    }
+    return h;
+}
+
+// --- The store ---
+
+static const char* store_path(char* buf, size_t size, const char* sub, const char* name) {
+    const char* home = getenv("HOME");
+    snprintf(buf, size, "%s%s%s%s%s%s", home ? home : "", home ? "/" : "", MEMO_DIRNAME,
+             sub ? "/" : "", sub ? sub : "", name ? "/" : "");
+    if (name) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, size - len, "%s", name);
+    }
+    return buf;
+}
+
+static int ensure_store(void) {
+    char path[PATH_MAX];
+    const char* subs[] = {NULL, "objects", "keys"};
+    for (int i = 0; i < 3; i++) {
+        if (mkdir(store_path(path, sizeof(path), subs[i], NULL), 0700) != 0 && errno != EEXIST) {
+            fprintf(stderr, "memo: %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads the object a key names into `object` (HASH_HEX + 1 bytes).
+static int read_key(const char* key_path, char* object) {
+    int fd = open(key_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, object, HASH_HEX);
+    close(fd);
+    if (n != HASH_HEX) return -1;
+    object[HASH_HEX] = '\0';
+    return strspn(object, "0123456789abcdef") == HASH_HEX ? 0 : -1;
+}
+
+typedef struct {
+    char name[HASH_HEX + 1];
+    off_t size;
+    time_t used; // mtime, touched on every hit
+} ObjectInfo;
+
+static int oldest_first(const void* a, const void* b) {
+    time_t x = ((const ObjectInfo*)a)->used, y = ((const ObjectInfo*)b)->used;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Lists the store's objects into *out (malloc'd, may be NULL) and
+ * sums their sizes into *total. Temporary files old enough to have been
+ * left by a shell that died mid-run are removed on the way.
+ * @return The number of objects, or -1.
+ */
+static int list_objects(ObjectInfo** out, unsigned long long* total) {
+    char dir_path[PATH_MAX], path[PATH_MAX + NAME_MAX + 2];
+    *out = NULL;
+    *total = 0;
+    DIR* dir = opendir(store_path(dir_path, sizeof(dir_path), "objects", NULL));
+    if (!dir) return errno == ENOENT ? 0 : -1;
+    int count = 0, capacity = 0;
+    time_t now = time(NULL);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (entry->d_name[0] == '.') {
+            if (strncmp(entry->d_name, ".tmp.", 5) == 0 && stat(path, &st) == 0 &&
+                now - st.st_mtime > STALE_TEMP_SECONDS) {
+                unlink(path);
+            }
+            continue;
+        }
+        if (strlen(entry->d_name) != HASH_HEX || stat(path, &st) != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            ObjectInfo* tmp = realloc(*out, capacity * sizeof(ObjectInfo));
+            if (!tmp) {
+                closedir(dir);
+                free(*out);
+                *out = NULL;
+                return -1;
+            }
+            *out = tmp;
+        }
+        ObjectInfo* info = &(*out)[count++];
+        memcpy(info->name, entry->d_name, HASH_HEX + 1);
+        info->size = st.st_size;
+        info->used = st.st_mtime;
+        *total += (unsigned long long)st.st_size;
+    }
+    closedir(dir);
+    return count;
+}
+
+// Drops the keys whose object is gone (evicted, or cleared).
+static void prune_keys(int remove_all) {
+    char dir_path[PATH_MAX], path[PATH_MAX + NAME_MAX + 2];
+    char object[HASH_HEX + 1], object_path[PATH_MAX];
+    DIR* dir = opendir(store_path(dir_path, sizeof(dir_path), "keys", NULL));
+    if (!dir) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (remove_all || read_key(path, object) != 0 ||
+            access(store_path(object_path, sizeof(object_path), "objects", object), F_OK) != 0) {
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+// Removes the least recently used objects until the store fits in `limit`.
+static void trim_store(unsigned long long limit) {
+    ObjectInfo* objects;
+    unsigned long long total;
+    int count = list_objects(&objects, &total);
+    if (count <= 0 || total <= limit) {
+        free(objects);
+        return;
+    }
+    qsort(objects, count, sizeof(ObjectInfo), oldest_first);
+    char path[PATH_MAX];
+    for (int i = 0; i < count && total > limit; i++) {
+        if (unlink(store_path(path, sizeof(path), "objects", objects[i].name)) == 0) {
+            total -= (unsigned long long)objects[i].size;
+        }
+    }
+    free(objects);
+    prune_keys(0);
+}
+
+// --- Running ---
+
+static void usage_error(const char* message, const char* arg) {
+    fprintf(stderr, "memo: %s%s%s\n", message, arg ? ": " : "", arg ? arg : "");
+}
+
+int memo_take_prefix(CommandPipeline* pipeline, Memo** memo) {
+    *memo = NULL;
+    SimpleCommand* cmd = &pipeline->commands[0];
+    // A bare `memo`, or `memo --stats` and the like, is the builtin.
+    if (cmd->arg_count < 2 || strcmp(cmd->args[0], "memo") != 0 ||
+        (strncmp(cmd->args[1], "--", 2) == 0 && cmd->args[1][2] != '\0')) {
+        return 0;
+    }
+
+    // The declared inputs go into the key as they are read.
+    Hash h = hash_init();
+    int i = 1;
+    for (; cmd->args[i] && cmd->args[i][0] == '-'; i++) {
+        const char* option = cmd->args[i];
+        if (strcmp(option, "--") == 0) {
+            i++;
+            break;
+        }
+        if ((strcmp(option, "-f") != 0 && strcmp(option, "-e") != 0) || cmd->args[i + 1] == NULL) {
+            usage_error(cmd->args[i + 1] ? "unknown option" : "option needs an argument", option);
+            return -1;
+        }
+        h = hash_string(h, option);
+        h = option[1] == 'f' ? hash_file_identity(h, cmd->args[i + 1]) : hash_env(h, cmd->args[i + 1]);
+        i++;
+    }
+    if (cmd->args[i] == NULL) {
+        usage_error("missing command", NULL);
+        return -1;
+    }
+    for (int j = 0; j < i; j++) {
+        free(cmd->args[j]);
+    }
+    memmove(cmd->args, cmd->args + i, (size_t)(cmd->arg_count - i + 1) * sizeof(char*));
+    cmd->arg_count -= i;
+
+    // Neither the output of a background job nor what a <(...) path will
+    // hold is known up front; such pipelines just run.
+    if (pipeline->mode == BACKGROUND || procsub_pending()) {
+        usage_error(pipeline->mode == BACKGROUND ? "not memoizing a background job"
+                                                 : "not memoizing process substitution", NULL);
+        return 0;
+    }
+
+    Memo* m = calloc(1, sizeof(Memo));
+    if (!m) {
+        perror("memo: calloc");
+        return -1;
+    }
+    m->dest_fd = m->read_fd = m->write_fd = m->temp_fd = -1;
+    hash_hex(hash_pipeline(h, pipeline), m->key);
+    *memo = m;
+    return 0;
+}
+
+// Opens the last command's `>` file for the output, or leaves *fd at -1
+// for stdout. Returns -1 with errno set if the file can't be opened.
+static int open_destination(CommandPipeline* pipeline, int* fd) {
+    SimpleCommand* last = &pipeline->commands[pipeline->num_commands - 1];
+    *fd = -1;
+    if (!last->output_file) {
+        return 0;
+    }
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (last->append_mode ? O_APPEND : O_TRUNC);
+    *fd = open(last->output_file, flags, 0644);
+    return *fd < 0 ? -1 : 0;
+}
+
+int memo_replay(Memo* memo, CommandPipeline* pipeline) {
+    char key_path[PATH_MAX], object[HASH_HEX + 1], object_path[PATH_MAX];
+    store_path(key_path, sizeof(key_path), "keys", memo->key);
+    int object_fd = -1;
+    if (read_key(key_path, object) == 0) {
+        object_fd = open(store_path(object_path, sizeof(object_path), "objects", object), O_RDONLY | O_CLOEXEC);
+        if (object_fd < 0) {
+            unlink(key_path); // Its output was evicted
+        }
+    }
+    if (object_fd < 0) {
+        misses++;
+        return 0;
+    }
+
+    int dest_fd;
+    if (open_destination(pipeline, &dest_fd) != 0) {
+        perror("shell: output file");
+        close(object_fd);
+        set_last_status(1);
+        return 1;
+    }
+    fflush(stdout);
+    char buf[COPY_BUFFER];
+    ssize_t n;
+    unsigned long long replayed = 0;
+    while ((n = read(object_fd, buf, sizeof(buf))) > 0 &&
+           write_all(dest_fd >= 0 ? dest_fd : STDOUT_FILENO, buf, (size_t)n) == 0) {
+        replayed += (unsigned long long)n;
+    }
+    futimens(object_fd, NULL); // Recently used, so evicted last
+    close(object_fd);
+    if (dest_fd >= 0) {
+        close(dest_fd);
+    }
+    hits++;
+    bytes_replayed += replayed;
+    set_last_status(0);
+    return 1;
+}
+
+int memo_record(Memo* memo, CommandPipeline* pipeline) {
+    // A `>` file that can't be opened is left for the command to report.
+    if (open_destination(pipeline, &memo->dest_fd) != 0 || ensure_store() != 0) {
+        return -1;
+    }
+    char dir_path[PATH_MAX];
+    snprintf(memo->temp_path, sizeof(memo->temp_path), "%s/.tmp.%d.%u",
+             store_path(dir_path, sizeof(dir_path), "objects", NULL), (int)getpid(), temp_counter++);
+    memo->temp_fd = open(memo->temp_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (memo->temp_fd < 0) {
+        fprintf(stderr, "memo: %s: %s\n", memo->temp_path, strerror(errno));
+        return -1;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        perror("memo: pipe");
+        unlink(memo->temp_path);
+        close(memo->temp_fd);
+        memo->temp_fd = -1;
+        return -1;
+    }
+    // The copying process writes the `>` file from now on.
+    SimpleCommand* last = &pipeline->commands[pipeline->num_commands - 1];
+    free(last->output_file);
+    last->output_file = NULL;
+    memo->read_fd = fds[0];
+    memo->write_fd = fds[1];
+    return memo->write_fd;
+}
+
+// The copying process: passes the output on and keeps a copy. Exits 0 only
+// if the copy is complete.
+static void copy_output(Memo* memo) {
+    int dest_fd = memo->dest_fd >= 0 ? memo->dest_fd : STDOUT_FILENO;
+    int kept = 1, passed = 1;
+    char buf[COPY_BUFFER];
+    ssize_t n;
+    while ((n = read(memo->read_fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            exit(EXIT_FAILURE);
+        }
+        // Carry on reading when the terminal or file fails, so the command
+        // doesn't die of SIGPIPE halfway; its output is still worth keeping.
+        passed = passed && write_all(dest_fd, buf, (size_t)n) == 0;
+        kept = kept && write_all(memo->temp_fd, buf, (size_t)n) == 0;
+    }
+    exit(kept ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void memo_start(Memo* memo, pid_t pgid) {
+    close(memo->write_fd); // Only the last command writes to it now
+    memo->write_fd = -1;
+    out_flush(); // Don't let the child inherit (and repeat) pending output
+    shellstat.forks++;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("memo: fork"); // The last command sees EPIPE; nothing is kept
+    } else if (pid == 0) {
+        setpgid(0, pgid);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        __fpurge(stdin); // The shell's read-ahead isn't ours; see execute_child_command()
+        copy_output(memo);
+    } else {
+        setpgid(pid, pgid);
+        memo->copier = pid;
+    }
+    close(memo->read_fd);
+    memo->read_fd = -1;
+    if (memo->dest_fd >= 0) {
+        close(memo->dest_fd);
+        memo->dest_fd = -1;
+    }
+}
+
+// Files the finished temporary file under the hash of its contents.
+static void keep_output(Memo* memo) {
+    Hash h = hash_init();
+    char buf[COPY_BUFFER], object[HASH_HEX + 1];
+    char object_path[PATH_MAX], key_path[PATH_MAX], key_temp[PATH_MAX + 32];
+    ssize_t n;
+    off_t at = 0;
+    for (; (n = pread(memo->temp_fd, buf, sizeof(buf), at)) > 0; at += n) {
+        h = hash_bytes(h, buf, (size_t)n);
+    }
+    if (n < 0) {
+        unlink(memo->temp_path);
+        return;
+    }
+    hash_hex(h, object);
+    store_path(object_path, sizeof(object_path), "objects", object);
+    if (access(object_path, F_OK) == 0) {
+        unlink(memo->temp_path); // Same output as another run
+        utimensat(AT_FDCWD, object_path, NULL, 0);
+    } else if (rename(memo->temp_path, object_path) != 0) {
+        unlink(memo->temp_path);
+        return;
+    }
+
+    // Written aside and renamed, so another shell never reads half a key.
+    store_path(key_path, sizeof(key_path), "keys", memo->key);
+    snprintf(key_temp, sizeof(key_temp), "%s.tmp.%d", key_path, (int)getpid());
+    int fd = open(key_temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    object[HASH_HEX] = '\n';
+    int ok = fd >= 0 && write_all(fd, object, HASH_HEX + 1) == 0;
+    if (fd >= 0) close(fd);
+    if (!ok || rename(key_temp, key_path) != 0) {
+        unlink(key_temp);
+        return;
+    }
+    stores++;
+    trim_store(max_size);
+}
+
+void memo_finish(Memo* memo, int stopped, int status) {
+    if (memo == NULL) {
+        return;
+    }
+    int copied = 0;
+    // A stopped job's copier stops with it, and is reaped with the job.
+    if (memo->copier > 0 && !stopped) {
+        int copier_status;
+        while (waitpid(memo->copier, &copier_status, 0) < 0 && errno == EINTR) {
+        }
+        copied = WIFEXITED(copier_status) && WEXITSTATUS(copier_status) == 0;
+    }
+    if (memo->temp_fd >= 0) {
+        if (copied && status == 0) {
+            keep_output(memo);
+        } else {
+            unlink(memo->temp_path);
+        }
+        close(memo->temp_fd);
+    }
+    if (memo->read_fd >= 0) close(memo->read_fd);
+    if (memo->write_fd >= 0) close(memo->write_fd);
+    if (memo->dest_fd >= 0) close(memo->dest_fd);
+    free(memo);
+}
+
+void memo_get_stats(unsigned long long* hit_count, unsigned long long* miss_count) {
+    *hit_count = hits;
+    *miss_count = misses;
+}
+
+/**
+ * @brief Implements `memo` (statistics), `memo --clear` and
+ * `memo --max-size <bytes>`. As a prefix, `memo` is handled by
+ * memo_take_prefix() instead.
+ */
+void execute_memo(char** args) {
+    if (args[1] == NULL || strcmp(args[1], "--stats") == 0) {
+        ObjectInfo* objects;
+        unsigned long long total;
+        int count = list_objects(&objects, &total);
+        free(objects);
+        unsigned long long lookups = hits + misses;
+        out_printf("hits: %llu, misses: %llu (%.0f%% hit rate)\n", hits, misses,
+                   lookups ? 100.0 * hits / lookups : 0.0);
+        out_printf("stored: %llu outputs, replayed: %llu bytes\n", stores, bytes_replayed);
+        out_printf("store: %d objects, %llu / %llu bytes\n", count < 0 ? 0 : count, total, max_size);
+    } else if (strcmp(args[1], "--clear") == 0) {
+        trim_store(0);
+        prune_keys(1);
+    } else if (strcmp(args[1], "--max-size") == 0 && args[2] != NULL) {
+        char* end;
+        unsigned long long bytes = strtoull(args[2], &end, 10);
+        if (*end != '\0' || args[2][0] == '-') {
+            fprintf(stderr, "memo: invalid size '%s'\n", args[2]);
+            set_builtin_status(1);
+            return;
+        }
+        max_size = bytes;
+        trim_store(max_size);
+    } else if (strncmp(args[1], "--", 2) == 0) {
+        fprintf(stderr, "memo: usage: memo [--stats | --clear | --max-size BYTES]\n");
+        set_builtin_status(2);
+    } else {
+        fprintf(stderr, "memo: must start a foreground pipeline\n");
+        set_builtin_status(2);
+    }
+}
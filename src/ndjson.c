@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+// Custom headers
+#include "ndjson.h"
+#include "output.h"
+
+static int fields = 0; // Fields so far in the current record
+
+// Writes `s` quoted, copying the runs that need no escape in one go.
+static void put_escaped(const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    out_putc('"');
+    while (*s) {
+        size_t run = 0;
+        unsigned char c;
+        while ((c = (unsigned char)s[run]) != '\0' && c >= 0x20 && c != 0x7f && c != '"' && c != '\\') {
+            run++;
+        }
+        out_write(s, run);
+        s += run;
+        if (c == '\0') {
+            break;
+        }
+        if (c == '"' || c == '\\') {
+            char escape[2] = {'\\', (char)c};
+            out_write(escape, 2);
+        } else if (c == '\n') {
+            out_write("\\n", 2);
+        } else if (c == '\t') {
+            out_write("\\t", 2);
+        } else {
+            char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            out_write(escape, 6);
+        }
+        s++;
+    }
+    out_putc('"');
+}
+
+// Writes `"key":` after a comma if the record already has a field.
+static void put_key(const char* key) {
+    out_printf("%s\"%s\":", fields > 0 ? "," : "", key);
+    fields++;
+}
+
+void ndjson_begin(void) {
+    out_putc('{');
+    fields = 0;
+}
+
+void ndjson_string(const char* key, const char* value) {
+    put_key(key);
+    if (value == NULL) {
+        out_write("null", 4);
+    } else {
+        put_escaped(value);
+    }
+}
+
+void ndjson_int(const char* key, long long value) {
+    put_key(key);
+    out_printf("%lld", value);
+}
+
+void ndjson_uint(const char* key, unsigned long long value) {
+    put_key(key);
+    out_printf("%llu", value);
+}
+
+void ndjson_end(void) {
+    out_write("}\n", 2);
+}
+
+int ndjson_finish(void) {
+    return out_flush();
+}
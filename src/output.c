@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Custom headers
+#include "output.h"
+
+#define OUT_BUFFER (64 * 1024)
+
+static char buffer[OUT_BUFFER];
+static size_t used = 0;
+static int terminal = -1;   // Whether stdout is a terminal; -1 until the first write
+static int write_error = 0; // errno of the first failed write since out_flush()
+
+// Writes the iovecs out in full, adjusting them past partial writes.
+static void write_iov(struct iovec* iov, int count) {
+    while (count > 0 && !write_error) {
+        ssize_t n = writev(STDOUT_FILENO, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            write_error = errno;
+            return;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+static void write_buffer(void) {
+    if (used > 0) {
+        struct iovec iov = {buffer, used};
+        write_iov(&iov, 1);
+    }
+    used = 0;
+}
+
+// Called before each write: the first one of a builtin puts out what stdio
+// still holds, so that it comes first, and looks at where stdout goes.
+static void start(void) {
+    if (terminal < 0) {
+        fflush(stdout);
+        terminal = isatty(STDOUT_FILENO);
+    }
+}
+
+void out_write(const char* data, size_t len) {
+    start();
+    if (used + len <= sizeof(buffer)) {
+        memcpy(buffer + used, data, len);
+        used += len;
+    } else {
+        struct iovec iov[2] = {{buffer, used}, {(void*)data, len}};
+        write_iov(iov, 2);
+        used = 0;
+    }
+    if (terminal && memchr(data, '\n', len)) {
+        write_buffer();
+    }
+}
+
+void out_puts(const char* s) {
+    out_write(s, strlen(s));
+}
+
+void out_putc(char c) {
+    start();
+    if (used == sizeof(buffer)) {
+        write_buffer();
+    }
+    buffer[used++] = c;
+    if (terminal && c == '\n') {
+        write_buffer();
+    }
+}
+
+void out_printf(const char* format, ...) {
+    start();
+    va_list ap;
+    va_start(ap, format);
+    size_t room = sizeof(buffer) - used;
+    int n = vsnprintf(buffer + used, room, format, ap);
+    va_end(ap);
+    if (n < 0) {
+        return;
+    }
+
+    size_t at = used;
+    if ((size_t)n < room) {
+        used += (size_t)n;
+    } else {
+        // It didn't fit: format it again after the buffer is written, or on
+        // the heap if the whole buffer wouldn't hold it either.
+        write_buffer();
+        at = 0;
+        va_start(ap, format);
+        if ((size_t)n < sizeof(buffer)) {
+            vsnprintf(buffer, sizeof(buffer), format, ap);
+            used = (size_t)n;
+        } else {
+            char* big = malloc((size_t)n + 1);
+            if (big) {
+                vsnprintf(big, (size_t)n + 1, format, ap);
+                struct iovec iov = {big, (size_t)n};
+                write_iov(&iov, 1);
+                free(big);
+            }
+            n = 0; // Already written
+        }
+        va_end(ap);
+    }
+    if (terminal && memchr(buffer + at, '\n', (size_t)n)) {
+        write_buffer();
+    }
+}
+
+void out_writev(const struct iovec* iov, int count) {
+    start();
+    size_t total = 0;
+    int newline = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+        newline = newline || (terminal && memchr(iov[i].iov_base, '\n', iov[i].iov_len));
+    }
+
+    if (used + total <= sizeof(buffer)) {
+        for (int i = 0; i < count; i++) {
+            memcpy(buffer + used, iov[i].iov_base, iov[i].iov_len);
+            used += iov[i].iov_len;
+        }
+    } else {
+        struct iovec all[OUT_IOV_MAX + 1];
+        all[0].iov_base = buffer;
+        all[0].iov_len = used;
+        memcpy(all + 1, iov, (size_t)count * sizeof(struct iovec));
+        write_iov(all, count + 1);
+        used = 0;
+    }
+    if (newline) {
+        write_buffer();
+    }
+}
+
+int out_flush(void) {
+    write_buffer();
+    fflush(stdout);
+    if (write_error) {
+        errno = write_error;
+        write_error = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int out_end(void) {
+    int result = out_flush();
+    terminal = -1;
+    return result;
+}
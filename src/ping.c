@@ -4,6 +4,7 @@
 #include <signal.h>
 #include <errno.h>
 #include "ping.h"
+#include "output.h"
 
 /**
  * @brief Implements the 'ping' built-in command.
@@ -36,12 +37,12 @@ void execute_ping(char** args) {
     // It returns 0 on success and -1 on error.
     if (kill(pid, actual_signal) == 0) {
         // Success case
-        printf("Sent signal %d to process with pid %d\n", signal_number, pid);
+        out_printf("Sent signal %d to process with pid %d\n", signal_number, pid);
     } else {
         // Error case. We check the `errno` variable to see why it failed.
         if (errno == ESRCH) {
             // ESRCH means "No such process". This is the specific required message.
-            printf("No such process found\n");
+            out_printf("No such process found\n");
         } else {
             // For other errors (like permission denied), print a generic message.
             perror("ping: kill");
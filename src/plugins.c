@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+// Custom headers
+#include "plugins.h"
+#include "vars.h"
+#include "output.h"
+#include "builtins.h"
+
+/*
+ * Builtins loaded from shared objects with `enable -f`.
+ *
+ * Each library is dlopen()ed once and stays loaded while any of its builtins
+ * is enabled. Loaded builtins live in a small fixed table searched linearly;
+ * find_builtin() only gets here after missing the built-in table, and with no
+ * plugins loaded that costs nothing.
+ */
+
+#define MAX_PLUGIN_LIBS 16
+#define MAX_PLUGIN_BUILTINS 64
+
+typedef struct {
+    char* path;
+    void* handle;
+    const ShellPlugin* plugin;
+    int refs; // Enabled builtins from this library
+} PluginLib;
+
+typedef struct {
+    Builtin builtin;
+    const char* usage;
+    int lib;
+} PluginBuiltin;
+
+static PluginLib libs[MAX_PLUGIN_LIBS];
+static int num_libs = 0;
+static PluginBuiltin plugin_builtins[MAX_PLUGIN_BUILTINS];
+static int num_plugin_builtins = 0;
+
+const Builtin* find_plugin_builtin(const char* name) {
+    for (int i = 0; i < num_plugin_builtins; i++) {
+        if (strcmp(plugin_builtins[i].builtin.name, name) == 0) {
+            return &plugin_builtins[i].builtin;
+        }
+    }
+    return NULL;
+}
+
+int run_plugin_builtin(const Builtin* builtin, char** args) {
+    // The plugin writes to the fds directly; keep our buffered output ahead of it.
+    out_flush();
+    fflush(stderr);
+
+    int argc = 0;
+    while (args[argc] != NULL) {
+        argc++;
+    }
+    ShellPluginContext ctx = {
+        .abi_version = SHELL_PLUGIN_ABI_VERSION,
+        .size = sizeof(ShellPluginContext),
+        .argc = argc,
+        .argv = args,
+        .in_fd = 0,
+        .out_fd = 1,
+        .err_fd = 2,
+        .alloc = malloc,
+        .resize = realloc,
+        .release = free,
+        .get_var = vars_get,
+    };
+    return builtin->plugin(&ctx);
+}
+
+/**
+ * @brief Returns the index of the library at `path`, loading it if needed.
+ * @return -1 (after printing why) if it can't be used.
+ */
+static int load_plugin_lib(const char* path) {
+    for (int i = 0; i < num_libs; i++) {
+        if (strcmp(libs[i].path, path) == 0) {
+            return i;
+        }
+    }
+    if (num_libs == MAX_PLUGIN_LIBS) {
+        fprintf(stderr, "enable: too many plugin libraries loaded\n");
+        return -1;
+    }
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "enable: %s\n", dlerror());
+        return -1;
+    }
+    const ShellPlugin* plugin = dlsym(handle, SHELL_PLUGIN_SYMBOL);
+    if (plugin == NULL) {
+        fprintf(stderr, "enable: %s: no '%s' symbol\n", path, SHELL_PLUGIN_SYMBOL);
+        dlclose(handle);
+        return -1;
+    }
+    if (plugin->abi_version != SHELL_PLUGIN_ABI_VERSION) {
+        fprintf(stderr, "enable: %s: plugin ABI version %d, shell supports %d\n",
+                path, plugin->abi_version, SHELL_PLUGIN_ABI_VERSION);
+        dlclose(handle);
+        return -1;
+    }
+    libs[num_libs] = (PluginLib){strdup(path), handle, plugin, 0};
+    return num_libs++;
+}
+
+/**
+ * @brief Closes a library with no enabled builtins left, keeping the
+ * table compact.
+ */
+static void release_plugin_lib(int lib) {
+    if (libs[lib].refs > 0) {
+        return;
+    }
+    dlclose(libs[lib].handle);
+    free(libs[lib].path);
+    num_libs--;
+    if (lib != num_libs) {
+        libs[lib] = libs[num_libs];
+        for (int i = 0; i < num_plugin_builtins; i++) {
+            if (plugin_builtins[i].lib == num_libs) {
+                plugin_builtins[i].lib = lib;
+            }
+        }
+    }
+}
+
+static int enable_plugin_builtin(int lib, const ShellPluginBuiltin* pb) {
+    const Builtin* existing = find_builtin(pb->name);
+    if (existing != NULL) {
+        if (existing->plugin == pb->fn) {
+            return 0; // Already enabled from this library
+        }
+        fprintf(stderr, "enable: %s: already a builtin\n", pb->name);
+        return -1;
+    }
+    if (num_plugin_builtins == MAX_PLUGIN_BUILTINS) {
+        fprintf(stderr, "enable: too many plugin builtins\n");
+        return -1;
+    }
+    PluginBuiltin* slot = &plugin_builtins[num_plugin_builtins++];
+    slot->builtin = (Builtin){pb->name, NULL, BUILTIN_PIPELINE, pb->fn};
+    slot->usage = pb->usage;
+    slot->lib = lib;
+    libs[lib].refs++;
+    return 0;
+}
+
+/**
+ * @brief `enable -f path [name...]`: loads the named builtins from `path`,
+ * or all of them if none are named.
+ */
+static void enable_from_file(const char* path, char** names) {
+    int lib = load_plugin_lib(path);
+    if (lib < 0) {
+        set_builtin_status(1);
+        return;
+    }
+    const ShellPluginBuiltin* builtins = libs[lib].plugin->builtins;
+    if (names[0] == NULL) {
+        for (int i = 0; builtins[i].name != NULL; i++) {
+            if (enable_plugin_builtin(lib, &builtins[i]) < 0) set_builtin_status(1);
+        }
+    }
+    for (int n = 0; names[n] != NULL; n++) {
+        int i = 0;
+        while (builtins[i].name != NULL && strcmp(builtins[i].name, names[n]) != 0) {
+            i++;
+        }
+        if (builtins[i].name == NULL) {
+            fprintf(stderr, "enable: %s: not found in %s\n", names[n], path);
+            set_builtin_status(1);
+            continue;
+        }
+        if (enable_plugin_builtin(lib, &builtins[i]) < 0) set_builtin_status(1);
+    }
+    release_plugin_lib(lib); // In case nothing was enabled
+}
+
+static void disable_plugin_builtin(const char* name) {
+    for (int i = 0; i < num_plugin_builtins; i++) {
+        if (strcmp(plugin_builtins[i].builtin.name, name) == 0) {
+            int lib = plugin_builtins[i].lib;
+            plugin_builtins[i] = plugin_builtins[--num_plugin_builtins];
+            libs[lib].refs--;
+            release_plugin_lib(lib);
+            return;
+        }
+    }
+    fprintf(stderr, "enable: %s: not a loaded builtin\n", name);
+    set_builtin_status(1);
+}
+
+/**
+ * @brief Implements `enable` (list loaded builtins), `enable -f path [name...]`
+ * and `enable -d name...`.
+ */
+void execute_enable(char** args) {
+    if (args[1] == NULL) {
+        for (int i = 0; i < num_plugin_builtins; i++) {
+            const PluginBuiltin* pb = &plugin_builtins[i];
+            out_printf("%-12s %s  (%s)\n", pb->builtin.name, pb->usage ? pb->usage : "",
+                       libs[pb->lib].path);
+        }
+    } else if (strcmp(args[1], "-f") == 0 && args[2] != NULL) {
+        enable_from_file(args[2], &args[3]);
+    } else if (strcmp(args[1], "-d") == 0 && args[2] != NULL) {
+        for (int i = 2; args[i] != NULL; i++) {
+            disable_plugin_builtin(args[i]);
+        }
+    } else {
+        fprintf(stderr, "enable: invalid argument. Usage: enable [-f <library> [name...] | -d <name...>]\n");
+        set_builtin_status(1);
+    }
+}
@@ -0,0 +1,471 @@
+#define _GNU_SOURCE // For pread() and nanosleep() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+// Custom headers
+#include "procmon.h"
+#include "jobs.h"
+#include "output.h"
+#include "main.h" // For info.pid
+#include "builtins.h"
+
+/*
+ * Resource monitor behind `activities --watch` and `activities --once`.
+ *
+ * Every process of a job is found by walking down from the shell through
+ * /proc/<pid>/task/<pid>/children: the shell's children in a job's process
+ * group are the job's members, and everything below them belongs to the same
+ * job. For each such process the monitor opens stat, statm, io and children
+ * once and re-reads them with pread() on every sample, so a sample costs a
+ * few reads per process and no opens. A process that exits makes its fds
+ * fail with ESRCH and it is dropped; the fds can't be confused with a later
+ * process that reuses the pid. Without the children files (kernels built
+ * without CONFIG_PROC_CHILDREN), /proc is scanned for the jobs' process
+ * groups instead.
+ */
+
+#define DEFAULT_WATCH_INTERVAL 1.0
+#define DEFAULT_ONCE_INTERVAL 0.2
+#define MAX_TRACKED_PROCS 512
+
+typedef struct {
+    pid_t pid;
+    int job_id;
+    int stat_fd;
+    int statm_fd;
+    int io_fd;       // -1 if unreadable (e.g. a setuid program)
+    int children_fd; // -1 if the kernel doesn't provide it
+    unsigned long seen_round;    // Last sample that found this process
+    unsigned long sampled_round; // Last sample that read it
+    int has_prev;
+    unsigned long long prev_ticks;
+    unsigned long long prev_rchar;
+    unsigned long long prev_wchar;
+    double prev_time;
+} ProcTrack;
+
+typedef struct {
+    ProcTrack* procs;
+    int count;
+    int capacity;
+    int self_children_fd; // The shell's own children file, -1 to scan /proc
+    unsigned long round;
+    long clk_tck;
+    long page_size;
+} Monitor;
+
+typedef struct {
+    Job job;
+    int procs;
+    int threads;
+    double cpu_pct;
+    unsigned long long rss;
+    double read_bps;
+    double write_bps;
+} JobUsage;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Re-reads a /proc file from the start into buf. Returns the length or -1.
+static ssize_t read_proc(int fd, char* buf, size_t size) {
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+static int open_proc_file(pid_t pid, const char* name) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+typedef struct {
+    char state;
+    int pgrp;
+    int threads;
+    unsigned long long ticks; // utime + stime
+} StatFields;
+
+static int parse_stat(const char* buf, StatFields* f) {
+    // The command name is in parentheses and may contain anything, so
+    // parse from the last ')'.
+    const char* p = strrchr(buf, ')');
+    if (!p || p[1] == '\0') return -1;
+    unsigned long long utime, stime;
+    if (sscanf(p + 2, "%c %*d %d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %d",
+               &f->state, &f->pgrp, &utime, &stime, &f->threads) != 5) {
+        return -1;
+    }
+    f->ticks = utime + stime;
+    return 0;
+}
+
+static void close_proc(ProcTrack* p) {
+    close(p->stat_fd);
+    if (p->statm_fd >= 0) close(p->statm_fd);
+    if (p->io_fd >= 0) close(p->io_fd);
+    if (p->children_fd >= 0) close(p->children_fd);
+}
+
+static int find_proc(Monitor* m, pid_t pid) {
+    for (int i = 0; i < m->count; i++) {
+        if (m->procs[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+// Starts tracking a process. Returns its index, or -1.
+static int track_proc(Monitor* m, pid_t pid, int job_id) {
+    int idx = find_proc(m, pid);
+    if (idx >= 0) return idx;
+    if (m->count >= MAX_TRACKED_PROCS) return -1;
+
+    if (m->count == m->capacity) {
+        int new_capacity = m->capacity ? m->capacity * 2 : 16;
+        ProcTrack* tmp = realloc(m->procs, new_capacity * sizeof(ProcTrack));
+        if (!tmp) return -1;
+        m->procs = tmp;
+        m->capacity = new_capacity;
+    }
+
+    ProcTrack* p = &m->procs[m->count];
+    memset(p, 0, sizeof(*p));
+    p->pid = pid;
+    p->job_id = job_id;
+    p->stat_fd = open_proc_file(pid, "stat");
+    if (p->stat_fd < 0) return -1;
+    p->statm_fd = open_proc_file(pid, "statm");
+    p->io_fd = open_proc_file(pid, "io");
+    char children[64];
+    snprintf(children, sizeof(children), "task/%d/children", (int)pid);
+    p->children_fd = open_proc_file(pid, children);
+    return m->count++;
+}
+
+static int job_id_for_pgrp(const JobUsage* usage, int njobs, int pgrp) {
+    for (int i = 0; i < njobs; i++) {
+        if (usage[i].job.pgid == pgrp) return usage[i].job.job_id;
+    }
+    return -1;
+}
+
+static JobUsage* usage_for_job(JobUsage* usage, int njobs, int job_id) {
+    for (int i = 0; i < njobs; i++) {
+        if (usage[i].job.job_id == job_id) return &usage[i];
+    }
+    return NULL;
+}
+
+// Job id of a process we aren't tracking yet, judged by its process group.
+static int job_of_new_proc(pid_t pid, const JobUsage* usage, int njobs) {
+    int fd = open_proc_file(pid, "stat");
+    if (fd < 0) return -1;
+    char buf[1024];
+    StatFields f;
+    int job_id = -1;
+    if (read_proc(fd, buf, sizeof(buf)) > 0 && parse_stat(buf, &f) == 0) {
+        job_id = job_id_for_pgrp(usage, njobs, f.pgrp);
+    }
+    close(fd);
+    return job_id;
+}
+
+typedef struct {
+    int* items;
+    int count;
+    int capacity;
+} IndexQueue;
+
+static void queue_push(IndexQueue* q, int idx) {
+    if (q->count == q->capacity) {
+        int new_capacity = q->capacity ? q->capacity * 2 : 32;
+        int* tmp = realloc(q->items, new_capacity * sizeof(int));
+        if (!tmp) return;
+        q->items = tmp;
+        q->capacity = new_capacity;
+    }
+    q->items[q->count++] = idx;
+}
+
+// Tracks and queues every pid listed in the contents of a children file.
+static void queue_children(Monitor* m, IndexQueue* q, const char* buf, int job_id,
+                           const JobUsage* usage, int njobs) {
+    const char* p = buf;
+    while (*p) {
+        char* end;
+        long pid = strtol(p, &end, 10);
+        if (end == p) break;
+        p = end;
+        while (*p == ' ' || *p == '\n') p++;
+
+        int owner = job_id;
+        if (owner < 0) {
+            // A child of the shell: only job members are of interest.
+            int idx = find_proc(m, (pid_t)pid);
+            owner = idx >= 0 ? m->procs[idx].job_id : job_of_new_proc((pid_t)pid, usage, njobs);
+            if (owner < 0) continue;
+        }
+        int idx = track_proc(m, (pid_t)pid, owner);
+        if (idx >= 0) {
+            m->procs[idx].seen_round = m->round;
+            queue_push(q, idx);
+        }
+    }
+}
+
+// Fallback discovery: every process in a job's process group.
+static void scan_proc_for_jobs(Monitor* m, IndexQueue* q, const JobUsage* usage, int njobs) {
+    DIR* dir = opendir("/proc");
+    if (!dir) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)entry->d_name[0])) continue;
+        pid_t pid = (pid_t)atoi(entry->d_name);
+        int idx = find_proc(m, pid);
+        int job_id = idx >= 0 ? m->procs[idx].job_id : job_of_new_proc(pid, usage, njobs);
+        if (job_id < 0) continue;
+        idx = track_proc(m, pid, job_id);
+        if (idx >= 0) {
+            m->procs[idx].seen_round = m->round;
+            queue_push(q, idx);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Reads one process and adds its usage to its job. Returns -1 if
+ * the process has gone away.
+ */
+static int sample_proc(Monitor* m, ProcTrack* p, JobUsage* u, double now) {
+    char buf[1024];
+    StatFields f;
+    if (read_proc(p->stat_fd, buf, sizeof(buf)) <= 0 || parse_stat(buf, &f) != 0) {
+        return -1;
+    }
+
+    unsigned long long rss_pages = 0;
+    if (p->statm_fd >= 0 && read_proc(p->statm_fd, buf, sizeof(buf)) > 0) {
+        sscanf(buf, "%*u %llu", &rss_pages);
+    }
+    unsigned long long rchar = 0, wchar = 0;
+    if (p->io_fd >= 0 && read_proc(p->io_fd, buf, sizeof(buf)) > 0) {
+        sscanf(buf, "rchar: %llu wchar: %llu", &rchar, &wchar);
+    }
+
+    if (f.state != 'Z') {
+        u->procs++;
+        u->threads += f.threads;
+        u->rss += rss_pages * m->page_size;
+    }
+    if (p->has_prev && now > p->prev_time) {
+        double dt = now - p->prev_time;
+        u->cpu_pct += (double)(f.ticks - p->prev_ticks) / m->clk_tck / dt * 100.0;
+        u->read_bps += (double)(rchar - p->prev_rchar) / dt;
+        u->write_bps += (double)(wchar - p->prev_wchar) / dt;
+    }
+    p->has_prev = 1;
+    p->prev_ticks = f.ticks;
+    p->prev_rchar = rchar;
+    p->prev_wchar = wchar;
+    p->prev_time = now;
+    return 0;
+}
+
+/**
+ * @brief Takes one sample of every job. `usage` holds one entry per active
+ * job on entry and gets the totals filled in.
+ */
+static void sample_jobs(Monitor* m, JobUsage* usage, int njobs) {
+    m->round++;
+    double now = now_seconds();
+    IndexQueue queue = {0};
+
+    if (m->self_children_fd >= 0) {
+        static char buf[16384];
+        if (read_proc(m->self_children_fd, buf, sizeof(buf)) >= 0) {
+            queue_children(m, &queue, buf, -1, usage, njobs);
+        }
+    } else {
+        scan_proc_for_jobs(m, &queue, usage, njobs);
+    }
+
+    // Breadth-first down the process tree. Indices stay valid as the array
+    // grows; pointers into it don't.
+    for (int qi = 0; qi < queue.count; qi++) {
+        int idx = queue.items[qi];
+        if (m->procs[idx].sampled_round == m->round) continue;
+        m->procs[idx].sampled_round = m->round;
+
+        JobUsage* u = usage_for_job(usage, njobs, m->procs[idx].job_id);
+        if (!u || sample_proc(m, &m->procs[idx], u, now) != 0) {
+            m->procs[idx].seen_round = 0;
+            continue;
+        }
+        if (m->procs[idx].children_fd >= 0) {
+            char buf[4096];
+            if (read_proc(m->procs[idx].children_fd, buf, sizeof(buf)) > 0) {
+                queue_children(m, &queue, buf, m->procs[idx].job_id, usage, njobs);
+            }
+        }
+    }
+    free(queue.items);
+
+    // Forget processes that have exited or left their job.
+    int kept = 0;
+    for (int i = 0; i < m->count; i++) {
+        if (m->procs[i].seen_round == m->round) {
+            m->procs[kept++] = m->procs[i];
+        } else {
+            close_proc(&m->procs[i]);
+        }
+    }
+    m->count = kept;
+}
+
+static void init_monitor(Monitor* m) {
+    memset(m, 0, sizeof(*m));
+    // The shell's children, even when this runs in a pipeline stage forked
+    // from it, whose own children aren't the jobs.
+    char children[64];
+    snprintf(children, sizeof(children), "task/%d/children", (int)info.pid);
+    m->self_children_fd = open_proc_file(info.pid, children);
+    m->clk_tck = sysconf(_SC_CLK_TCK);
+    m->page_size = sysconf(_SC_PAGESIZE);
+}
+
+static void free_monitor(Monitor* m) {
+    for (int i = 0; i < m->count; i++) close_proc(&m->procs[i]);
+    free(m->procs);
+    if (m->self_children_fd >= 0) close(m->self_children_fd);
+}
+
+static int collect_usage(JobUsage* usage) {
+    Job jobs[MAX_JOBS];
+    int njobs = get_active_jobs(jobs);
+    for (int i = 0; i < njobs; i++) {
+        memset(&usage[i], 0, sizeof(JobUsage));
+        usage[i].job = jobs[i];
+    }
+    return njobs;
+}
+
+static void format_bytes(char* out, size_t size, double bytes) {
+    const char* units[] = {"B", "K", "M", "G", "T"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    if (unit == 0) snprintf(out, size, "%.0f%s", bytes, units[unit]);
+    else snprintf(out, size, "%.1f%s", bytes, units[unit]);
+}
+
+static void print_table(const JobUsage* usage, int njobs, double interval) {
+    if (isatty(STDOUT_FILENO)) {
+        out_printf("\033[H\033[2J"); // Redraw in place
+    }
+    out_printf("Every %.1fs: %d job%s\n", interval, njobs, njobs == 1 ? "" : "s");
+    out_printf("%-5s %-8s %-8s %5s %5s %7s %8s %9s %9s  %s\n",
+               "JOB", "PGID", "STATE", "PROCS", "THR", "CPU%", "RSS", "READ/s", "WRITE/s", "COMMAND");
+    for (int i = 0; i < njobs; i++) {
+        const JobUsage* u = &usage[i];
+        char id[16], rss[16], rd[16], wr[16];
+        snprintf(id, sizeof(id), "[%d]", u->job.job_id);
+        format_bytes(rss, sizeof(rss), (double)u->rss);
+        format_bytes(rd, sizeof(rd), u->read_bps);
+        format_bytes(wr, sizeof(wr), u->write_bps);
+        out_printf("%-5s %-8d %-8s %5d %5d %7.1f %8s %9s %9s  %s\n",
+                   id, (int)u->job.pgid,
+                   u->job.status == JOB_RUNNING ? "Running" : "Stopped",
+                   u->procs, u->threads, u->cpu_pct, rss, rd, wr, u->job.command);
+    }
+    out_flush();
+}
+
+// One line per job, tab-separated, raw numbers.
+static void print_raw(const JobUsage* usage, int njobs) {
+    out_printf("# job\tpgid\tstate\tprocs\tthreads\tcpu_pct\trss_bytes\tread_bps\twrite_bps\tcommand\n");
+    for (int i = 0; i < njobs; i++) {
+        const JobUsage* u = &usage[i];
+        out_printf("%d\t%d\t%s\t%d\t%d\t%.1f\t%llu\t%.0f\t%.0f\t%s\n",
+                   u->job.job_id, (int)u->job.pgid,
+                   u->job.status == JOB_RUNNING ? "Running" : "Stopped",
+                   u->procs, u->threads, u->cpu_pct, u->rss, u->read_bps, u->write_bps,
+                   u->job.command);
+    }
+    out_flush();
+}
+
+// Sleeps for `seconds`. Returns -1 if a signal (Ctrl-C) cut the sleep short.
+static int sleep_interval(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    return nanosleep(&ts, NULL) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Implements `activities --watch` and `activities --once`.
+ */
+void execute_activities_monitor(char** args) {
+    int once = strcmp(args[1], "--once") == 0;
+    double interval = once ? DEFAULT_ONCE_INTERVAL : DEFAULT_WATCH_INTERVAL;
+    long samples = -1; // Until Ctrl-C or no jobs are left
+
+    for (int i = 2; args[i] != NULL; i++) {
+        char* end;
+        if (strcmp(args[i], "-i") == 0 && args[i + 1]) {
+            interval = strtod(args[++i], &end);
+            if (*end != '\0' || interval <= 0) {
+                fprintf(stderr, "activities: invalid interval: %s\n", args[i]);
+                set_builtin_status(1);
+                return;
+            }
+        } else if (strcmp(args[i], "-n") == 0 && args[i + 1] && !once) {
+            samples = strtol(args[++i], &end, 10);
+            if (*end != '\0' || samples <= 0) {
+                fprintf(stderr, "activities: invalid count: %s\n", args[i]);
+                set_builtin_status(1);
+                return;
+            }
+        } else {
+            fprintf(stderr, "Usage: activities [--watch [-i secs] [-n count] | --once [-i secs]]\n");
+            set_builtin_status(1);
+            return;
+        }
+    }
+
+    Monitor m;
+    init_monitor(&m);
+    JobUsage usage[MAX_JOBS];
+
+    // The first sample only sets the baseline for the rates.
+    int njobs = collect_usage(usage);
+    sample_jobs(&m, usage, njobs);
+
+    while (1) {
+        if (sleep_interval(interval) != 0) break;
+        reap_finished_jobs();
+        njobs = collect_usage(usage);
+        sample_jobs(&m, usage, njobs);
+        if (once) {
+            print_raw(usage, njobs);
+            break;
+        }
+        print_table(usage, njobs, interval);
+        if (njobs == 0 || (samples > 0 && --samples == 0)) break;
+    }
+    free_monitor(&m);
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "procsub.h"
+#include "main.h" // For run_subshell_line
+#include "shellstat.h"
+#include "output.h"
+
+/*
+ * The substituted commands of the pipeline being expanded. They run in
+ * forked copies of the shell (like $(...)), so builtins work, and all of
+ * them start during expansion, before the command that reads or writes
+ * them, so they run concurrently with it and with each other.
+ */
+
+#define MAX_PROCSUBS 32
+
+typedef struct {
+    pid_t pid;
+    int fd;    // The shell's end of the pipe; -1 once closed
+} ProcSub;
+
+static ProcSub procsubs[MAX_PROCSUBS];
+static int procsub_count = 0;
+
+char* procsub_open(const char* command, int writes) {
+    if (procsub_count >= MAX_PROCSUBS) {
+        fprintf(stderr, "shell: too many process substitutions\n");
+        return NULL;
+    }
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("shell: pipe");
+        return NULL;
+    }
+    // <(cmd): cmd writes, the user of the path reads; >(cmd) the reverse.
+    int child_end = writes ? fds[0] : fds[1];
+    int shell_end = writes ? fds[1] : fds[0];
+
+    out_flush(); // Don't let the child inherit (and repeat) pending output
+    shellstat.forks++;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("shell: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        __fpurge(stdin); // The shell's read-ahead isn't ours; see execute_child_command()
+        // Another substitution's pipe held open here would keep it from
+        // seeing end of file.
+        for (int i = 0; i < procsub_count; i++) {
+            close(procsubs[i].fd);
+        }
+        procsub_count = 0;
+        close(shell_end);
+        if (dup2(child_end, writes ? STDIN_FILENO : STDOUT_FILENO) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        close(child_end);
+        run_subshell_line(command);
+    }
+
+    close(child_end);
+    char* path = malloc(32);
+    if (path == NULL) {
+        close(shell_end);
+        return NULL; // The child sees end of file or EPIPE and exits
+    }
+    snprintf(path, 32, "/dev/fd/%d", shell_end);
+    procsubs[procsub_count].pid = pid;
+    procsubs[procsub_count].fd = shell_end;
+    procsub_count++;
+    return path;
+}
+
+int procsub_pending(void) {
+    return procsub_count > 0;
+}
+
+void procsub_close(pid_t pgid) {
+    for (int i = 0; i < procsub_count; i++) {
+        if (procsubs[i].fd >= 0) {
+            close(procsubs[i].fd);
+            procsubs[i].fd = -1;
+        }
+        if (pgid > 0) {
+            setpgid(procsubs[i].pid, pgid); // Fails harmlessly if it already exited
+        }
+    }
+}
+
+void procsub_finish(int block) {
+    procsub_close(0);
+    for (int i = 0; block && i < procsub_count; i++) {
+        while (waitpid(procsubs[i].pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+    procsub_count = 0;
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+// Custom headers
+#include "record.h"
+#include "main.h"
+#include "vars.h"
+
+extern char** environ;
+
+/*
+ * Records go into a buffer that is written out when a command finishes, so
+ * recording costs one write() per command line. The buffer is ours rather
+ * than stdio's: a forked child that exit()s can't flush a copy of it into
+ * the file, and only the recording process writes it at exit.
+ *
+ * The environment the session starts with is recorded in full, and changes
+ * to it are found by comparing the exported variables with a sorted copy
+ * of the last ones before each command. That is a few dozen string
+ * compares, next to a parse and (usually) a fork.
+ */
+
+int record_enabled = 0;
+
+static int record_fd = -1;
+static pid_t record_owner = 0;
+static char* buffer = NULL;
+static size_t buffer_len = 0;
+static size_t buffer_cap = 0;
+static unsigned long long last_ns = 0;
+static char last_cwd[sizeof(info.cwd)];
+static char** last_env = NULL; // Sorted copies of the "NAME=value" strings
+static int last_env_count = 0;
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void append(const char* data, size_t len) {
+    if (buffer_len + len > buffer_cap) {
+        size_t new_cap = buffer_cap ? buffer_cap : 4096;
+        while (new_cap < buffer_len + len) new_cap *= 2;
+        char* tmp = realloc(buffer, new_cap);
+        if (!tmp) return; // Drop the record rather than the session
+        buffer = tmp;
+        buffer_cap = new_cap;
+    }
+    memcpy(buffer + buffer_len, data, len);
+    buffer_len += len;
+}
+
+static void append_escaped(const char* s, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\\' || s[i] == '\n') {
+            append(s + start, i - start);
+            append(s[i] == '\\' ? "\\\\" : "\\n", 2);
+            start = i + 1;
+        }
+    }
+    append(s + start, len - start);
+}
+
+// Starts a record: its tag and the microseconds since the last one.
+static void begin_record(char tag) {
+    unsigned long long now = now_ns();
+    unsigned long long us = (now - last_ns) / 1000;
+    last_ns += us * 1000; // Keep the remainder, so that rounding doesn't drift
+    char head[32];
+    int n = snprintf(head, sizeof(head), "%c %llu ", tag, us);
+    append(head, (size_t)n);
+}
+
+static void add_record(char tag, const char* text, size_t len) {
+    begin_record(tag);
+    append_escaped(text, len);
+    append("\n", 1);
+}
+
+static void write_buffer(void) {
+    size_t done = 0;
+    while (done < buffer_len) {
+        ssize_t n = write(record_fd, buffer + done, buffer_len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("record: write");
+            break;
+        }
+        done += (size_t)n;
+    }
+    buffer_len = 0;
+}
+
+static void flush_at_exit(void) {
+    if (record_enabled && getpid() == record_owner) {
+        write_buffer();
+        close(record_fd);
+    }
+}
+
+static size_t name_len(const char* entry) {
+    return strcspn(entry, "=");
+}
+
+// Orders by name alone, so that a changed value pairs with the old one.
+static int compare_names(const char* a, const char* b) {
+    size_t a_len = name_len(a), b_len = name_len(b);
+    int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    return c ? c : (a_len > b_len) - (a_len < b_len);
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return compare_names(*(char* const*)a, *(char* const*)b);
+}
+
+// Takes a sorted snapshot of the exported variables and records how it
+// differs from the last one; the first time, that is all of them.
+static void snapshot_env(void) {
+    vars_sync_environ();
+    int count = 0;
+    while (environ && environ[count]) count++;
+    char** now = malloc((count + 1) * sizeof(char*));
+    if (!now) return;
+    memcpy(now, environ, count * sizeof(char*));
+    qsort(now, count, sizeof(char*), compare_entries);
+
+    int i = 0, j = 0; // Into last_env and now
+    while (i < last_env_count || j < count) {
+        int c = i == last_env_count ? 1 : j == count ? -1 : compare_names(last_env[i], now[j]);
+        if (c < 0) {
+            add_record('u', last_env[i], name_len(last_env[i]));
+            i++;
+        } else if (c > 0) {
+            add_record('e', now[j], strlen(now[j]));
+            j++;
+        } else {
+            if (strcmp(last_env[i], now[j]) != 0) add_record('e', now[j], strlen(now[j]));
+            i++;
+            j++;
+        }
+    }
+
+    for (i = 0; i < last_env_count; i++) free(last_env[i]);
+    for (j = 0; j < count; j++) now[j] = strdup(now[j]);
+    free(last_env);
+    last_env = now;
+    last_env_count = count;
+    for (j = 0; j < count; j++) {
+        if (!now[j]) { // Out of memory: forget the rest, and see it as new next time
+            for (int k = j + 1; k < count; k++) free(now[k]);
+            last_env_count = j;
+            break;
+        }
+    }
+}
+
+static void note_cwd(void) {
+    if (strcmp(last_cwd, info.cwd) != 0) {
+        strcpy(last_cwd, info.cwd);
+        add_record('d', last_cwd, strlen(last_cwd));
+    }
+}
+
+void record_input_line(const char* line, int starts_command) {
+    if (starts_command) {
+        note_cwd();
+        snapshot_env();
+    }
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\n') len--;
+    add_record(starts_command ? 'c' : 'm', line, len);
+}
+
+void record_command_done(int status) {
+    begin_record('r');
+    char text[16];
+    int n = snprintf(text, sizeof(text), "%d\n", status);
+    append(text, (size_t)n);
+    write_buffer();
+}
+
+void record_init_from_env(void) {
+    const char* path = getenv("ROY_SHELL_RECORD");
+    if (!path || path[0] == '\0' || record_enabled) return;
+    record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (record_fd < 0) {
+        perror("record: open");
+        return;
+    }
+    record_owner = getpid();
+    record_enabled = 1;
+    last_ns = now_ns();
+    append("roy-shell-record 1\n", 19);
+    note_cwd();
+    snapshot_env();
+    write_buffer();
+    atexit(flush_at_exit);
+}
@@ -1,17 +1,44 @@
+#define _GNU_SOURCE // For statx() and AT_STATX_DONT_SYNC
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pwd.h>
+#include <grp.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 // Custom headers
 #include "main.h" // For access to the global 'info' struct
 #include "hop.h"  // For access to prev_path
 #include "reveal.h"
+#include "walk.h"
+#include "dircache.h"
+#include "trace.h"
+#include "shellstat.h"
+#include "ndjson.h"
+#include "output.h"
 
 extern char prev_path[1000];
 
+// Below this many entries the statx calls are cheaper than starting threads.
+#define PARALLEL_STAT_THRESHOLD 512
+#define STAT_CHUNK_SIZE 64
+#define MAX_STAT_WORKERS 16
+
+// Shared state for the statx worker threads. Workers claim chunks of entries
+// under the lock and run the syscalls without holding it.
+typedef struct {
+    int dirfd;
+    RevealEntry* entries;
+    int count;
+    int next; // Index of the next unclaimed entry
+    pthread_mutex_t lock;
+} StatJob;
+
 static int string_comparator(const void* a, const void* b) {
     return strcmp(*(const char**)a, *(const char**)b);
 }
@@ -63,53 +90,488 @@ char** list_and_sort_files(const char* path) {
 }
 
 
-void print_files(char** files, int show_hidden, int line_by_line) {
+// Prints a listing; the names are borrowed, not freed. They are handed to
+// the output buffer by reference, a batch at a time, with their separators.
+void print_files(char* const* files, int show_hidden, int line_by_line) {
     if (files == NULL) return;
 
+    const char* separator = line_by_line ? "\n" : "  ";
+    size_t separator_len = strlen(separator);
+    struct iovec iov[OUT_IOV_MAX];
+    int count = 0;
     for (int i = 0; files[i] != NULL; i++) {
         if (!show_hidden && files[i][0] == '.') {
             continue; // Skip hidden files if -a is not set
         }
 
-        if (line_by_line) {
-            printf("%s\n", files[i]);
-        } else {
-            printf("%s  ", files[i]);
+        iov[count].iov_base = files[i];
+        iov[count].iov_len = strlen(files[i]);
+        iov[count + 1].iov_base = (char*)separator;
+        iov[count + 1].iov_len = separator_len;
+        count += 2;
+        if (count == OUT_IOV_MAX) {
+            out_writev(iov, count);
+            count = 0;
         }
-        free(files[i]); // Free each string
+        shellstat.reveal_entries++;
     }
+    out_writev(iov, count);
 
     if (!line_by_line) {
-        printf("\n");
+        out_putc('\n');
+    }
+}
+
+// Fills in the metadata for one entry, relative to the open directory fd.
+void stat_entry(int dirfd, RevealEntry* entry) {
+    // AT_STATX_DONT_SYNC: use cached attributes, never force a round-trip on
+    // network filesystems just to print a listing.
+    entry->stat_ok = statx(dirfd, entry->name,
+                           AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                           STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID |
+                           STATX_SIZE | STATX_MTIME | STATX_INO,
+                           &entry->stx) == 0;
+}
+
+static void* stat_worker(void* arg) {
+    StatJob* job = arg;
+    TraceSpan span = trace_begin("reveal stat worker");
+    while (1) {
+        pthread_mutex_lock(&job->lock);
+        int start = job->next;
+        job->next += STAT_CHUNK_SIZE;
+        pthread_mutex_unlock(&job->lock);
+
+        if (start >= job->count) {
+            break;
+        }
+        int end = start + STAT_CHUNK_SIZE;
+        if (end > job->count) end = job->count;
+        for (int i = start; i < end; i++) {
+            stat_entry(job->dirfd, &job->entries[i]);
+        }
+    }
+    trace_end(span, NULL);
+    return NULL;
+}
+
+/**
+ * @brief Runs statx() for every entry. Large directories are spread over a
+ * small pool of threads so slow storage doesn't serialize on each syscall.
+ */
+static void stat_entries(int dirfd, RevealEntry* entries, int count) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = (cpus > 0) ? (int)cpus : 1;
+    if (workers > MAX_STAT_WORKERS) workers = MAX_STAT_WORKERS;
+    // Metadata calls mostly block on I/O, so use a few threads even on one CPU.
+    if (workers < 4) workers = 4;
+
+    if (count < PARALLEL_STAT_THRESHOLD) {
+        for (int i = 0; i < count; i++) {
+            stat_entry(dirfd, &entries[i]);
+        }
+        return;
+    }
+
+    StatJob job = { .dirfd = dirfd, .entries = entries, .count = count, .next = 0 };
+    pthread_mutex_init(&job.lock, NULL);
+
+    pthread_t threads[MAX_STAT_WORKERS];
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&threads[started], NULL, stat_worker, &job) == 0) {
+            started++;
+        }
+    }
+    // The calling thread helps too; this also covers the case where no thread started.
+    stat_worker(&job);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+}
+
+static int name_comparator(const void* a, const void* b) {
+    return strcmp(((const RevealEntry*)a)->name, ((const RevealEntry*)b)->name);
+}
+
+static int size_comparator(const void* a, const void* b) {
+    const RevealEntry* ea = a;
+    const RevealEntry* eb = b;
+    // Largest first, ties broken by name.
+    if (ea->stx.stx_size != eb->stx.stx_size) {
+        return (ea->stx.stx_size < eb->stx.stx_size) ? 1 : -1;
+    }
+    return strcmp(ea->name, eb->name);
+}
+
+static int mtime_comparator(const void* a, const void* b) {
+    const RevealEntry* ea = a;
+    const RevealEntry* eb = b;
+    // Newest first, ties broken by name.
+    if (ea->stx.stx_mtime.tv_sec != eb->stx.stx_mtime.tv_sec) {
+        return (ea->stx.stx_mtime.tv_sec < eb->stx.stx_mtime.tv_sec) ? 1 : -1;
     }
+    if (ea->stx.stx_mtime.tv_nsec != eb->stx.stx_mtime.tv_nsec) {
+        return (ea->stx.stx_mtime.tv_nsec < eb->stx.stx_mtime.tv_nsec) ? 1 : -1;
+    }
+    return strcmp(ea->name, eb->name);
+}
+
+// Builds an "ls -l" style mode string such as "drwxr-xr-x".
+static void format_mode(unsigned int mode, char out[11]) {
+    char type = '-';
+    if (S_ISDIR(mode)) type = 'd';
+    else if (S_ISLNK(mode)) type = 'l';
+    else if (S_ISCHR(mode)) type = 'c';
+    else if (S_ISBLK(mode)) type = 'b';
+    else if (S_ISFIFO(mode)) type = 'p';
+    else if (S_ISSOCK(mode)) type = 's';
+
+    out[0] = type;
+    out[1] = (mode & S_IRUSR) ? 'r' : '-';
+    out[2] = (mode & S_IWUSR) ? 'w' : '-';
+    out[3] = (mode & S_IXUSR) ? 'x' : '-';
+    out[4] = (mode & S_IRGRP) ? 'r' : '-';
+    out[5] = (mode & S_IWGRP) ? 'w' : '-';
+    out[6] = (mode & S_IXGRP) ? 'x' : '-';
+    out[7] = (mode & S_IROTH) ? 'r' : '-';
+    out[8] = (mode & S_IWOTH) ? 'w' : '-';
+    out[9] = (mode & S_IXOTH) ? 'x' : '-';
+    out[10] = '\0';
+}
+
+// Looking up the owner is a file read per call, but a directory almost always
+// has only a handful of distinct owners, so remember the last one.
+static const char* owner_name(uid_t uid) {
+    static uid_t cached_uid = (uid_t)-1;
+    static char cached_name[64];
+    if (uid != cached_uid) {
+        struct passwd* pw = getpwuid(uid);
+        if (pw) {
+            snprintf(cached_name, sizeof(cached_name), "%s", pw->pw_name);
+        } else {
+            snprintf(cached_name, sizeof(cached_name), "%u", (unsigned int)uid);
+        }
+        cached_uid = uid;
+    }
+    return cached_name;
+}
+
+static const char* group_name(gid_t gid) {
+    static gid_t cached_gid = (gid_t)-1;
+    static char cached_name[64];
+    if (gid != cached_gid) {
+        struct group* gr = getgrgid(gid);
+        if (gr) {
+            snprintf(cached_name, sizeof(cached_name), "%s", gr->gr_name);
+        } else {
+            snprintf(cached_name, sizeof(cached_name), "%u", (unsigned int)gid);
+        }
+        cached_gid = gid;
+    }
+    return cached_name;
+}
+
+/**
+ * @brief Sorts entries in the order requested on the command line.
+ */
+void sort_entries(RevealEntry* entries, int count, RevealSort sort) {
+    if (sort == SORT_SIZE) {
+        qsort(entries, count, sizeof(RevealEntry), size_comparator);
+    } else if (sort == SORT_MTIME) {
+        qsort(entries, count, sizeof(RevealEntry), mtime_comparator);
+    } else {
+        qsort(entries, count, sizeof(RevealEntry), name_comparator);
+    }
+}
 
-    free(files); // Free the array itself
+void print_long_entry(const RevealEntry* entry) {
+    if (!entry->stat_ok) {
+        out_printf("%10s ?????????? %-8s %-8s %10s %12s %s\n", "?", "?", "?", "?", "?", entry->name);
+        return;
+    }
+
+    char mode[11];
+    format_mode(entry->stx.stx_mode, mode);
+
+    char mtime[32];
+    time_t secs = (time_t)entry->stx.stx_mtime.tv_sec;
+    struct tm tm_buf;
+    if (localtime_r(&secs, &tm_buf) == NULL ||
+        strftime(mtime, sizeof(mtime), "%b %e %H:%M", &tm_buf) == 0) {
+        strcpy(mtime, "?");
+    }
+
+    out_printf("%10llu %s %-8s ", (unsigned long long)entry->stx.stx_ino, mode,
+               owner_name(entry->stx.stx_uid));
+    out_printf("%-8s %10llu %12s %s\n", group_name(entry->stx.stx_gid),
+               (unsigned long long)entry->stx.stx_size, mtime, entry->name);
+}
+
+static const char* type_name(const RevealEntry* entry) {
+    if (entry->stat_ok) {
+        unsigned int mode = entry->stx.stx_mode;
+        if (S_ISREG(mode)) return "file";
+        if (S_ISDIR(mode)) return "dir";
+        if (S_ISLNK(mode)) return "symlink";
+        if (S_ISFIFO(mode)) return "fifo";
+        if (S_ISSOCK(mode)) return "socket";
+        if (S_ISCHR(mode)) return "char";
+        if (S_ISBLK(mode)) return "block";
+        return "unknown";
+    }
+    switch (entry->d_type) {
+    case DT_REG:  return "file";
+    case DT_DIR:  return "dir";
+    case DT_LNK:  return "symlink";
+    case DT_FIFO: return "fifo";
+    case DT_SOCK: return "socket";
+    case DT_CHR:  return "char";
+    case DT_BLK:  return "block";
+    default:      return "unknown";
+    }
+}
+
+/**
+ * @brief Writes one entry as an NDJSON record for `reveal --json`: its name
+ * and type, the directory it is in (`dir`, for recursive listings) and,
+ * with `with_stat`, the fields of the long listing.
+ */
+static void json_entry(const char* dir, const RevealEntry* entry, int with_stat) {
+    ndjson_begin();
+    if (dir) {
+        ndjson_string("dir", dir);
+    }
+    ndjson_string("name", entry->name);
+    ndjson_string("type", type_name(entry));
+    if (with_stat && entry->stat_ok) {
+        const struct statx* stx = &entry->stx;
+        ndjson_uint("ino", stx->stx_ino);
+        ndjson_uint("mode", stx->stx_mode & 07777);
+        ndjson_uint("nlink", stx->stx_nlink);
+        ndjson_string("owner", owner_name(stx->stx_uid));
+        ndjson_string("group", group_name(stx->stx_gid));
+        ndjson_uint("size", stx->stx_size);
+        ndjson_int("mtime", stx->stx_mtime.tv_sec);
+        ndjson_uint("mtime_nsec", stx->stx_mtime.tv_nsec);
+    }
+    ndjson_end();
+}
+
+static void finish_json(void) {
+    if (ndjson_finish() != 0) {
+        perror("reveal: write");
+    }
+}
+
+// `reveal --json` without metadata: the listing's names and d_types suffice.
+static void json_listing(const DirListing* listing, int show_hidden) {
+    for (int i = 0; i < listing->count; i++) {
+        if (!show_hidden && listing->names[i][0] == '.') {
+            continue;
+        }
+        RevealEntry entry = {.name = listing->names[i], .d_type = listing->types[i]};
+        json_entry(NULL, &entry, 0);
+        shellstat.reveal_entries++;
+    }
+    finish_json();
+}
+
+/**
+ * @brief Handles the metadata-driven modes of reveal: the long listing (-L)
+ * and the size/mtime sort orders, as text or NDJSON. The entry names are
+ * borrowed from `listing`.
+ */
+static void reveal_with_stat(const char* path, const DirListing* listing, int show_hidden,
+                             int line_by_line, int long_format, RevealSort sort, int json) {
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        out_printf("No such directory!\n");
+        return;
+    }
+
+    RevealEntry* entries = calloc(listing->count > 0 ? listing->count : 1, sizeof(RevealEntry));
+    if (!entries) {
+        perror("reveal: calloc");
+        close(dirfd);
+        return;
+    }
+
+    // Hidden entries are dropped before stat'ing so we don't pay for them.
+    int count = 0;
+    for (int i = 0; i < listing->count; i++) {
+        if (!show_hidden && listing->names[i][0] == '.') {
+            continue;
+        }
+        entries[count].name = listing->names[i];
+        entries[count].d_type = listing->types[i];
+        count++;
+    }
+
+    stat_entries(dirfd, entries, count);
+    close(dirfd);
+
+    // The names are already in lexicographic order from the listing.
+    if (sort != SORT_NAME) {
+        sort_entries(entries, count, sort);
+    }
+
+    if (json) {
+        for (int i = 0; i < count; i++) {
+            json_entry(NULL, &entries[i], long_format);
+        }
+        finish_json();
+    } else {
+        for (int i = 0; i < count; i++) {
+            if (long_format) {
+                print_long_entry(&entries[i]);
+            } else if (line_by_line) {
+                out_printf("%s\n", entries[i].name);
+            } else {
+                out_printf("%s  ", entries[i].name);
+            }
+        }
+        if (!long_format && !line_by_line) {
+            out_printf("\n");
+        }
+    }
+    shellstat.reveal_entries += count;
+    free(entries);
+}
+
+// Writes the entries of a recursive listing as NDJSON, in the order it prints them.
+static void json_walk_node(const WalkNode* node, int long_format) {
+    if (node->error) {
+        fprintf(stderr, "reveal: cannot open directory '%s': %s\n", node->path, strerror(node->error));
+    }
+    for (int i = 0; i < node->count; i++) {
+        json_entry(node->path, &node->entries[i], long_format);
+    }
+    shellstat.reveal_entries += node->count;
+    for (int i = 0; i < node->child_count; i++) {
+        json_walk_node(node->children[i], long_format);
+    }
+}
+
+// Prints one directory of a recursive listing, then its subdirectories in order.
+static void print_walk_node(const WalkNode* node, int line_by_line, int long_format) {
+    out_printf("%s:\n", node->path);
+    if (node->error) {
+        fprintf(stderr, "reveal: cannot open directory '%s': %s\n", node->path, strerror(node->error));
+    }
+
+    for (int i = 0; i < node->count; i++) {
+        if (long_format) {
+            print_long_entry(&node->entries[i]);
+        } else if (line_by_line) {
+            out_printf("%s\n", node->entries[i].name);
+        } else {
+            out_printf("%s  ", node->entries[i].name);
+        }
+    }
+    if (!long_format && !line_by_line && node->count > 0) {
+        out_printf("\n");
+    }
+    shellstat.reveal_entries += node->count;
+
+    for (int i = 0; i < node->child_count; i++) {
+        out_printf("\n");
+        print_walk_node(node->children[i], line_by_line, long_format);
+    }
+}
+
+/**
+ * @brief Handles `reveal -R`: walks the tree in parallel, prints it in sorted
+ * order and reports the traversal rate on stderr.
+ */
+static void reveal_recursive(const char* path, int show_hidden, int line_by_line,
+                             int long_format, RevealSort sort, int json) {
+    WalkOptions options = {
+        .show_hidden = show_hidden,
+        .want_stat = long_format || sort != SORT_NAME,
+        .sort = sort,
+        .max_threads = 0,
+    };
+    // Lets benchmarks measure scaling; by default one worker per CPU.
+    const char* threads_env = getenv("REVEAL_THREADS");
+    if (threads_env) {
+        options.max_threads = atoi(threads_env);
+    }
+    WalkStats stats = {0};
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    WalkNode* root = walk_tree(path, &options, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (root == NULL) {
+        perror("reveal: walk");
+        return;
+    }
+    if (root->error) {
+        out_printf("No such directory!\n");
+        free_walk_tree(root);
+        return;
+    }
+
+    if (json) {
+        json_walk_node(root, long_format);
+        finish_json();
+    } else {
+        print_walk_node(root, line_by_line, long_format);
+    }
+    free_walk_tree(root);
+    out_flush(); // Keep the summary after the listing when both go to a terminal
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "reveal: %ld entries in %ld directories, %.3f s (%.0f entries/s, %d threads)\n",
+            stats.entries, stats.directories, seconds,
+            seconds > 0 ? stats.entries / seconds : 0.0, stats.threads);
 }
 
 /**
  * @brief Executes the 'reveal' command.
+ * Flags: -a (hidden), -l (one per line), -L (long listing),
+ * -S (sort by size), -t (sort by modification time), -R (recursive),
+ * --json (one JSON object per entry, with the -L fields if -L is given).
  * @param args Null-terminated array of strings from the parser.
  */
 void execute_reveal(char** args) {
     int show_hidden = 0;
     int line_by_line = 0;
+    int long_format = 0;
+    int recursive = 0;
+    int json = 0;
+    RevealSort sort = SORT_NAME;
     char* path_arg = NULL;
 
     // 1. Parse arguments for flags and the optional path.
     for (int i = 1; args[i] != NULL; i++) {
-        if (args[i][0] == '-') {
+        if (strcmp(args[i], "--json") == 0) {
+            json = 1;
+        } else if (args[i][0] == '-') {
             // This is a flag argument, e.g., "-al"
             for (int j = 1; args[i][j] != '\0'; j++) {
                 if (args[i][j] == 'a') {
                     show_hidden = 1;
                 } else if (args[i][j] == 'l') {
                     line_by_line = 1;
+                } else if (args[i][j] == 'L') {
+                    long_format = 1;
+                } else if (args[i][j] == 'S') {
+                    sort = SORT_SIZE;
+                } else if (args[i][j] == 't') {
+                    sort = SORT_MTIME;
+                } else if (args[i][j] == 'R') {
+                    recursive = 1;
                 }
             }
         } else {
             // This is a path argument.
             if (path_arg != NULL) {
-                printf("reveal: Invalid Syntax!\n");
+                out_printf("reveal: Invalid Syntax!\n");
                 return; // More than one path argument provided.
             }
             path_arg = args[i];
@@ -125,7 +587,7 @@ void execute_reveal(char** args) {
         strncpy(target_path, info.home, sizeof(target_path) -1);
     } else if (strcmp(path_arg, "-") == 0) {
         if (prev_path[0] == '\0') {
-            printf("No such directory!\n"); // Per requirement for 'reveal -'
+            out_printf("No such directory!\n"); // Per requirement for 'reveal -'
             return;
         }
         strncpy(target_path, prev_path, sizeof(target_path) - 1);
@@ -136,19 +598,32 @@ void execute_reveal(char** args) {
     }
     target_path[sizeof(target_path) - 1] = '\0';
 
+    if (recursive) {
+        reveal_recursive(target_path, show_hidden, line_by_line, long_format, sort, json);
+        return;
+    }
+
     // 3. List, sort, and print the files.
-    char** files = list_and_sort_files(target_path);
-    if (files == NULL) {
-        printf("No such directory!\n");
+    // The sorted listing comes from the directory cache; an unchanged
+    // directory is not re-read.
+    DirListing* listing = dircache_get(target_path);
+    if (listing == NULL) {
+        out_printf("No such directory!\n");
         return;
     }
 
-    // Default behavior if no flags are set.
-    if (!show_hidden && !line_by_line) {
+    if (long_format || sort != SORT_NAME) {
+        // Long listing and size/mtime ordering need per-entry metadata.
+        reveal_with_stat(target_path, listing, show_hidden, line_by_line, long_format, sort, json);
+    } else if (json) {
+        json_listing(listing, show_hidden);
+    } else if (!show_hidden && !line_by_line) {
+        // Default behavior if no flags are set.
         // Print in multi-column format, without hidden files.
-        print_files(files, 0, 0);
+        print_files(listing->names, 0, 0);
     } else {
         // Print according to the flags set.
-        print_files(files, show_hidden, line_by_line);
+        print_files(listing->names, show_hidden, line_by_line);
     }
+    dircache_release(listing);
 }
@@ -1,10 +1,12 @@
 #include <stdio.h>
+#include <stdio_ext.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <errno.h>
 
 // Custom Headers
 #include "command.h"
@@ -14,19 +16,72 @@
 #include "jobs.h"
 #include "ping.h"
 #include "main.h"
+#include "dircache.h"
+#include "shellstat.h"
+#include "wildcard.h"
+#include "vars.h"
+#include "heredoc.h"
+#include "trace.h"
+#include "builtins.h"
+#include "jobsched.h"
+#include "capture.h"
+#include "procsub.h"
+#include "deadline.h"
+#include "memo.h"
+#include "watch.h"
 
 #include "fg_bg.h"
+#include "output.h"
 
-// --- Add the forward declarations with the others ---
-void execute_fg(char** args);
-void execute_bg(char** args);
 
-// Forward declaration for the functions in your other files
-void execute_hop(char** args);
-void execute_reveal(char** args);
-void execute_ping(char** args); // <-- ADD THIS
+/**
+ * @brief Input redirection, the way this shell does it: the words of the
+ * `<` file are appended to the command's arguments.
+ * @return 0 on success (or with no input file), -1 after printing an error.
+ */
+static int append_input_file_args(SimpleCommand* cmd) {
+    if (!cmd->input_file) {
+        return 0;
+    }
+    int in_fd = open(cmd->input_file, O_RDONLY);
+    if (in_fd < 0) {
+        perror("shell: input file");
+        return -1;
+    }
+
+    char file_content[4096]; // A reasonably sized buffer to hold the file's content
+    ssize_t bytes_read = read(in_fd, file_content, sizeof(file_content) - 1);
+    close(in_fd);
+
+    if (bytes_read < 0) {
+        perror("shell: read input file");
+        return -1;
+    }
+    file_content[bytes_read] = '\0'; // Ensure the buffer is null-terminated
+
+    // Tokenize the file content by whitespace and append to args
+    char* token = strtok(file_content, " \t\n\r");
+    while (token != NULL) {
+        char* arg = strdup(token);
+        if (arg == NULL || !append_arg(cmd, arg)) {
+            free(arg);
+            perror("shell: strdup"); // Handle memory allocation failure
+            return -1;
+        }
+        token = strtok(NULL, " \t\n\r");
+    }
+    return 0;
+}
 
-// void execute_log(char** args);
+// Opens `cmd`'s `>` (truncating) or `>>` (appending) file for writing.
+static int open_output_file(const SimpleCommand* cmd) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (cmd->append_mode ? O_APPEND : O_TRUNC);
+    int fd = open(cmd->output_file, flags, 0644);
+    if (fd < 0) {
+        perror("shell: output file");
+    }
+    return fd;
+}
 
 
 /**
@@ -40,57 +95,33 @@ void execute_child_command(SimpleCommand* cmd) {
     signal(SIGINT, SIG_DFL);
     signal(SIGTSTP, SIG_DFL);
 
+    // Drop the shell's read-ahead of its own input. Builtins here would
+    // otherwise read it, and exit() would seek the shared fd back to it,
+    // making the shell read those lines again.
+    __fpurge(stdin);
+    TraceSpan setup_span = trace_begin("child setup");
+
     // 1. Handle Input Redirection
     // If a file is specified, read its content and append to the command's arguments.
-    if (cmd->input_file) {
-        int in_fd = open(cmd->input_file, O_RDONLY);
-        if (in_fd < 0) {
-            perror("shell: input file");
-            exit(EXIT_FAILURE);
-        }
-
-        char file_content[4096]; // A reasonably sized buffer to hold the file's content
-        ssize_t bytes_read = read(in_fd, file_content, sizeof(file_content) - 1);
-        close(in_fd);
+    if (append_input_file_args(cmd) != 0) {
+        exit(EXIT_FAILURE);
+    }
 
-        if (bytes_read < 0) {
-            perror("shell: read input file");
+    // A here-document or here-string replaces stdin, pipe or not.
+    if (cmd->here_doc) {
+        int doc_fd = here_doc_open(cmd->here_doc);
+        if (doc_fd < 0 || dup2(doc_fd, STDIN_FILENO) < 0) {
+            perror("shell: here-document");
             exit(EXIT_FAILURE);
         }
-        file_content[bytes_read] = '\0'; // Ensure the buffer is null-terminated
-
-        // Tokenize the file content by whitespace and append to args
-        char* token = strtok(file_content, " \t\n\r");
-        while (token != NULL) {
-            if (cmd->arg_count < MAX_ARGS - 1) {
-                cmd->args[cmd->arg_count] = strdup(token);
-                if (cmd->args[cmd->arg_count] == NULL) {
-                    perror("shell: strdup"); // Handle memory allocation failure
-                    exit(EXIT_FAILURE);
-                }
-                cmd->arg_count++;
-            } else {
-                fprintf(stderr, "shell: Too many arguments from input file '%s'.\n", cmd->input_file);
-                break; // Stop processing if the argument list is full
-            }
-            token = strtok(NULL, " \t\n\r");
-        }
-        cmd->args[cmd->arg_count] = NULL; // Re-terminate the argument list
+        close(doc_fd);
     }
 
     // 2. Handle Output Redirection
     // If a file is specified, it overrides any piped output.
     if (cmd->output_file) {
-        int out_fd;
-        int flags = O_WRONLY | O_CREAT;
-        if (cmd->append_mode) {
-            flags |= O_APPEND;
-        } else {
-            flags |= O_TRUNC;
-        }
-        out_fd = open(cmd->output_file, flags, 0644);
+        int out_fd = open_output_file(cmd);
         if (out_fd < 0) {
-            perror("shell: output file");
             exit(EXIT_FAILURE);
         }
         if (dup2(out_fd, STDOUT_FILENO) < 0) {
@@ -100,28 +131,43 @@ void execute_child_command(SimpleCommand* cmd) {
         close(out_fd);
     }
 
-    // 3. Execute the command
-    if (strcmp(cmd->args[0], "hop") == 0) {
-        execute_hop(cmd->args);
-        // IMPORTANT: This will change the directory of the CHILD process only.
-        // The parent shell's directory will NOT be affected.
+    // A command made only of assignments has nothing to run.
+    if (cmd->arg_count == 0) {
         exit(EXIT_SUCCESS);
-    } else if (strcmp(cmd->args[0], "reveal") == 0) {
-        execute_reveal(cmd->args);
-        exit(EXIT_SUCCESS);
-    } else if (strcmp(cmd->args[0], "exit") == 0) {
-        // This will exit the child process, not the main shell.
-        exit(0);
     }
-    else if (strcmp(cmd->args[0], "log") == 0) { // <-- THIS WAS ADDED
-        // 'log' is now treated as a special built-in.
-        execute_log(cmd->args);
-        exit(EXIT_SUCCESS);
+
+    // Prefix assignments (FOO=bar cmd) go into this command's environment only.
+    if (cmd->assignment_count > 0) {
+        apply_assignments(cmd->assignments, cmd->assignment_count, 1);
+        vars_sync_environ();
+    }
+
+    trace_end(setup_span, cmd->args[0]);
+
+    // 3. Execute the command. `command NAME ...` skips the builtins.
+    char** argv = cmd->args;
+    const Builtin* builtin = NULL;
+    if (strcmp(argv[0], "command") == 0) {
+        argv++;
+        if (argv[0] == NULL) {
+            exit(EXIT_SUCCESS);
+        }
+    } else {
+        builtin = find_builtin(argv[0]);
+    }
+    if (builtin) {
+        if (!(builtin->flags & BUILTIN_PIPELINE)) {
+            fprintf(stderr, "shell: %s: cannot be used in a pipeline\n", cmd->args[0]);
+            exit(EXIT_FAILURE);
+        }
+        // State changes (hop, export, ...) only affect this child.
+        exit(run_builtin(builtin, cmd->args));
     }
     else {
-        execvp(cmd->args[0], cmd->args);
+        trace_exec(argv[0]);
+        execvp(argv[0], argv);
         // If execvp returns, it means an error occurred.
-        fprintf(stderr, "shell: command not found: %s\n", cmd->args[0]);
+        fprintf(stderr, "shell: command not found: %s\n", argv[0]);
         exit(EXIT_FAILURE);
     }
     // If it's not a known built-in, assume it's an external command.
@@ -136,93 +182,132 @@ void execute_child_command(SimpleCommand* cmd) {
 }
 
 
-void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
-    if (pipeline == NULL || pipeline->num_commands == 0) {
-        return; // Nothing to execute
+// Puts back the shell's stdout, saved while a builtin wrote to a file.
+static void restore_stdout(int saved_stdout) {
+    if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
     }
+}
 
-    // --- SPECIAL CASE: Handle commands that MUST run in the parent process ---
-    // This applies ONLY if it's a single command with no pipes.
-    if (pipeline->num_commands == 1) {
-        SimpleCommand* cmd = &pipeline->commands[0];
-        if (strcmp(cmd->args[0], "hop") == 0) {
-            // 'hop' MUST change the parent shell's directory.
-            // It can handle input redirection by reading args from a file first.
-            if (cmd->input_file) {
-                int in_fd = open(cmd->input_file, O_RDONLY);
-                if (in_fd < 0) {
-                    perror("shell: input file");
-                    return; // Return, don't exit the shell
-                }
-
-                char file_content[4096];
-                ssize_t bytes_read = read(in_fd, file_content, sizeof(file_content) - 1);
-                close(in_fd);
+/**
+ * @brief Runs a lone builtin in the shell process itself, which avoids a
+ * fork and is the only way for hop, export, fg and the like to work.
+ * Redirections are applied here as in a child: `<` adds the file's words
+ * to the arguments, and `>`/`>>` point stdout at the file for the call,
+ * after which the shell's own stdout is put back. A plugin builtin reads
+ * only the fd, never stdio, so a here-document becomes its stdin the same
+ * way.
+ * Other builtins that don't need the shell's state are left to the forked
+ * path when they have to run in the background, have a here-document for
+ * stdin (the shell reads its own input from there, through stdio), or
+ * would read or wait on a terminal that Ctrl-C and Ctrl-Z should reach.
+ * @return 1 if `cmd` was run here, 0 otherwise.
+ */
+static int execute_parent_builtin(SimpleCommand* cmd, JobMode mode) {
+    const Builtin* builtin = find_builtin(cmd->args[0]);
+    if (!builtin) {
+        return 0;
+    }
+    if (!(builtin->flags & BUILTIN_PARENT) &&
+        (mode == BACKGROUND || (cmd->here_doc && !builtin->plugin) ||
+         ((builtin->flags & (BUILTIN_STDIN | BUILTIN_WAITS)) && isatty(STDIN_FILENO)))) {
+        return 0;
+    }
+    if (append_input_file_args(cmd) != 0) {
+        set_last_status(1);
+        return 1; // Error already reported; don't exit the shell
+    }
 
-                if (bytes_read < 0) {
-                    perror("shell: read input file");
-                    return;
-                }
-                file_content[bytes_read] = '\0';
-
-                char* token = strtok(file_content, " \t\n\r");
-                while (token != NULL) {
-                    if (cmd->arg_count < MAX_ARGS - 1) {
-                        cmd->args[cmd->arg_count] = strdup(token);
-                        cmd->arg_count++;
-                    } else {
-                        fprintf(stderr, "shell: Too many arguments from input file '%s'.\n", cmd->input_file);
-                        break;
-                    }
-                    token = strtok(NULL, " \t\n\r");
-                }
-                cmd->args[cmd->arg_count] = NULL;
-            }
-            // for (int i = 0; cmd->args[i] != NULL; i++) {
-            //     printf("arg[%d]: %s\n", i, cmd->args[i]); // Debugging line
-            // }
-            execute_hop(cmd->args);
-            return; // Command is handled, so we skip the forking logic below.
-        } 
-        else if (strcmp(cmd->args[0], "exit") == 0) {
-            exit(0); // Exit the main shell.
-        }
-        else if (strcmp(cmd->args[0], "log") == 0) { // <-- THIS WAS ADDED
-            // 'log' is now treated as a special built-in.
-            execute_log(cmd->args);
-            return; // Command is handled, so we skip the forking logic below.
-        }
-        else if (strcmp(cmd->args[0], "reveal") == 0) {
-            // 'reveal' can run in the child process, but we handle it here for consistency.
-            execute_reveal(cmd->args);
-            return; // Command is handled, so we skip the forking logic below.
-        }
-        else if (strcmp(cmd->args[0], "activities") == 0) {
-            // 'activities' is a built-in that lists background jobs.
-            execute_activities();
-            return; // Command is handled, so we skip the forking logic below.
+    int saved_stdout = -1;
+    if (cmd->output_file) {
+        int out_fd = open_output_file(cmd);
+        if (out_fd < 0) {
+            set_last_status(1);
+            return 1;
         }
-        else if (strcmp(cmd->args[0], "ping") == 0) { // <-- ADD THIS BLOCK
-            // 'ping' is a simple built-in that sends a signal.
-            execute_ping(cmd->args);
-            return; // Command is handled.
+        out_flush(); // What the shell printed so far isn't the builtin's
+        saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+        if (saved_stdout < 0 || dup2(out_fd, STDOUT_FILENO) < 0) {
+            perror("shell: dup2 stdout");
+            if (saved_stdout >= 0) close(saved_stdout);
+            close(out_fd);
+            set_last_status(1);
+            return 1;
         }
-        else if (strcmp(cmd->args[0], "fg") == 0) { // <-- ADD THIS
-            execute_fg(cmd->args);
-            return;
-        } else if (strcmp(cmd->args[0], "bg") == 0) { // <-- ADD THIS
-            execute_bg(cmd->args);
-            return;
+        close(out_fd);
+    }
+
+    int saved_stdin = -1;
+    if (cmd->here_doc) { // Only a plugin's gets this far
+        int doc_fd = here_doc_open(cmd->here_doc);
+        saved_stdin = doc_fd < 0 ? -1 : fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        if (saved_stdin < 0 || dup2(doc_fd, STDIN_FILENO) < 0) {
+            perror("shell: here-document");
+            if (saved_stdin >= 0) close(saved_stdin);
+            if (doc_fd >= 0) close(doc_fd);
+            restore_stdout(saved_stdout);
+            set_last_status(1);
+            return 1;
         }
+        close(doc_fd);
     }
 
-    // --- GENERAL PIPELINE EXECUTION ---
-    // All commands, including 'hop' when in a pipeline, are handled here.
+    set_last_status(run_builtin(builtin, cmd->args));
+
+    if (saved_stdin >= 0) {
+        dup2(saved_stdin, STDIN_FILENO);
+        close(saved_stdin);
+    }
+    // run_builtin() flushed the builtin's output into the file.
+    restore_stdout(saved_stdout);
+    return 1;
+}
+
+/**
+ * @brief Counts a command forked to run for shellstat, as the builtin or
+ * the exec it will be: the child's own counters die with it.
+ */
+static void count_forked_command(const SimpleCommand* cmd) {
+    shellstat.forks++;
+    if (cmd->arg_count == 0) {
+        return;
+    }
+    const Builtin* builtin = NULL;
+    if (strcmp(cmd->args[0], "command") != 0) {
+        builtin = find_builtin(cmd->args[0]);
+    } else if (cmd->args[1] == NULL) {
+        return;
+    }
+    if (builtin) {
+        count_builtin_call(builtin);
+    } else {
+        shellstat.execs++;
+    }
+}
+
+// Set inside a backgrounded compound command, whose pipelines share its job.
+static pid_t job_group = 0;
+
+void set_job_group(pid_t pgid) {
+    job_group = pgid;
+}
+
+/**
+ * @brief Forks one child per command, connected by pipes, all in one new
+ * process group (or the enclosing job's; see set_job_group()). Fills `pids`
+ * (one per command). If `output_fd` is open, it becomes the last command's
+ * stdout; if `error_fd` is, every command's stderr. A `timeout` prefix
+ * starts counting down once all of them are running.
+ * @return The process group, or -1 if a pipe or fork failed.
+ */
+static pid_t fork_pipeline(CommandPipeline* pipeline, pid_t* pids, int output_fd, int error_fd) {
     int num_pipes = pipeline->num_commands - 1;
-    pid_t pids[pipeline->num_commands];
     int input_fd = STDIN_FILENO; // The first command reads from stdin
 
-    pid_t pgid = 0; // Process Group ID for the entire pipeline
+    // Process Group ID for the entire pipeline. One with a timeout gets its
+    // own, so that expiring doesn't take the enclosing job down with it.
+    pid_t pgid = pipeline->timeout > 0 ? 0 : job_group;
 
     for (int i = 0; i < pipeline->num_commands; i++) {
         SimpleCommand* cmd = &pipeline->commands[i];
@@ -232,14 +317,20 @@ void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
         if (i < num_pipes) {
             if (pipe(pipe_fds) < 0) {
                 perror("shell: pipe");
-                return;
+                return -1;
             }
         }
 
+        out_flush(); // Don't let the child inherit (and repeat) pending output
+        TraceSpan fork_span = trace_begin("fork");
         pids[i] = fork();
         if (pids[i] < 0) {
             perror("shell: fork");
-            return;
+            return -1;
+        }
+        if (pids[i] > 0) {
+            trace_end(fork_span, cmd->arg_count > 0 ? cmd->args[0] : NULL);
+            count_forked_command(cmd);
         }
 
         if (pids[i] == 0) {
@@ -257,6 +348,13 @@ void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
                 close(input_fd);
             }
 
+            // Send the job's output to its capture (or memo) pipe
+            if ((error_fd >= 0 && dup2(error_fd, STDERR_FILENO) < 0) ||
+                (output_fd >= 0 && i == num_pipes && dup2(output_fd, STDOUT_FILENO) < 0)) {
+                perror("shell: dup2 output pipe");
+                exit(EXIT_FAILURE);
+            }
+
             // Connect output to the next command
             if (i < num_pipes) {
                 close(pipe_fds[0]); // Child doesn't read from the new pipe
@@ -288,16 +386,171 @@ void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
             input_fd = pipe_fds[0];
         }
     }
+    if (pipeline->timeout > 0) {
+        deadline_add(pgid, pipeline->timeout, pipeline->timeout_signal, pipeline->timeout_grace);
+    }
+    return pgid;
+}
+
+/**
+ * @brief Forks a background pipeline, with its output captured if
+ * `jobs capture` is on. The read end of the capture pipe, or -1, is left
+ * in *capture_fd for the caller to hand to capture_attach().
+ */
+static pid_t fork_background(CommandPipeline* pipeline, pid_t* pids, int* capture_fd) {
+    *capture_fd = -1;
+    int output_fd = capture_open(capture_fd);
+    pid_t pgid = fork_pipeline(pipeline, pids, output_fd, output_fd);
+    if (output_fd >= 0) {
+        close(output_fd); // Only the job writes to it now
+    }
+    if (pgid < 0 && *capture_fd >= 0) {
+        close(*capture_fd);
+        *capture_fd = -1;
+    }
+    return pgid;
+}
+
+/**
+ * @brief Starts background job `job_id`, which the scheduler had queued.
+ * Its words were already expanded when it was submitted.
+ */
+pid_t start_background_pipeline(CommandPipeline* pipeline, int job_id) {
+    pid_t pids[MAX_PIPED_CMDS];
+    int capture_fd;
+    vars_sync_environ();
+    pid_t pgid = fork_background(pipeline, pids, &capture_fd);
+    if (capture_fd >= 0) {
+        capture_attach(job_id, capture_fd);
+    }
+    return pgid;
+}
+
+
+void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
+    if (pipeline == NULL || pipeline->num_commands == 0) {
+        return; // Nothing to execute
+    }
+    shellstat.pipelines++;
+    // `watch PATHS -- pipeline` takes the pipeline over, words unexpanded.
+    if (watch_run(pipeline, original_command)) {
+        return;
+    }
+
+    // Expand variables and $(...), then wildcards, before dispatch so builtins
+    // like hop and reveal see the results too.
+    TraceSpan expand_span = trace_begin("expand");
+    int expand_failed = 0;
+    for (int i = 0; i < pipeline->num_commands && !expand_failed; i++) {
+        expand_failed = expand_command_words(&pipeline->commands[i]) != 0 ||
+                        expand_command_globs(&pipeline->commands[i]) != 0;
+    }
+    if (!expand_failed) {
+        expand_failed = prepare_here_strings(pipeline) != 0;
+    }
+    trace_end(expand_span, NULL);
+    if (expand_failed) {
+        procsub_finish(1); // Closing their pipes lets any started substitutions end
+        set_last_status(1);
+        return;
+    }
+    // A `timeout DUR` prefix becomes the pipeline's deadline.
+    if (deadline_take_prefix(pipeline) != 0) {
+        procsub_finish(1);
+        set_last_status(125);
+        return;
+    }
+
+    // Rebuilds the environment only if an exported variable changed.
+    vars_sync_environ();
+
+    // A `memo` prefix replays the pipeline's output if its key is known.
+    Memo* memo;
+    if (memo_take_prefix(pipeline, &memo) != 0) {
+        procsub_finish(1);
+        set_last_status(2);
+        return;
+    }
+    if (memo && memo_replay(memo, pipeline)) {
+        memo_finish(memo, 0, 0); // Nothing new to keep
+        procsub_finish(1);
+        return;
+    }
+
+    // --- SPECIAL CASE: Handle commands that MUST run in the parent process ---
+    // This applies ONLY if it's a single command with no pipes, and with no
+    // timeout (only a forked builtin can be stopped when its time is up) or
+    // memo (whose output is recorded through a pipe).
+    if (pipeline->num_commands == 1 && pipeline->timeout == 0 && memo == NULL) {
+        SimpleCommand* cmd = &pipeline->commands[0];
+        if (cmd->arg_count == 0) {
+            // Only NAME=value words: set shell variables.
+            apply_assignments(cmd->assignments, cmd->assignment_count, 0);
+            set_last_status(0);
+            return;
+        }
+        // Builtins below run in the shell itself; their status is set by run_builtin().
+        set_last_status(0);
+        TraceSpan builtin_span = trace_begin("builtin");
+        if (execute_parent_builtin(cmd, pipeline->mode)) {
+            trace_end(builtin_span, cmd->args[0]);
+            procsub_finish(1);
+            return; // Command is handled, so we skip the forking logic below.
+        }
+    }
+
+    // --- GENERAL PIPELINE EXECUTION ---
+    // All commands, including 'hop' when in a pipeline, are handled here.
+    // Background jobs beyond the scheduler's limit wait in its queue, except
+    // those whose <(...) and >(...) commands are already running.
+    if (pipeline->mode == BACKGROUND && !jobsched_can_start() && !procsub_pending()) {
+        jobsched_enqueue(pipeline, original_command);
+        return;
+    }
+    pid_t pids[pipeline->num_commands];
+    int capture_fd = -1;
+    int memo_fd = memo ? memo_record(memo, pipeline) : -1;
+    if (memo && memo_fd < 0) {
+        memo_finish(memo, 0, 1); // Runs, but isn't recorded
+        memo = NULL;
+    }
+    pid_t pgid = pipeline->mode == BACKGROUND ? fork_background(pipeline, pids, &capture_fd)
+                                              : fork_pipeline(pipeline, pids, memo_fd, -1);
+    // The substituted commands belong to the job from here on.
+    procsub_close(pgid);
+    if (pgid < 0) {
+        memo_finish(memo, 0, 1);
+        procsub_finish(1);
+        return;
+    }
+    if (memo) {
+        memo_start(memo, pgid);
+    }
 
     if (pipeline->mode == FOREGROUND) {
+        int stopped = 0;
         // 1. Set the global foreground pgid so signal handlers know who to target.
         foreground_pgid = pgid;
         
         // 2. Wait for the job to either terminate or stop.
         for (int i = 0; i < pipeline->num_commands; i++) {
-            int status;
+            int status = 0;
             // WUNTRACED makes waitpid return if a process is stopped (Ctrl-Z).
-            waitpid(pids[i], &status, WUNTRACED);
+            // The Ctrl-C and Ctrl-Z handlers interrupt it on their way to
+            // the job; wait on for what they did to it.
+            TraceSpan wait_span = trace_begin("wait");
+            while (deadline_waitpid(pids[i], &status, WUNTRACED) < 0 && errno == EINTR) {
+            }
+            trace_end(wait_span, pipeline->commands[i].arg_count > 0 ? pipeline->commands[i].args[0] : NULL);
+
+            // The pipeline's status ($?) is that of its last command.
+            if (i == pipeline->num_commands - 1) {
+                if (WIFEXITED(status)) {
+                    set_last_status(WEXITSTATUS(status));
+                } else if (WIFSIGNALED(status)) {
+                    set_last_status(128 + WTERMSIG(status));
+                }
+            }
 
             // Check if the process was stopped by a signal (Ctrl-Z).
             if (WIFSTOPPED(status)) {
@@ -312,11 +565,20 @@ void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
                     job->status = JOB_STOPPED;
                     printf("\n[%d] Stopped %s\n", job->job_id, job->command);
                 }
+                stopped = 1;
                 break; // Stop waiting for other processes in this job.
             }
         }
         
-        // 3. Reset the foreground pgid. No job is in the foreground anymore.
+        // 3. Let the job's <(...) and >(...) commands finish too, unless it
+        //    was stopped; they are then left to the background job reaper.
+        procsub_finish(!stopped);
+        if (!stopped && deadline_cancel(pgid)) {
+            set_last_status(124); // Timed out, as `timeout` reports it
+        }
+        memo_finish(memo, stopped, get_last_status()); // Keeps the output of a success
+
+        // 4. Reset the foreground pgid. No job is in the foreground anymore.
         foreground_pgid = 0;
         
     } 
@@ -324,6 +586,13 @@ void execute_pipeline(CommandPipeline* pipeline, const char* original_command) {
         // This is the new behavior for BACKGROUND jobs:
         // DO NOT WAIT. Instead, add the job to our tracking table.
         add_job(pgid, original_command);
+        procsub_finish(0); // Reaped with the rest of the background jobs
+        Job* job = get_job_by_pgid(pgid);
+        if (job && capture_fd >= 0) {
+            capture_attach(job->job_id, capture_fd);
+        } else if (capture_fd >= 0) {
+            close(capture_fd); // No job to file it under
+        }
     }
 
     // // Wait for all child processes to complete
@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Custom headers
+#include "script.h"
+#include "command.h"
+#include "input_parser.h"
+#include "route.h"
+#include "vars.h"
+#include "wildcard.h"
+#include "jobs.h"
+#include "main.h" // For interrupted
+#include "shellstat.h"
+#include "output.h"
+
+/*
+ * Lists, && and ||, and compound commands.
+ *
+ * A command line is parsed once into a tree whose leaves are pipelines,
+ * parsed by input_parser.c as before:
+ *
+ *   list     -> (and_or ((; | & | newline) and_or)*)?
+ *   and_or   -> command ((&& | ||) command)*
+ *   command  -> if list then list (elif list then list)* (else list)? fi
+ *             | (while | until) list do list done
+ *             | for NAME (in word*)? ; do list done
+ *             | pipeline
+ *
+ * Reserved words count only where a command starts. A pipeline that runs
+ * once (outside any loop) is expanded and run in place, as before. Inside a
+ * loop each iteration runs a fresh copy of the parsed pipeline instead, so
+ * a loop body is never parsed again; only expansion, which picks up the
+ * loop variable's new value, is redone.
+ */
+
+typedef enum {
+    NODE_PIPELINE,
+    NODE_AND,
+    NODE_OR,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_UNTIL,
+    NODE_FOR
+} NodeType;
+
+struct ScriptNode {
+    NodeType type;
+    int background;             // `&` after anything but a lone pipeline
+    CommandPipeline* pipeline;  // NODE_PIPELINE
+    ScriptNode* left;           // && / || first operand; if / loop condition
+    ScriptNode* right;          // && / || second operand; then-branch; loop body
+    ScriptNode* otherwise;      // else-branch (an elif is a nested if)
+    char* var;                  // for: the variable
+    char** words;               // for: the words, unexpanded
+    int word_count;
+    ScriptNode* next;           // The next command of the same list
+};
+
+typedef struct {
+    char* pos;
+    int incomplete; // Ran out of input where more was required
+} Parser;
+
+static const char* const terminators[] = {"then", "elif", "else", "fi", "do", "done", NULL};
+
+// While running: loops entered, and a pending `break`/`continue`.
+static int loop_depth = 0;
+static int jump_levels = 0;   // Loops still to leave
+static int jump_continue = 0; // ...and then continue the next one out
+
+static ScriptNode* parse_list(Parser* p, int* ok);
+
+static ScriptNode* new_node(NodeType type) {
+    ScriptNode* node = calloc(1, sizeof(ScriptNode));
+    if (node) node->type = type;
+    return node;
+}
+
+void script_free(ScriptNode* node) {
+    while (node) {
+        ScriptNode* next = node->next;
+        free_pipeline(node->pipeline);
+        script_free(node->left);
+        script_free(node->right);
+        script_free(node->otherwise);
+        free(node->var);
+        for (int i = 0; i < node->word_count; i++) free(node->words[i]);
+        free(node->words);
+        free(node);
+        node = next;
+    }
+}
+
+// --- Parsing ---
+
+// Length of the next word if it could be a reserved word (lowercase letters
+// standing on their own), else 0. Most command words fail on the first byte.
+static size_t keyword_length(Parser* p) {
+    skip_whitespace(&p->pos);
+    size_t n = 0;
+    while (p->pos[n] >= 'a' && p->pos[n] <= 'z') n++;
+    char after = p->pos[n];
+    if (after != '\0' && !isspace((unsigned char)after) && !strchr(";&|<>()", after)) {
+        return 0;
+    }
+    return n;
+}
+
+static int is_word(const char* pos, size_t n, const char* word) {
+    return strlen(word) == n && strncmp(pos, word, n) == 0;
+}
+
+static int take_word(Parser* p, const char* word) {
+    size_t n = keyword_length(p);
+    if (n == 0 || !is_word(p->pos, n, word)) return 0;
+    p->pos += n;
+    return 1;
+}
+
+static int at_terminator(Parser* p) {
+    size_t n = keyword_length(p);
+    for (int i = 0; n > 0 && terminators[i]; i++) {
+        if (is_word(p->pos, n, terminators[i])) return 1;
+    }
+    return 0;
+}
+
+static int at_end(Parser* p) {
+    skip_whitespace(&p->pos);
+    return *p->pos == '\0';
+}
+
+// Consumes `word`, or fails, as incomplete if the input ran out first.
+static int expect_word(Parser* p, const char* word) {
+    if (take_word(p, word)) return 1;
+    if (at_end(p)) p->incomplete = 1;
+    return 0;
+}
+
+// A list that must have at least one command (conditions and bodies).
+static ScriptNode* parse_body(Parser* p) {
+    int ok;
+    ScriptNode* list = parse_list(p, &ok);
+    if (ok && list == NULL && at_end(p)) p->incomplete = 1;
+    return list;
+}
+
+static ScriptNode* parse_if(Parser* p) {
+    ScriptNode* node = new_node(NODE_IF);
+    if (!node) return NULL;
+    if (!(node->left = parse_body(p)) || !expect_word(p, "then") || !(node->right = parse_body(p))) {
+        goto fail;
+    }
+    if (take_word(p, "elif")) {
+        if (!(node->otherwise = parse_if(p))) goto fail; // It takes the `fi`
+        return node;
+    }
+    if (take_word(p, "else") && !(node->otherwise = parse_body(p))) {
+        goto fail;
+    }
+    if (!expect_word(p, "fi")) goto fail;
+    return node;
+
+fail:
+    script_free(node);
+    return NULL;
+}
+
+static ScriptNode* parse_loop(Parser* p, NodeType type) {
+    ScriptNode* node = new_node(type);
+    if (!node) return NULL;
+    if (!(node->left = parse_body(p)) || !expect_word(p, "do") ||
+        !(node->right = parse_body(p)) || !expect_word(p, "done")) {
+        script_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+static ScriptNode* parse_for(Parser* p) {
+    ScriptNode* node = new_node(NODE_FOR);
+    if (!node) return NULL;
+    skip_whitespace(&p->pos);
+    char* start = p->pos;
+    while (isalnum((unsigned char)*p->pos) || *p->pos == '_') p->pos++;
+    if (p->pos == start || isdigit((unsigned char)*start) || !(node->var = strndup(start, p->pos - start))) {
+        if (at_end(p)) p->incomplete = 1;
+        goto fail;
+    }
+    if (take_word(p, "in")) {
+        int capacity = 0;
+        char* word;
+        while (skip_whitespace(&p->pos), *p->pos != ';' && parse_name(&p->pos, &word)) {
+            if (node->word_count == capacity) {
+                capacity = capacity ? capacity * 2 : INITIAL_ARGS;
+                char** tmp = realloc(node->words, capacity * sizeof(char*));
+                if (!tmp) {
+                    free(word);
+                    goto fail;
+                }
+                node->words = tmp;
+            }
+            node->words[node->word_count++] = word;
+        }
+    }
+    skip_whitespace(&p->pos);
+    while (*p->pos == ';') {
+        p->pos++;
+        skip_whitespace(&p->pos);
+    }
+    if (!expect_word(p, "do") || !(node->right = parse_body(p)) || !expect_word(p, "done")) {
+        goto fail;
+    }
+    return node;
+
+fail:
+    script_free(node);
+    return NULL;
+}
+
+static ScriptNode* parse_command(Parser* p) {
+    if (keyword_length(p) > 0) {
+        if (take_word(p, "if")) return parse_if(p);
+        if (take_word(p, "while")) return parse_loop(p, NODE_WHILE);
+        if (take_word(p, "until")) return parse_loop(p, NODE_UNTIL);
+        if (take_word(p, "for")) return parse_for(p);
+        if (at_terminator(p)) return NULL; // e.g. `true && done`
+    }
+
+    ScriptNode* node = new_node(NODE_PIPELINE);
+    if (node && (node->pipeline = calloc(1, sizeof(CommandPipeline))) &&
+        parse_cmd_group(&p->pos, node->pipeline)) {
+        return node;
+    }
+    script_free(node);
+    return NULL;
+}
+
+static ScriptNode* parse_and_or(Parser* p) {
+    ScriptNode* left = parse_command(p);
+    while (left) {
+        skip_whitespace(&p->pos);
+        NodeType type;
+        if (strncmp(p->pos, "&&", 2) == 0) {
+            type = NODE_AND;
+        } else if (strncmp(p->pos, "||", 2) == 0) {
+            type = NODE_OR;
+        } else {
+            break;
+        }
+        p->pos += 2;
+        ScriptNode* node = new_node(type);
+        if (at_end(p)) p->incomplete = 1;
+        if (!node || !(node->right = parse_command(p))) {
+            free(node);
+            script_free(left);
+            return NULL;
+        }
+        node->left = left;
+        left = node;
+    }
+    return left;
+}
+
+/**
+ * @brief Parses commands up to the end of the input or a reserved word
+ * that ends a list (`then`, `fi`, `done`, ...). Empty commands (`;;`) are
+ * skipped, so lines joined with "; " parse the way they read.
+ * @param ok Set to 0 on a syntax error. An empty list is not one.
+ */
+static ScriptNode* parse_list(Parser* p, int* ok) {
+    ScriptNode* head = NULL;
+    ScriptNode** tail = &head;
+    *ok = 1;
+    for (;;) {
+        skip_whitespace(&p->pos);
+        while (*p->pos == ';') {
+            p->pos++;
+            skip_whitespace(&p->pos);
+        }
+        if (*p->pos == '\0' || at_terminator(p)) {
+            return head;
+        }
+        ScriptNode* node = parse_and_or(p);
+        if (!node) break;
+        *tail = node;
+        tail = &node->next;
+
+        skip_whitespace(&p->pos);
+        if (*p->pos == '&') {
+            p->pos++;
+            if (node->type == NODE_PIPELINE) {
+                node->pipeline->mode = BACKGROUND;
+            } else {
+                node->background = 1;
+            }
+        } else if (*p->pos == ';') {
+            p->pos++;
+        } else if (*p->pos != '\0' && !at_terminator(p)) {
+            break; // e.g. a redirection after `done`
+        }
+    }
+    *ok = 0;
+    script_free(head);
+    return NULL;
+}
+
+ScriptNode* script_parse(char* text, int* incomplete) {
+    Parser p = {text, 0};
+    int ok;
+    ScriptNode* tree = parse_list(&p, &ok);
+    if (ok && !at_end(&p)) { // A `done` or `fi` with nothing to close
+        script_free(tree);
+        ok = 0;
+    }
+    if (!ok && !p.incomplete) {
+        // A trailing `|` fails inside parse_cmd_group(), which can't tell.
+        size_t len = strlen(text);
+        while (len > 0 && isspace((unsigned char)text[len - 1])) len--;
+        p.incomplete = len > 0 && text[len - 1] == '|';
+    }
+    if (incomplete) *incomplete = !ok && p.incomplete;
+    return ok ? tree : NULL;
+}
+
+static int collect_pipelines(ScriptNode* node, CommandPipeline*** out, int* count, int* capacity) {
+    for (; node; node = node->next) {
+        if (node->pipeline) {
+            if (*count == *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 8;
+                CommandPipeline** tmp = realloc(*out, *capacity * sizeof(CommandPipeline*));
+                if (!tmp) return -1;
+                *out = tmp;
+            }
+            (*out)[(*count)++] = node->pipeline;
+        }
+        if (collect_pipelines(node->left, out, count, capacity) != 0 ||
+            collect_pipelines(node->right, out, count, capacity) != 0 ||
+            collect_pipelines(node->otherwise, out, count, capacity) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int script_pipelines(ScriptNode* tree, CommandPipeline*** out) {
+    int count = 0, capacity = 0;
+    *out = NULL;
+    if (collect_pipelines(tree, out, &count, &capacity) != 0) {
+        free(*out);
+        *out = NULL;
+        return -1;
+    }
+    return count;
+}
+
+// --- Running ---
+
+static int run_node(ScriptNode* node, const char* text);
+
+// 1 once a list must stop early: Ctrl-C, or a pending break/continue.
+static int unwinding(void) {
+    return interrupted || jump_levels > 0;
+}
+
+static int run_list(ScriptNode* node, const char* text) {
+    int status = 0;
+    for (; node && !unwinding(); node = node->next) {
+        status = run_node(node, text);
+        set_last_status(status);
+    }
+    return status;
+}
+
+/**
+ * @brief After a loop's condition or body: 1 if the loop must end (Ctrl-C,
+ * or a break or continue aimed further out), 0 to go on, which is also
+ * where a continue aimed at this loop lands.
+ */
+static int loop_should_stop(int* status) {
+    if (interrupted) {
+        *status = 130;
+        return 1;
+    }
+    if (jump_levels == 0) return 0;
+    if (--jump_levels > 0) return 1;
+    if (jump_continue) {
+        jump_continue = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// `break [n]` and `continue [n]`, which only mean something to the loops here.
+static int run_jump(SimpleCommand* cmd) {
+    const char* name = cmd->args[0];
+    int levels = cmd->args[1] ? atoi(cmd->args[1]) : 1;
+    if (loop_depth == 0) {
+        fprintf(stderr, "%s: only meaningful in a `for', `while', or `until' loop\n", name);
+        return 0;
+    }
+    if (levels < 1) {
+        fprintf(stderr, "%s: %s: loop count out of range\n", name, cmd->args[1]);
+        return 1;
+    }
+    jump_levels = levels < loop_depth ? levels : loop_depth;
+    jump_continue = name[0] == 'c';
+    return 0;
+}
+
+static int run_pipeline(CommandPipeline* pipeline, const char* text) {
+    SimpleCommand* cmd = &pipeline->commands[0];
+    if (pipeline->num_commands == 1 && cmd->arg_count > 0 &&
+        (strcmp(cmd->args[0], "break") == 0 || strcmp(cmd->args[0], "continue") == 0)) {
+        return run_jump(cmd);
+    }
+    if (loop_depth == 0) {
+        execute_pipeline(pipeline, text); // Runs once, so it may be expanded in place
+        return get_last_status();
+    }
+    CommandPipeline* copy = copy_pipeline(pipeline);
+    if (!copy) {
+        perror("shell: copy pipeline");
+        return 1;
+    }
+    execute_pipeline(copy, text);
+    free_pipeline(copy);
+    return get_last_status();
+}
+
+static int run_loop(ScriptNode* node, const char* text) {
+    int status = 0;
+    loop_depth++;
+    for (;;) {
+        int condition = run_list(node->left, text);
+        if (loop_should_stop(&status) || (condition == 0) != (node->type == NODE_WHILE)) {
+            break;
+        }
+        status = run_list(node->right, text);
+        if (loop_should_stop(&status)) break;
+    }
+    loop_depth--;
+    return status;
+}
+
+static void free_words(SimpleCommand* list) {
+    for (int i = 0; i < list->arg_count; i++) free(list->args[i]);
+    free(list->args);
+    for (int i = 0; i < list->assignment_count; i++) free(list->assignments[i]);
+    free(list->assignments);
+}
+
+static int run_for(ScriptNode* node, const char* text) {
+    // The words are expanded once per loop, like a command's arguments; a
+    // leading "for" keeps the first of them from passing as an assignment.
+    SimpleCommand list = {0};
+    char* keyword = strdup("for");
+    if (!keyword || !append_arg(&list, keyword)) {
+        free(keyword);
+        return 1;
+    }
+    for (int i = 0; i < node->word_count; i++) {
+        char* word = strdup(node->words[i]);
+        if (!word || !append_arg(&list, word)) {
+            free(word);
+            free_words(&list);
+            return 1;
+        }
+    }
+    if (expand_command_words(&list) != 0 || expand_command_globs(&list) != 0) {
+        free_words(&list);
+        return 1;
+    }
+
+    int status = 0;
+    loop_depth++;
+    for (int i = 1; i < list.arg_count; i++) {
+        vars_set(node->var, list.args[i]);
+        status = run_list(node->right, text);
+        if (loop_should_stop(&status)) break;
+    }
+    loop_depth--;
+    free_words(&list);
+    return status;
+}
+
+/**
+ * @brief `compound &` or `a && b &`: runs the node in a forked copy of the
+ * shell, as one job whose pipelines all join its process group.
+ */
+static int run_in_background(ScriptNode* node, const char* text) {
+    out_flush(); // Don't let the child inherit (and repeat) pending output
+    shellstat.forks++;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("shell: fork");
+        return 1;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        __fpurge(stdin); // The shell's read-ahead isn't ours; see execute_child_command()
+        set_job_group(getpid());
+        node->background = 0;
+        int status = run_node(node, text);
+        fflush(stdout);
+        exit(status);
+    }
+    setpgid(pid, pid);
+    add_job(pid, text);
+    return 0;
+}
+
+static int run_node(ScriptNode* node, const char* text) {
+    if (node->background) {
+        return run_in_background(node, text);
+    }
+    int status = 0;
+    switch (node->type) {
+    case NODE_PIPELINE:
+        return run_pipeline(node->pipeline, text);
+    case NODE_AND:
+    case NODE_OR:
+        status = run_node(node->left, text);
+        if (!unwinding() && (status == 0) == (node->type == NODE_AND)) {
+            set_last_status(status);
+            status = run_node(node->right, text);
+        }
+        return status;
+    case NODE_IF:
+        status = run_list(node->left, text);
+        if (unwinding()) return status;
+        if (status == 0) return run_list(node->right, text);
+        return node->otherwise ? run_list(node->otherwise, text) : 0;
+    case NODE_WHILE:
+    case NODE_UNTIL:
+        return run_loop(node, text);
+    case NODE_FOR:
+        return run_for(node, text);
+    }
+    return status;
+}
+
+int script_run(ScriptNode* tree, const char* text) {
+    if (loop_depth == 0) {
+        interrupted = 0; // A Ctrl-C at the prompt doesn't count
+    }
+    return run_list(tree, text);
+}
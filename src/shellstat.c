@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+
+// Custom headers
+#include "shellstat.h"
+#include "builtins.h"
+#include "jobs.h"
+#include "jobsched.h"
+#include "dircache.h"
+#include "memo.h"
+#include "output.h"
+
+ShellStats shellstat;
+
+typedef struct {
+    unsigned long running;
+    unsigned long stopped;
+    unsigned long queued;
+} JobCounts;
+
+static void count_jobs(JobCounts* counts) {
+    Job jobs[MAX_JOBS];
+    int count = get_active_jobs(jobs);
+    counts->running = counts->stopped = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].status == JOB_STOPPED) {
+            counts->stopped++;
+        } else {
+            counts->running++;
+        }
+    }
+    counts->queued = jobsched_queue_length();
+}
+
+static double hit_rate(unsigned long long hits, unsigned long long misses) {
+    return hits + misses ? (double)hits / (hits + misses) : 0.0;
+}
+
+static void print_text(const JobCounts* jobs, const DirCacheStats* dir,
+                       unsigned long long memo_hits, unsigned long long memo_misses) {
+    const ShellStats* s = &shellstat;
+    out_printf("command lines: %lu  pipelines: %lu\n", s->command_lines, s->pipelines);
+    out_printf("parses: %lu, %.3f ms (%.1f us each)\n", s->parses, s->parse_ns / 1e6,
+               s->parses ? s->parse_ns / 1e3 / s->parses : 0.0);
+    out_printf("forks: %lu  execs: %lu\n", s->forks, s->execs);
+    out_printf("history: %llu bytes written\n", s->history_bytes);
+    out_printf("reveal: %lu entries listed\n", s->reveal_entries);
+    out_printf("jobs: %lu started, %lu queued, %lu finished; now %lu running, %lu stopped, %lu queued\n",
+               s->jobs_started, s->jobs_queued, s->jobs_finished,
+               jobs->running, jobs->stopped, jobs->queued);
+    out_printf("dircache: %lu hits, %lu misses (%.1f%% hit rate)\n", dir->hits, dir->misses,
+               100.0 * hit_rate(dir->hits, dir->misses));
+    out_printf("memo: %llu hits, %llu misses (%.1f%% hit rate)\n", memo_hits, memo_misses,
+               100.0 * hit_rate(memo_hits, memo_misses));
+
+    out_printf("builtins:\n");
+    unsigned long calls;
+    const char* name;
+    for (int i = 0; (name = builtin_calls(i, &calls)) != NULL; i++) {
+        if (calls > 0) {
+            out_printf("  %-12s %lu\n", name, calls);
+        }
+    }
+}
+
+static void print_json(const JobCounts* jobs, const DirCacheStats* dir,
+                       unsigned long long memo_hits, unsigned long long memo_misses) {
+    const ShellStats* s = &shellstat;
+    out_printf("{\"command_lines\":%lu,\"pipelines\":%lu,\"parses\":%lu,\"parse_ns\":%llu,",
+               s->command_lines, s->pipelines, s->parses, s->parse_ns);
+    out_printf("\"forks\":%lu,\"execs\":%lu,\"history_bytes\":%llu,\"reveal_entries\":%lu,",
+               s->forks, s->execs, s->history_bytes, s->reveal_entries);
+    out_printf("\"jobs\":{\"started\":%lu,\"queued\":%lu,\"finished\":%lu,"
+               "\"now_running\":%lu,\"now_stopped\":%lu,\"now_queued\":%lu},",
+               s->jobs_started, s->jobs_queued, s->jobs_finished,
+               jobs->running, jobs->stopped, jobs->queued);
+    out_printf("\"caches\":{\"dircache\":{\"hits\":%lu,\"misses\":%lu,\"hit_rate\":%.4f},",
+               dir->hits, dir->misses, hit_rate(dir->hits, dir->misses));
+    out_printf("\"memo\":{\"hits\":%llu,\"misses\":%llu,\"hit_rate\":%.4f}},",
+               memo_hits, memo_misses, hit_rate(memo_hits, memo_misses));
+
+    // Builtin names are plain identifiers; none need escaping.
+    out_printf("\"builtins\":{");
+    unsigned long calls;
+    const char* name;
+    for (int i = 0; (name = builtin_calls(i, &calls)) != NULL; i++) {
+        out_printf("%s\"%s\":%lu", i > 0 ? "," : "", name, calls);
+    }
+    out_printf("}}\n");
+}
+
+/**
+ * @brief Implements `shellstat` and `shellstat --json`, which prints the
+ * same counters as one JSON object on a line.
+ */
+void execute_shellstat(char** args) {
+    int json = 0;
+    if (args[1] != NULL) {
+        if (strcmp(args[1], "--json") != 0 || args[2] != NULL) {
+            fprintf(stderr, "shellstat: usage: shellstat [--json]\n");
+            set_builtin_status(2);
+            return;
+        }
+        json = 1;
+    }
+
+    JobCounts jobs;
+    count_jobs(&jobs);
+    DirCacheStats dir;
+    dircache_get_stats(&dir);
+    unsigned long long memo_hits, memo_misses;
+    memo_get_stats(&memo_hits, &memo_misses);
+
+    if (json) {
+        print_json(&jobs, &dir, memo_hits, memo_misses);
+    } else {
+        print_text(&jobs, &dir, memo_hits, memo_misses);
+    }
+}
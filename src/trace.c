@@ -0,0 +1,351 @@
+#define _GNU_SOURCE // For MAP_ANONYMOUS, MAP_NORESERVE and gettid via syscall()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Custom headers
+#include "trace.h"
+#include "output.h"
+#include "builtins.h"
+
+/*
+ * Span tracing, written out as Chrome trace-event JSON (open it in Perfetto
+ * or chrome://tracing).
+ *
+ * Events go into ring buffers, one per thread, each written by its owner
+ * only: the event is filled in and then published by a release store of the
+ * ring's head, so recording takes no locks and never waits. A thread claims
+ * its ring on first use with an atomic increment. All rings live in one
+ * shared anonymous mapping, so a forked child (which claims a ring of its
+ * own once the pthread_atfork handler drops the parent's) still has its
+ * events seen by the shell after it execs. A full ring overwrites its
+ * oldest events.
+ *
+ * Rings are handed back when their thread exits or their process execs, and
+ * reused once no fresh ring is left. Every event carries its own pid and tid,
+ * so a reused ring still attributes older events correctly.
+ */
+
+#define TRACE_MAX_RINGS 128
+#define TRACE_RING_EVENTS 4096 // Per ring; must be a power of two
+#define TRACE_NAME_LEN 24
+#define TRACE_DETAIL_LEN 72
+#define DEFAULT_TRACE_FILE "shell_trace.json"
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int pid;
+    int tid;
+    char instant;
+    char name[TRACE_NAME_LEN];
+    char detail[TRACE_DETAIL_LEN];
+} TraceEvent;
+
+enum { RING_FRESH, RING_IN_USE, RING_RELEASED };
+
+typedef struct {
+    uint64_t head;  // Events ever written; published with release stores
+    uint32_t state; // RING_*, changed atomically
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+typedef struct {
+    uint32_t rings_claimed;
+    uint32_t rings_exhausted; // Threads that found no free ring
+    uint64_t epoch_ns;
+    TraceRing rings[TRACE_MAX_RINGS];
+} TraceArena;
+
+int trace_enabled = 0;
+
+static TraceArena* arena = NULL;
+static char trace_path[1024];
+static pid_t trace_owner = 0;  // Only this process writes the file
+static int atfork_registered = 0;
+static int atexit_registered = 0;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static __thread TraceRing* my_ring = NULL;
+static __thread int my_pid;
+static __thread int my_tid;
+
+uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void release_ring(void* ring) {
+    uint32_t expected = RING_IN_USE;
+    __atomic_compare_exchange_n(&((TraceRing*)ring)->state, &expected, RING_RELEASED, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring); // Releases a thread's ring when it exits
+}
+
+static TraceRing* claim_ring(void) {
+    TraceRing* ring = NULL;
+    uint32_t idx = __atomic_fetch_add(&arena->rings_claimed, 1, __ATOMIC_RELAXED);
+    if (idx < TRACE_MAX_RINGS) {
+        ring = &arena->rings[idx];
+        __atomic_store_n(&ring->state, RING_IN_USE, __ATOMIC_RELAXED);
+    } else {
+        for (int i = 0; i < TRACE_MAX_RINGS && !ring; i++) {
+            uint32_t expected = RING_RELEASED;
+            if (__atomic_compare_exchange_n(&arena->rings[i].state, &expected, RING_IN_USE, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                ring = &arena->rings[i];
+            }
+        }
+        if (!ring) {
+            __atomic_fetch_add(&arena->rings_exhausted, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    }
+    my_pid = (int)getpid();
+    my_tid = (int)syscall(SYS_gettid);
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+static TraceEvent* next_event(TraceRing** ring_out) {
+    if (!arena) return NULL;
+    if (!my_ring) {
+        my_ring = claim_ring();
+        if (!my_ring) return NULL;
+    }
+    *ring_out = my_ring;
+    uint64_t head = __atomic_load_n(&my_ring->head, __ATOMIC_RELAXED);
+    return &my_ring->events[head & (TRACE_RING_EVENTS - 1)];
+}
+
+static void publish(TraceRing* ring) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void copy_text(char* dst, size_t size, const char* src) {
+    if (!src) {
+        dst[0] = '\0';
+        return;
+    }
+    size_t n = strlen(src);
+    if (n >= size) n = size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, const char* detail) {
+    TraceRing* ring;
+    TraceEvent* e = next_event(&ring);
+    if (!e) return;
+    e->start_ns = start_ns;
+    e->dur_ns = end_ns - start_ns;
+    e->pid = my_pid;
+    e->tid = my_tid;
+    e->instant = 0;
+    copy_text(e->name, sizeof(e->name), name);
+    copy_text(e->detail, sizeof(e->detail), detail);
+    publish(ring);
+}
+
+void trace_record_instant(const char* name, const char* detail) {
+    TraceRing* ring;
+    TraceEvent* e = next_event(&ring);
+    if (!e) return;
+    e->start_ns = trace_now_ns();
+    e->dur_ns = 0;
+    e->pid = my_pid;
+    e->tid = my_tid;
+    e->instant = 1;
+    copy_text(e->name, sizeof(e->name), name);
+    copy_text(e->detail, sizeof(e->detail), detail);
+    publish(ring);
+}
+
+void trace_record_exec(const char* detail) {
+    trace_record_instant("exec", detail);
+    if (my_ring) {
+        release_ring(my_ring); // Nothing more will be recorded by this process
+        my_ring = NULL;
+    }
+}
+
+// A forked child must not write into its parent's ring.
+static void forget_ring_in_child(void) {
+    my_ring = NULL;
+    pthread_setspecific(ring_key, NULL);
+}
+
+static void flush_at_exit(void) {
+    if (!trace_enabled) return;
+    if (getpid() == trace_owner) {
+        trace_stop();
+    } else if (my_ring) {
+        release_ring(my_ring); // A forked child that ran a builtin
+        my_ring = NULL;
+    }
+}
+
+int trace_start(const char* path) {
+    if (trace_enabled) return 0;
+    void* map = mmap(NULL, sizeof(TraceArena), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) return -1;
+    arena = map; // Zero-filled: no rings claimed yet
+    arena->epoch_ns = trace_now_ns();
+    copy_text(trace_path, sizeof(trace_path), path ? path : DEFAULT_TRACE_FILE);
+    trace_owner = getpid();
+    my_ring = NULL;
+    pthread_once(&ring_key_once, create_ring_key);
+    pthread_setspecific(ring_key, NULL);
+    if (!atfork_registered) {
+        pthread_atfork(NULL, NULL, forget_ring_in_child);
+        atfork_registered = 1;
+    }
+    trace_enabled = 1;
+    return 0;
+}
+
+static void write_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', out);
+            fputc(c, out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_event(FILE* out, const TraceEvent* e) {
+    // Chrome trace timestamps are in microseconds.
+    double ts = (double)(e->start_ns - arena->epoch_ns) / 1000.0;
+    fprintf(out, ",\n{\"name\":");
+    write_json_string(out, e->name);
+    if (e->instant) {
+        fprintf(out, ",\"cat\":\"shell\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", ts);
+    } else {
+        fprintf(out, ",\"cat\":\"shell\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                ts, (double)e->dur_ns / 1000.0);
+    }
+    fprintf(out, ",\"pid\":%d,\"tid\":%d", e->pid, e->tid);
+    if (e->detail[0]) {
+        fprintf(out, ",\"args\":{\"detail\":");
+        write_json_string(out, e->detail);
+        fputc('}', out);
+    }
+    fputc('}', out);
+
+    // Name each child process after the command it ran.
+    if (e->instant && strcmp(e->name, "exec") == 0) {
+        fprintf(out, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":", e->pid);
+        write_json_string(out, e->detail);
+        fprintf(out, "}}");
+    }
+}
+
+static void discard_arena(void) {
+    munmap(arena, sizeof(TraceArena));
+    arena = NULL;
+    my_ring = NULL;
+    pthread_setspecific(ring_key, NULL);
+}
+
+int trace_stop(void) {
+    if (!trace_enabled) return 0;
+    trace_enabled = 0;
+
+    FILE* out = fopen(trace_path, "w");
+    if (!out) {
+        perror("trace: open output");
+        discard_arena();
+        return -1;
+    }
+
+    uint32_t rings = __atomic_load_n(&arena->rings_claimed, __ATOMIC_ACQUIRE);
+    if (rings > TRACE_MAX_RINGS) rings = TRACE_MAX_RINGS;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    fprintf(out, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"shell\"}}",
+            (int)trace_owner);
+    for (uint32_t r = 0; r < rings; r++) {
+        const TraceRing* ring = &arena->rings[r];
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t begin = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < head; i++) {
+            write_event(out, &ring->events[i & (TRACE_RING_EVENTS - 1)]);
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+
+    if (arena->rings_exhausted) {
+        fprintf(stderr, "trace: %u threads or processes were not traced (out of buffers)\n",
+                arena->rings_exhausted);
+    }
+    discard_arena();
+    return 0;
+}
+
+void trace_init_from_env(void) {
+    const char* path = getenv("ROY_SHELL_TRACE");
+    if (!path || path[0] == '\0') return;
+    if (trace_start(path) != 0) {
+        perror("trace: start");
+        return;
+    }
+    if (!atexit_registered) {
+        atexit(flush_at_exit);
+        atexit_registered = 1;
+    }
+}
+
+/**
+ * @brief Implements `trace start [file]`, `trace stop` and `trace status`.
+ */
+void execute_trace(char** args) {
+    if (args[1] == NULL || strcmp(args[1], "status") == 0) {
+        if (trace_enabled) out_printf("tracing to %s\n", trace_path);
+        else out_printf("tracing is off\n");
+    } else if (strcmp(args[1], "start") == 0) {
+        if (trace_enabled) {
+            fprintf(stderr, "trace: already tracing to %s\n", trace_path);
+            set_builtin_status(1);
+            return;
+        }
+        if (trace_start(args[2]) != 0) {
+            perror("trace: start");
+            set_builtin_status(1);
+            return;
+        }
+        if (!atexit_registered) {
+            atexit(flush_at_exit);
+            atexit_registered = 1;
+        }
+    } else if (strcmp(args[1], "stop") == 0) {
+        if (!trace_enabled) {
+            fprintf(stderr, "trace: not tracing\n");
+            set_builtin_status(1);
+            return;
+        }
+        if (trace_stop() == 0) out_printf("trace written to %s\n", trace_path);
+        else set_builtin_status(1);
+    } else {
+        fprintf(stderr, "Usage: trace [start [file] | stop | status]\n");
+        set_builtin_status(1);
+    }
+}
@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "vars.h"
+#include "command.h"
+#include "main.h" // For run_subshell_line
+#include "procsub.h"
+#include "shellstat.h"
+#include "output.h"
+
+extern char** environ;
+
+#define INITIAL_VAR_BUCKETS 64
+
+/*
+ * Shell variables and word expansion.
+ *
+ * Variables live in a hash table. Each exported variable keeps a ready-made
+ * "NAME=value" string, and `environ` points at a snapshot array of those
+ * strings. The snapshot is only rebuilt by vars_sync_environ() after an
+ * exported variable actually changed, so launching commands normally costs
+ * nothing here. Strings replaced since the last snapshot are retired rather
+ * than freed, since the current snapshot still points at them.
+ */
+
+typedef struct Var {
+    char* name;
+    char* value;      // NULL for "export NAME" without a value
+    char* env_entry;  // "NAME=value" while exported and set
+    int exported;
+    struct Var* next;
+} Var;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+static Var** var_buckets = NULL;
+static int var_num_buckets = 0;
+static int var_count = 0;
+
+static char** env_snapshot = NULL; // NULL until we first replace the inherited environ
+static int env_dirty = 1;
+static char** retired = NULL;
+static int retired_count = 0;
+static int retired_capacity = 0;
+
+static int last_status = 0;
+
+
+static unsigned int hash_name(const char* name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static Var* find_var(const char* name) {
+    if (var_num_buckets == 0) return NULL;
+    for (Var* v = var_buckets[hash_name(name) % var_num_buckets]; v; v = v->next) {
+        if (strcmp(v->name, name) == 0) return v;
+    }
+    return NULL;
+}
+
+static int grow_var_table(void) {
+    int new_count = var_num_buckets ? var_num_buckets * 2 : INITIAL_VAR_BUCKETS;
+    Var** new_buckets = calloc(new_count, sizeof(Var*));
+    if (!new_buckets) return -1;
+    for (int i = 0; i < var_num_buckets; i++) {
+        Var* v = var_buckets[i];
+        while (v) {
+            Var* next = v->next;
+            unsigned int b = hash_name(v->name) % new_count;
+            v->next = new_buckets[b];
+            new_buckets[b] = v;
+            v = next;
+        }
+    }
+    free(var_buckets);
+    var_buckets = new_buckets;
+    var_num_buckets = new_count;
+    return 0;
+}
+
+static Var* create_var(const char* name) {
+    if (var_count >= var_num_buckets && grow_var_table() != 0) return NULL;
+    Var* v = calloc(1, sizeof(Var));
+    if (!v || !(v->name = strdup(name))) {
+        free(v);
+        return NULL;
+    }
+    unsigned int b = hash_name(name) % var_num_buckets;
+    v->next = var_buckets[b];
+    var_buckets[b] = v;
+    var_count++;
+    return v;
+}
+
+// The current snapshot may still point at this string; free it on the next rebuild.
+static void retire_env_entry(Var* v) {
+    if (!v->env_entry) return;
+    if (retired_count == retired_capacity) {
+        int new_capacity = retired_capacity ? retired_capacity * 2 : 16;
+        char** tmp = realloc(retired, new_capacity * sizeof(char*));
+        if (!tmp) return; // Leak rather than leave environ dangling
+        retired = tmp;
+        retired_capacity = new_capacity;
+    }
+    retired[retired_count++] = v->env_entry;
+    v->env_entry = NULL;
+    env_dirty = 1;
+}
+
+static int build_env_entry(Var* v) {
+    if (!v->exported || !v->value) return 0;
+    size_t name_len = strlen(v->name), value_len = strlen(v->value);
+    v->env_entry = malloc(name_len + value_len + 2);
+    if (!v->env_entry) return -1;
+    memcpy(v->env_entry, v->name, name_len);
+    v->env_entry[name_len] = '=';
+    memcpy(v->env_entry + name_len + 1, v->value, value_len + 1);
+    env_dirty = 1;
+    return 0;
+}
+
+/**
+ * @brief Imports the inherited environment as exported variables.
+ */
+void init_vars(void) {
+    for (char** e = environ; e && *e; e++) {
+        char* eq = strchr(*e, '=');
+        if (!eq) continue;
+        char name[256];
+        size_t len = eq - *e;
+        if (len == 0 || len >= sizeof(name)) continue;
+        memcpy(name, *e, len);
+        name[len] = '\0';
+        vars_set(name, eq + 1);
+        vars_export(name);
+    }
+    // The inherited environ already matches; no need for a snapshot yet.
+    env_dirty = 0;
+}
+
+const char* vars_get(const char* name) {
+    Var* v = find_var(name);
+    return v ? v->value : NULL;
+}
+
+int vars_set(const char* name, const char* value) {
+    Var* v = find_var(name);
+    if (!v && !(v = create_var(name))) return -1;
+    if (v->value && strcmp(v->value, value) == 0) {
+        return 0; // Unchanged: keep the environment snapshot valid
+    }
+    char* copy = strdup(value);
+    if (!copy) return -1;
+    free(v->value);
+    v->value = copy;
+    if (v->exported) {
+        retire_env_entry(v);
+        return build_env_entry(v);
+    }
+    return 0;
+}
+
+int vars_export(const char* name) {
+    Var* v = find_var(name);
+    if (!v && !(v = create_var(name))) return -1;
+    if (v->exported) return 0;
+    v->exported = 1;
+    return build_env_entry(v);
+}
+
+void vars_unset(const char* name) {
+    if (var_num_buckets == 0) return;
+    Var** link = &var_buckets[hash_name(name) % var_num_buckets];
+    while (*link) {
+        Var* v = *link;
+        if (strcmp(v->name, name) == 0) {
+            *link = v->next;
+            retire_env_entry(v);
+            free(v->name);
+            free(v->value);
+            free(v);
+            var_count--;
+            return;
+        }
+        link = &v->next;
+    }
+}
+
+void vars_sync_environ(void) {
+    if (!env_dirty) return;
+
+    int count = 0;
+    for (int i = 0; i < var_num_buckets; i++) {
+        for (Var* v = var_buckets[i]; v; v = v->next) {
+            if (v->env_entry) count++;
+        }
+    }
+    char** snapshot = malloc((count + 1) * sizeof(char*));
+    if (!snapshot) return; // Keep the old one; we'll retry next time
+    int n = 0;
+    for (int i = 0; i < var_num_buckets; i++) {
+        for (Var* v = var_buckets[i]; v; v = v->next) {
+            if (v->env_entry) snapshot[n++] = v->env_entry;
+        }
+    }
+    snapshot[n] = NULL;
+
+    environ = snapshot;
+    free(env_snapshot); // The inherited array (NULL here) was never ours
+    env_snapshot = snapshot;
+    for (int i = 0; i < retired_count; i++) free(retired[i]);
+    retired_count = 0;
+    env_dirty = 0;
+}
+
+void set_last_status(int status) {
+    last_status = status;
+}
+
+int get_last_status(void) {
+    return last_status;
+}
+
+int is_assignment(const char* word) {
+    if (!(isalpha((unsigned char)word[0]) || word[0] == '_')) return 0;
+    const char* p = word + 1;
+    while (isalnum((unsigned char)*p) || *p == '_') p++;
+    return *p == '=';
+}
+
+void apply_assignments(char** assignments, int count, int export) {
+    for (int i = 0; i < count; i++) {
+        char* eq = strchr(assignments[i], '=');
+        *eq = '\0';
+        vars_set(assignments[i], eq + 1);
+        if (export) vars_export(assignments[i]);
+        *eq = '=';
+    }
+}
+
+
+// --- Expansion ---
+
+static int buf_append(Buffer* b, const char* s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t new_cap = b->cap ? b->cap : 64;
+        while (new_cap < b->len + n + 1) new_cap *= 2;
+        char* tmp = realloc(b->data, new_cap);
+        if (!tmp) return -1;
+        b->data = tmp;
+        b->cap = new_cap;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Captures the output of `command` through a pipe into a growing
+ * buffer. The command runs in a forked copy of the shell, so builtins work.
+ */
+char* command_substitution(const char* command) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("shell: pipe");
+        return NULL;
+    }
+
+    out_flush(); // Don't let the child inherit (and repeat) pending output
+    shellstat.forks++;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("shell: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        __fpurge(stdin); // The shell's read-ahead isn't ours; see execute_child_command()
+        close(fds[0]);
+        if (dup2(fds[1], STDOUT_FILENO) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        close(fds[1]);
+        run_subshell_line(command);
+    }
+
+    close(fds[1]);
+    Buffer out = {0};
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(fds[0], chunk, sizeof(chunk))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (buf_append(&out, chunk, n) != 0) break;
+    }
+    close(fds[0]);
+
+    int status;
+    if (waitpid(pid, &status, 0) > 0) {
+        set_last_status(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    }
+
+    if (!out.data && buf_append(&out, "", 0) != 0) return NULL;
+    while (out.len > 0 && out.data[out.len - 1] == '\n') {
+        out.data[--out.len] = '\0';
+    }
+    return out.data;
+}
+
+// Finds the ')' or '}' closing the group that starts at `open`, or NULL.
+static const char* find_closing(const char* open) {
+    char open_char = *open;
+    char close_char = (open_char == '(') ? ')' : '}';
+    int depth = 0;
+    for (const char* p = open; *p; p++) {
+        if (*p == open_char) depth++;
+        else if (*p == close_char && --depth == 0) return p;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Expands one word into `out`.
+ * @param expanded Set to 1 if any expansion happened (the result is then
+ *        subject to word splitting).
+ */
+static int expand_word(const char* word, Buffer* out, int* expanded) {
+    const char* p = word;
+    while (*p) {
+        if ((*p == '<' || *p == '>') && p[1] == '(') {
+            // <(cmd) and >(cmd) become the path of a pipe to a running cmd.
+            const char* close = find_closing(p + 1);
+            if (!close) {
+                fprintf(stderr, "shell: unterminated %c(\n", *p);
+                return -1;
+            }
+            char* inner = strndup(p + 2, close - p - 2);
+            char* path = inner ? procsub_open(inner, *p == '>') : NULL;
+            free(inner);
+            if (!path) return -1;
+            int rc = buf_append(out, path, strlen(path));
+            free(path);
+            if (rc != 0) return -1;
+            p = close + 1;
+            continue;
+        }
+        if (*p != '$') {
+            size_t n = strcspn(p, "$<>");
+            if (n == 0) n = 1; // A '<' or '>' that doesn't open a substitution
+            if (buf_append(out, p, n) != 0) return -1;
+            p += n;
+            continue;
+        }
+
+        if (p[1] == '(') {
+            const char* close = find_closing(p + 1);
+            if (!close) {
+                fprintf(stderr, "shell: unterminated $(\n");
+                return -1;
+            }
+            char* inner = strndup(p + 2, close - p - 2);
+            char* result = inner ? command_substitution(inner) : NULL;
+            free(inner);
+            if (result) {
+                int rc = buf_append(out, result, strlen(result));
+                free(result);
+                if (rc != 0) return -1;
+            }
+            *expanded = 1;
+            p = close + 1;
+        } else if (p[1] == '{') {
+            const char* close = find_closing(p + 1);
+            if (!close) {
+                fprintf(stderr, "shell: unterminated ${\n");
+                return -1;
+            }
+            char name[256];
+            size_t len = close - p - 2;
+            if (len >= sizeof(name)) len = sizeof(name) - 1;
+            memcpy(name, p + 2, len);
+            name[len] = '\0';
+            const char* value = vars_get(name);
+            if (value && buf_append(out, value, strlen(value)) != 0) return -1;
+            *expanded = 1;
+            p = close + 1;
+        } else if (p[1] == '?' || p[1] == '$') {
+            char num[32];
+            snprintf(num, sizeof(num), "%d", p[1] == '?' ? get_last_status() : (int)getpid());
+            if (buf_append(out, num, strlen(num)) != 0) return -1;
+            *expanded = 1;
+            p += 2;
+        } else if (isalpha((unsigned char)p[1]) || p[1] == '_') {
+            const char* start = p + 1;
+            const char* end = start;
+            while (isalnum((unsigned char)*end) || *end == '_') end++;
+            char name[256];
+            size_t len = end - start;
+            if (len >= sizeof(name)) len = sizeof(name) - 1;
+            memcpy(name, start, len);
+            name[len] = '\0';
+            const char* value = vars_get(name);
+            if (value && buf_append(out, value, strlen(value)) != 0) return -1;
+            *expanded = 1;
+            p = end;
+        } else {
+            // A lone '$' is literal.
+            if (buf_append(out, "$", 1) != 0) return -1;
+            p++;
+        }
+    }
+    if (!out->data) return buf_append(out, "", 0);
+    return 0;
+}
+
+// Expands a word that must stay a single word (redirection targets, assignments).
+static char* expand_single(const char* word) {
+    Buffer out = {0};
+    int expanded = 0;
+    if (expand_word(word, &out, &expanded) != 0) {
+        free(out.data);
+        return NULL;
+    }
+    return out.data;
+}
+
+// Adds the fields of an expanded word, split on whitespace, to `cmd`.
+static int append_fields(SimpleCommand* cmd, char* text) {
+    char* save = NULL;
+    for (char* field = strtok_r(text, " \t\n", &save); field; field = strtok_r(NULL, " \t\n", &save)) {
+        char* copy = strdup(field);
+        if (!copy || !append_arg(cmd, copy)) {
+            free(copy);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int needs_expansion(const char* word) {
+    return word && (strchr(word, '$') || strstr(word, "<(") || strstr(word, ">("));
+}
+
+static int expand_file(char** file) {
+    if (!needs_expansion(*file)) return 0;
+    char* value = expand_single(*file);
+    if (!value) return -1;
+    free(*file);
+    *file = value;
+    return 0;
+}
+
+/**
+ * @brief Runs parameter expansion and command and process substitution
+ * over a command.
+ * Leading NAME=value words are moved to cmd->assignments (with their values
+ * expanded); the remaining words are expanded and split into fields.
+ */
+int expand_command_words(SimpleCommand* cmd) {
+    int work = cmd->arg_count > 0 && is_assignment(cmd->args[0]);
+    for (int i = 0; !work && i < cmd->arg_count; i++) {
+        work = needs_expansion(cmd->args[i]);
+    }
+    if (expand_file(&cmd->input_file) != 0 || expand_file(&cmd->output_file) != 0 ||
+        expand_file(&cmd->here_string) != 0) {
+        return -1;
+    }
+    if (!work) return 0;
+
+    SimpleCommand result = {0};
+    SimpleCommand assigns = {0}; // Only its argument list is used
+    int i = 0;
+    for (; i < cmd->arg_count && is_assignment(cmd->args[i]); i++) {
+        char* value = expand_single(cmd->args[i]);
+        if (!value || !append_arg(&assigns, value)) {
+            free(value);
+            goto fail;
+        }
+    }
+    for (; i < cmd->arg_count; i++) {
+        if (!needs_expansion(cmd->args[i])) {
+            char* copy = strdup(cmd->args[i]);
+            if (!copy || !append_arg(&result, copy)) {
+                free(copy);
+                goto fail;
+            }
+            continue;
+        }
+        Buffer out = {0};
+        int expanded = 0;
+        if (expand_word(cmd->args[i], &out, &expanded) != 0 || append_fields(&result, out.data) != 0) {
+            free(out.data);
+            goto fail;
+        }
+        free(out.data);
+    }
+
+    for (int j = 0; j < cmd->arg_count; j++) free(cmd->args[j]);
+    free(cmd->args);
+    cmd->args = result.args;
+    cmd->arg_count = result.arg_count;
+    cmd->arg_capacity = result.arg_capacity;
+    cmd->assignments = assigns.args;
+    cmd->assignment_count = assigns.arg_count;
+    return 0;
+
+fail:
+    for (int j = 0; j < result.arg_count; j++) free(result.args[j]);
+    free(result.args);
+    for (int j = 0; j < assigns.arg_count; j++) free(assigns.args[j]);
+    free(assigns.args);
+    return -1;
+}
+
+
+// --- Builtins ---
+
+static int var_name_comparator(const void* a, const void* b) {
+    return strcmp((*(Var* const*)a)->name, (*(Var* const*)b)->name);
+}
+
+/**
+ * @brief Implements 'export [NAME[=value]...]'. Without arguments it lists
+ * the exported variables.
+ */
+void execute_export(char** args) {
+    if (args[1] == NULL) {
+        Var** list = malloc((var_count + 1) * sizeof(Var*));
+        if (!list) return;
+        int n = 0;
+        for (int i = 0; i < var_num_buckets; i++) {
+            for (Var* v = var_buckets[i]; v; v = v->next) {
+                if (v->exported) list[n++] = v;
+            }
+        }
+        qsort(list, n, sizeof(Var*), var_name_comparator);
+        for (int i = 0; i < n; i++) {
+            if (list[i]->value) out_printf("export %s=%s\n", list[i]->name, list[i]->value);
+            else out_printf("export %s\n", list[i]->name);
+        }
+        free(list);
+        return;
+    }
+
+    for (int i = 1; args[i] != NULL; i++) {
+        if (is_assignment(args[i])) {
+            apply_assignments(&args[i], 1, 1);
+        } else if (isalpha((unsigned char)args[i][0]) || args[i][0] == '_') {
+            vars_export(args[i]);
+        } else {
+            fprintf(stderr, "export: not a valid identifier: %s\n", args[i]);
+        }
+    }
+}
+
+void execute_unset(char** args) {
+    for (int i = 1; args[i] != NULL; i++) {
+        vars_unset(args[i]);
+    }
+}
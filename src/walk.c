@@ -0,0 +1,404 @@
+#define _GNU_SOURCE // For statx() via reveal.c helpers and O_DIRECTORY/O_NOFOLLOW
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Custom headers
+#include "walk.h"
+#include "reveal.h"
+#include "trace.h"
+
+#define MAX_WALK_THREADS 16
+#define IDLE_SPINS_BEFORE_SLEEP 64
+
+/*
+ * Parallel directory traversal for `reveal -R`.
+ *
+ * Every directory is one task. Each worker owns a deque: it pushes the
+ * subdirectories it discovers and pops them again from the same end (LIFO,
+ * so it stays in cache-warm parts of the tree), while idle workers steal from
+ * the opposite end (FIFO, so they take the largest untouched subtrees).
+ * Subdirectories are opened with openat() relative to their parent's fd.
+ * Results are stored in a tree of per-directory sorted entry arrays, which
+ * lets the caller print them in a deterministic order afterwards.
+ */
+
+typedef struct {
+    WalkNode** items;
+    int head;     // Thieves take from here
+    int tail;     // The owner pushes and pops here
+    int capacity;
+    pthread_mutex_t lock;
+} WorkDeque;
+
+typedef struct {
+    const WalkOptions* options;
+    WorkDeque* deques;
+    int num_workers;
+    long outstanding; // Tasks queued or running; the walk is over when it drops to 0
+    long entries;
+    long directories;
+} Walker;
+
+typedef struct {
+    Walker* walker;
+    int id;
+} WorkerArgs;
+
+
+static void deque_init(WorkDeque* dq) {
+    dq->items = NULL;
+    dq->head = 0;
+    dq->tail = 0;
+    dq->capacity = 0;
+    pthread_mutex_init(&dq->lock, NULL);
+}
+
+static void deque_destroy(WorkDeque* dq) {
+    free(dq->items);
+    pthread_mutex_destroy(&dq->lock);
+}
+
+static int deque_push(WorkDeque* dq, WalkNode* node) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->capacity) {
+        int live = dq->tail - dq->head;
+        if (dq->head > 0 && live < dq->capacity / 2) {
+            // Plenty of room freed up by thieves; slide the live range down.
+            memmove(dq->items, dq->items + dq->head, live * sizeof(WalkNode*));
+        } else {
+            int new_capacity = dq->capacity ? dq->capacity * 2 : 64;
+            WalkNode** tmp = realloc(dq->items, new_capacity * sizeof(WalkNode*));
+            if (!tmp) {
+                pthread_mutex_unlock(&dq->lock);
+                return -1;
+            }
+            dq->items = tmp;
+            dq->capacity = new_capacity;
+            memmove(dq->items, dq->items + dq->head, live * sizeof(WalkNode*));
+        }
+        dq->head = 0;
+        dq->tail = live;
+    }
+    dq->items[dq->tail++] = node;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static WalkNode* deque_pop(WorkDeque* dq) {
+    WalkNode* node = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) {
+        node = dq->items[--dq->tail];
+        if (dq->tail == dq->head) {
+            dq->head = dq->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return node;
+}
+
+static WalkNode* deque_steal(WorkDeque* dq) {
+    WalkNode* node = NULL;
+    // Don't queue up behind the owner; another victim may be free.
+    if (pthread_mutex_trylock(&dq->lock) != 0) {
+        return NULL;
+    }
+    if (dq->tail > dq->head) {
+        node = dq->items[dq->head++];
+        if (dq->tail == dq->head) {
+            dq->head = dq->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return node;
+}
+
+
+static WalkNode* new_node(WalkNode* parent, const char* name, const char* path) {
+    WalkNode* node = calloc(1, sizeof(WalkNode));
+    if (!node) return NULL;
+    node->parent = parent;
+    node->fd = -1;
+    node->name = strdup(name);
+    node->path = strdup(path);
+    if (!node->name || !node->path) {
+        free(node->name);
+        free(node->path);
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+// Called once a child has opened itself; the last child closes the parent's fd.
+static void release_parent_fd(WalkNode* parent) {
+    if (parent && __atomic_sub_fetch(&parent->pending_children, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(parent->fd);
+        parent->fd = -1;
+    }
+}
+
+static int open_node(WalkNode* node) {
+    int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    if (node->parent) {
+        node->fd = openat(node->parent->fd, node->name, flags);
+        if (node->fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+            // Too many ancestors held open; the full path still works.
+            node->fd = open(node->path, flags);
+        }
+    } else {
+        node->fd = open(node->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    return node->fd;
+}
+
+// Reads, filters and sorts the entries of an already opened directory.
+static int read_entries(WalkNode* node, const WalkOptions* options) {
+    int dup_fd = dup(node->fd);
+    if (dup_fd < 0) return -1;
+    DIR* dir = fdopendir(dup_fd);
+    if (!dir) {
+        close(dup_fd);
+        return -1;
+    }
+
+    int capacity = 32;
+    node->entries = malloc(capacity * sizeof(RevealEntry));
+    if (!node->entries) {
+        closedir(dir);
+        return -1;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (!options->show_hidden && de->d_name[0] == '.') {
+            continue;
+        }
+        if (node->count == capacity) {
+            capacity *= 2;
+            RevealEntry* tmp = realloc(node->entries, capacity * sizeof(RevealEntry));
+            if (!tmp) {
+                closedir(dir);
+                return -1;
+            }
+            node->entries = tmp;
+        }
+        RevealEntry* entry = &node->entries[node->count];
+        memset(entry, 0, sizeof(*entry));
+        entry->name = strdup(de->d_name);
+        if (!entry->name) {
+            closedir(dir);
+            return -1;
+        }
+        entry->d_type = de->d_type;
+        node->count++;
+    }
+    closedir(dir);
+
+    if (options->want_stat) {
+        for (int i = 0; i < node->count; i++) {
+            stat_entry(node->fd, &node->entries[i]);
+        }
+    }
+    sort_entries(node->entries, node->count, options->sort);
+    return 0;
+}
+
+static int is_subdirectory(int dirfd, RevealEntry* entry) {
+    const char* name = entry->name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return 0;
+    }
+    if (entry->d_type == DT_DIR) return 1;
+    if (entry->d_type != DT_UNKNOWN) return 0;
+
+    // Some filesystems don't fill in d_type; fall back to a stat.
+    if (entry->stat_ok) {
+        return S_ISDIR(entry->stx.stx_mode);
+    }
+    struct stat st;
+    return fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Processes one directory: lists it and queues its subdirectories.
+static void process_node(Walker* walker, WorkDeque* own, WalkNode* node) {
+    int opened = open_node(node);
+    release_parent_fd(node->parent);
+    if (opened < 0) {
+        node->error = errno;
+        return;
+    }
+
+    if (read_entries(node, walker->options) < 0) {
+        node->error = errno ? errno : ENOMEM;
+    }
+    __atomic_add_fetch(&walker->entries, node->count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&walker->directories, 1, __ATOMIC_RELAXED);
+
+    int subdirs = 0;
+    for (int i = 0; i < node->count; i++) {
+        if (is_subdirectory(node->fd, &node->entries[i])) subdirs++;
+    }
+    if (subdirs > 0) {
+        node->children = calloc(subdirs, sizeof(WalkNode*));
+    }
+    if (subdirs == 0 || !node->children) {
+        close(node->fd);
+        node->fd = -1;
+        return;
+    }
+
+    size_t path_len = strlen(node->path);
+    for (int i = 0; i < node->count; i++) {
+        RevealEntry* entry = &node->entries[i];
+        if (!is_subdirectory(node->fd, entry)) continue;
+
+        char* child_path = malloc(path_len + strlen(entry->name) + 2);
+        if (!child_path) break;
+        if (path_len > 0 && node->path[path_len - 1] == '/') {
+            sprintf(child_path, "%s%s", node->path, entry->name);
+        } else {
+            sprintf(child_path, "%s/%s", node->path, entry->name);
+        }
+        WalkNode* child = new_node(node, entry->name, child_path);
+        free(child_path);
+        if (!child) break;
+        node->children[node->child_count++] = child;
+    }
+
+    // Publish the fd reference count before any child can run.
+    node->pending_children = node->child_count;
+    if (node->child_count == 0) {
+        close(node->fd);
+        node->fd = -1;
+        return;
+    }
+    __atomic_add_fetch(&walker->outstanding, node->child_count, __ATOMIC_ACQ_REL);
+
+    // Push in reverse so the owner pops the first child first.
+    for (int i = node->child_count - 1; i >= 0; i--) {
+        if (deque_push(own, node->children[i]) < 0) {
+            // Out of memory for the queue: handle the child right here instead.
+            process_node(walker, own, node->children[i]);
+            __atomic_sub_fetch(&walker->outstanding, 1, __ATOMIC_ACQ_REL);
+        }
+    }
+}
+
+static void* walk_worker(void* arg) {
+    WorkerArgs* wa = arg;
+    Walker* walker = wa->walker;
+    WorkDeque* own = &walker->deques[wa->id];
+    int idle_spins = 0;
+    TraceSpan span = trace_begin("walk worker");
+
+    while (1) {
+        WalkNode* node = deque_pop(own);
+        for (int k = 1; node == NULL && k < walker->num_workers; k++) {
+            node = deque_steal(&walker->deques[(wa->id + k) % walker->num_workers]);
+        }
+
+        if (node == NULL) {
+            if (__atomic_load_n(&walker->outstanding, __ATOMIC_ACQUIRE) == 0) {
+                break;
+            }
+            if (++idle_spins < IDLE_SPINS_BEFORE_SLEEP) {
+                sched_yield();
+            } else {
+                struct timespec pause = { 0, 50000 }; // 50us
+                nanosleep(&pause, NULL);
+            }
+            continue;
+        }
+
+        idle_spins = 0;
+        process_node(walker, own, node);
+        __atomic_sub_fetch(&walker->outstanding, 1, __ATOMIC_ACQ_REL);
+    }
+    trace_end(span, NULL);
+    return NULL;
+}
+
+/**
+ * @brief Recursively lists `root` using a pool of work-stealing threads.
+ * @return The root of the directory tree, or NULL if it could not be allocated.
+ * The caller frees it with free_walk_tree(). Per-directory errors are recorded
+ * in WalkNode.error.
+ */
+WalkNode* walk_tree(const char* root, const WalkOptions* options, WalkStats* stats) {
+    WalkNode* root_node = new_node(NULL, root, root);
+    if (!root_node) return NULL;
+
+    int workers = options->max_threads;
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? (int)cpus : 1;
+    }
+    if (workers > MAX_WALK_THREADS) workers = MAX_WALK_THREADS;
+
+    WorkDeque deques[MAX_WALK_THREADS];
+    Walker walker = {
+        .options = options,
+        .deques = deques,
+        .num_workers = workers,
+        .outstanding = 1,
+    };
+    for (int i = 0; i < workers; i++) {
+        deque_init(&deques[i]);
+    }
+    deque_push(&deques[0], root_node);
+
+    // The calling thread is worker 0.
+    pthread_t threads[MAX_WALK_THREADS];
+    WorkerArgs args[MAX_WALK_THREADS];
+    int started = 0;
+    for (int i = 1; i < workers; i++) {
+        args[i].walker = &walker;
+        args[i].id = i;
+        if (pthread_create(&threads[started], NULL, walk_worker, &args[i]) == 0) {
+            started++;
+        }
+    }
+    args[0].walker = &walker;
+    args[0].id = 0;
+    walk_worker(&args[0]);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < workers; i++) {
+        deque_destroy(&deques[i]);
+    }
+
+    if (stats) {
+        stats->entries = walker.entries;
+        stats->directories = walker.directories;
+        stats->threads = started + 1;
+    }
+    return root_node;
+}
+
+void free_walk_tree(WalkNode* root) {
+    if (!root) return;
+    for (int i = 0; i < root->child_count; i++) {
+        free_walk_tree(root->children[i]);
+    }
+    for (int i = 0; i < root->count; i++) {
+        free(root->entries[i].name);
+    }
+    if (root->fd >= 0) close(root->fd);
+    free(root->entries);
+    free(root->children);
+    free(root->name);
+    free(root->path);
+    free(root);
+}
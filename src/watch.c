@@ -0,0 +1,396 @@
+#define _GNU_SOURCE // For syscall()
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+// Custom headers
+#include "watch.h"
+#include "route.h"
+#include "vars.h"
+#include "wildcard.h"
+#include "deadline.h"
+#include "coreutils.h" // For parse_duration
+#include "main.h"      // For foreground_pgid and interrupted
+#include "shellstat.h"
+#include "output.h"
+
+/*
+ * One inotify instance watches the given paths (and, with -r, every
+ * directory below them, up to a limit, including ones created later). The
+ * shell then sleeps in poll() on it, on the running pipeline's pidfd and on
+ * the deadline timer, so it uses no CPU while nothing changes.
+ *
+ * Each run is a forked copy of the shell that expands and runs the
+ * pipeline through execute_pipeline(), as its own job: cancelling a run
+ * signals that one process group, the run's commands included. Hidden
+ * files and directories (editor swap files, .git) are ignored.
+ */
+
+#define DEFAULT_MAX_WATCHES 8192
+#define DEFAULT_DEBOUNCE 0.1 // Seconds without changes that end a burst
+#define WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+                      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct {
+    int fd;           // The inotify instance
+    char** paths;     // Watched paths, by watch descriptor
+    int paths_size;
+    int count;        // Watches in place
+    int max;
+    int recursive;
+    int warned;       // Already said that `max` was reached
+} Watcher;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_watch(Watcher* w, const char* path) {
+    if (w->count >= w->max) {
+        if (!w->warned) {
+            fprintf(stderr, "watch: limit of %d watches reached; not watching %s and beyond\n", w->max, path);
+            w->warned = 1;
+        }
+        return -1;
+    }
+    int wd = inotify_add_watch(w->fd, path, WATCH_EVENTS);
+    if (wd < 0) {
+        fprintf(stderr, "watch: %s: %s\n", path,
+                errno == ENOSPC ? "out of inotify watches (see fs.inotify.max_user_watches)" : strerror(errno));
+        return -1;
+    }
+    if (wd >= w->paths_size) {
+        int size = w->paths_size ? w->paths_size : 64;
+        while (size <= wd) size *= 2;
+        char** tmp = realloc(w->paths, size * sizeof(char*));
+        if (!tmp) {
+            inotify_rm_watch(w->fd, wd);
+            return -1;
+        }
+        memset(tmp + w->paths_size, 0, (size - w->paths_size) * sizeof(char*));
+        w->paths = tmp;
+        w->paths_size = size;
+    }
+    if (w->paths[wd] == NULL) { // Else the same file, already watched
+        if (!(w->paths[wd] = strdup(path))) {
+            inotify_rm_watch(w->fd, wd);
+            return -1;
+        }
+        w->count++;
+    }
+    return 0;
+}
+
+// Watches `path`, and with -r the directories under it.
+static void add_tree(Watcher* w, const char* path) {
+    if (add_watch(w, path) != 0 || !w->recursive) {
+        return;
+    }
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return; // Not a directory
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && w->count < w->max) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char* child = malloc(strlen(path) + strlen(entry->d_name) + 2);
+        if (!child) break;
+        sprintf(child, "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (entry->d_type == DT_DIR ||
+            (entry->d_type == DT_UNKNOWN && lstat(child, &st) == 0 && S_ISDIR(st.st_mode))) {
+            add_tree(w, child);
+        }
+        free(child);
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Reads all pending events, watching new directories as they
+ * appear (with -r) and forgetting removed ones.
+ * @return The number of changes among them.
+ */
+static int drain_events(Watcher* w) {
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changes = 0;
+    ssize_t len;
+    while ((len = read(w->fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+            const char* dir = event->wd >= 0 && event->wd < w->paths_size ? w->paths[event->wd] : NULL;
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes++; // Lost count, but something changed
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                if (dir) {
+                    free(w->paths[event->wd]);
+                    w->paths[event->wd] = NULL;
+                    w->count--;
+                }
+                continue;
+            }
+            if (event->len > 0 && event->name[0] == '.') {
+                continue;
+            }
+            changes++;
+            if (w->recursive && dir && event->len > 0 && (event->mask & IN_ISDIR) &&
+                (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                char* child = malloc(strlen(dir) + strlen(event->name) + 2);
+                if (child) {
+                    sprintf(child, "%s/%s", dir, event->name);
+                    add_tree(w, child);
+                    free(child);
+                }
+            }
+        }
+    }
+    return changes;
+}
+
+/**
+ * @brief Forks a copy of the shell that runs the pipeline as job of its
+ * own and exits with its status.
+ * @return The run's pid (and process group), with a pidfd for it in *pidfd.
+ */
+static pid_t start_run(CommandPipeline* pipeline, const char* original_command, int inotify_fd, int* pidfd) {
+    out_flush(); // Don't let the child inherit (and repeat) pending output
+    shellstat.forks++;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("watch: fork");
+        return -1;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        __fpurge(stdin); // The shell's read-ahead isn't ours; see execute_child_command()
+        close(inotify_fd);
+        set_job_group(getpid());
+        execute_pipeline(pipeline, original_command);
+        fflush(stdout);
+        exit(get_last_status());
+    }
+    setpgid(pid, pid);
+    *pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (*pidfd < 0) {
+        perror("watch: pidfd_open");
+        kill(-pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    foreground_pgid = pid; // Ctrl-C reaches the run, too
+    return pid;
+}
+
+// Strips `watch OPTIONS PATHS --` off the pipeline. Returns the words before
+// `--`, expanded, in *prefix; 0 if there is no `--`, -1 after an error.
+static int take_prefix(CommandPipeline* pipeline, SimpleCommand* prefix) {
+    SimpleCommand* cmd = &pipeline->commands[0];
+    int end = 1;
+    while (end < cmd->arg_count && strcmp(cmd->args[end], "--") != 0) end++;
+    if (end == cmd->arg_count) {
+        return 0;
+    }
+    for (int i = 0; i < end; i++) {
+        char* word = strdup(cmd->args[i]);
+        if (!word || !append_arg(prefix, word)) {
+            free(word);
+            return -1;
+        }
+    }
+    for (int i = 0; i <= end; i++) {
+        free(cmd->args[i]);
+    }
+    memmove(cmd->args, cmd->args + end + 1, (size_t)(cmd->arg_count - end) * sizeof(char*));
+    cmd->arg_count -= end + 1;
+    if (cmd->arg_count == 0 && pipeline->num_commands == 1) {
+        fprintf(stderr, "watch: missing command after --\n");
+        return -1;
+    }
+    return expand_command_words(prefix) == 0 && expand_command_globs(prefix) == 0 ? 1 : -1;
+}
+
+static void free_prefix(SimpleCommand* prefix) {
+    for (int i = 0; i < prefix->arg_count; i++) free(prefix->args[i]);
+    free(prefix->args);
+    for (int i = 0; i < prefix->assignment_count; i++) free(prefix->assignments[i]);
+    free(prefix->assignments);
+}
+
+// Parses the options, leaving *first at the first path.
+static int parse_options(char** args, Watcher* w, double* debounce, int* first) {
+    int i = 1;
+    for (; args[i] && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            w->recursive = 1;
+        } else if (strcmp(args[i], "-m") == 0 && args[i + 1]) {
+            char* end;
+            long max = strtol(args[++i], &end, 10);
+            if (*end != '\0' || max < 1) {
+                fprintf(stderr, "watch: invalid watch limit '%s'\n", args[i]);
+                return -1;
+            }
+            w->max = (int)max;
+        } else if (strcmp(args[i], "-d") == 0 && args[i + 1]) {
+            if (parse_duration(args[++i], debounce) != 0) {
+                fprintf(stderr, "watch: invalid debounce '%s'\n", args[i]);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "watch: usage: watch [-r] [-m MAX] [-d DUR] PATH... -- pipeline\n");
+            return -1;
+        }
+    }
+    if (args[i] == NULL) {
+        fprintf(stderr, "watch: no paths to watch\n");
+        return -1;
+    }
+    *first = i;
+    return 0;
+}
+
+static void stop_run(pid_t pgid) {
+    kill(-pgid, SIGTERM);
+    kill(-pgid, SIGCONT); // In case Ctrl-Z stopped it
+}
+
+int watch_run(CommandPipeline* pipeline, const char* original_command) {
+    SimpleCommand* cmd = &pipeline->commands[0];
+    if (cmd->arg_count == 0 || strcmp(cmd->args[0], "watch") != 0) {
+        return 0;
+    }
+    SimpleCommand prefix = {0};
+    int taken = take_prefix(pipeline, &prefix);
+    if (taken == 0) {
+        return 0; // No `--`: some other watch(1)
+    }
+
+    Watcher w = {-1, NULL, 0, 0, DEFAULT_MAX_WATCHES, 0, 0};
+    double debounce = DEFAULT_DEBOUNCE;
+    int first_path;
+    if (taken < 0 || parse_options(prefix.args, &w, &debounce, &first_path) != 0) {
+        free_prefix(&prefix);
+        set_last_status(2);
+        return 1;
+    }
+    if (pipeline->mode == BACKGROUND) {
+        fprintf(stderr, "watch: runs in the foreground (stop it with Ctrl-C)\n");
+        free_prefix(&prefix);
+        set_last_status(2);
+        return 1;
+    }
+    if ((w.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        perror("watch: inotify_init1");
+        free_prefix(&prefix);
+        set_last_status(1);
+        return 1;
+    }
+    for (int i = first_path; i < prefix.arg_count; i++) {
+        add_tree(&w, prefix.args[i]);
+    }
+    if (w.count == 0) {
+        close(w.fd);
+        free(w.paths);
+        free_prefix(&prefix);
+        set_last_status(1);
+        return 1;
+    }
+
+    int runs = 0, reruns = 0, cancelled = 0, changes = 0;
+    double burst_start = 0, last_change = 0, total_latency = 0, max_latency = 0;
+    int pidfd = -1;
+    pid_t run = start_run(pipeline, original_command, w.fd, &pidfd);
+    runs += run > 0;
+    while (!interrupted) {
+        struct pollfd fds[3] = {{w.fd, POLLIN, 0}, {pidfd, POLLIN, 0}, {deadline_fd(), POLLIN, 0}};
+        int timeout = -1; // Nothing to do until something happens
+        if (changes > 0 && run <= 0) {
+            double left = last_change + debounce - now_seconds();
+            timeout = left > 0 ? (int)(left * 1000) + 1 : 0;
+        }
+        int ready = poll(fds, 3, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue; // Ctrl-C sets `interrupted`
+            perror("watch: poll");
+            break;
+        }
+        if (fds[2].revents & POLLIN) {
+            deadline_expire();
+        }
+        if (fds[1].revents & POLLIN) {
+            int status;
+            if (waitpid(run, &status, 0) == run) {
+                set_last_status(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+            }
+            close(pidfd);
+            pidfd = -1;
+            run = 0;
+            foreground_pgid = 0;
+        }
+        if (fds[0].revents & POLLIN) {
+            int n = drain_events(&w);
+            if (n > 0) {
+                if (changes == 0) {
+                    burst_start = now_seconds();
+                }
+                changes += n;
+                last_change = now_seconds();
+                if (run > 0) {
+                    stop_run(run); // Stale already; the next run starts once it's gone
+                    cancelled++;
+                }
+            }
+        }
+        if (changes > 0 && run <= 0 && now_seconds() >= last_change + debounce) {
+            // Replaced files drop their watches; put the named paths back.
+            for (int i = first_path; i < prefix.arg_count; i++) {
+                if (access(prefix.args[i], F_OK) == 0) add_watch(&w, prefix.args[i]);
+            }
+            run = start_run(pipeline, original_command, w.fd, &pidfd);
+            double latency = (now_seconds() - burst_start) * 1000;
+            fprintf(stderr, "watch: %d change%s, run %d started %.1f ms after the first\n",
+                    changes, changes == 1 ? "" : "s", runs + 1, latency);
+            runs += run > 0;
+            reruns++;
+            total_latency += latency;
+            max_latency = latency > max_latency ? latency : max_latency;
+            changes = 0;
+        }
+    }
+
+    if (run > 0) {
+        stop_run(run);
+        waitpid(run, NULL, 0);
+        close(pidfd);
+        foreground_pgid = 0;
+    }
+    if (reruns > 0) {
+        fprintf(stderr, "watch: %d runs, %d cancelled; latency avg %.1f ms, max %.1f ms\n",
+                runs, cancelled, total_latency / reruns, max_latency);
+    }
+    close(w.fd);
+    for (int i = 0; i < w.paths_size; i++) free(w.paths[i]);
+    free(w.paths);
+    free_prefix(&prefix);
+    set_last_status(130);
+    return 1;
+}
@@ -0,0 +1,506 @@
+#define _GNU_SOURCE // For the DT_* d_type constants
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Custom headers
+#include "wildcard.h"
+#include "command.h"
+#include "dircache.h"
+
+/*
+ * Glob expansion, run on each command's arguments before execution.
+ *
+ * A pattern is split on '/' into components. Components without wildcards are
+ * appended to the path without reading any directory, so "src/main*.c" only lists
+ * src/. Wildcard components are compiled once into a small op list and matched
+ * against listings from the directory cache; readdir's d_type decides whether
+ * an entry is a directory, with a stat only when the filesystem doesn't say.
+ * A "**" component matches zero or more directories. Paths are built in one
+ * fixed buffer and only copied out for actual matches.
+ */
+
+typedef enum {
+    OP_LITERAL, // A run of ordinary characters
+    OP_ANY,     // ?
+    OP_STAR,    // *
+    OP_CLASS    // [...]
+} GlobOpType;
+
+typedef struct {
+    GlobOpType type;
+    int len;          // OP_LITERAL: length of text
+    const char* text; // OP_LITERAL: unescaped characters
+    int class_index;  // OP_CLASS: index into classes
+} GlobOp;
+
+struct GlobPattern {
+    GlobOp* ops;
+    int num_ops;
+    char* text;                  // Storage for the literal runs
+    unsigned char (*classes)[32]; // One 256-bit set per [...] class
+    int is_literal;              // No wildcards at all
+    int is_globstar;             // The component is exactly "**"
+    int match_hidden;            // Pattern starts with '.', so dot files may match
+};
+
+typedef struct {
+    char** items;
+    int count;
+    int capacity;
+} GlobResults;
+
+typedef struct {
+    GlobPattern** components;
+    int num_components;
+    int trailing_slash; // "dir/*/" only matches directories
+    GlobResults results;
+} GlobState;
+
+
+// Finds the end of a [...] class starting at `p` (pointing at '['), or NULL.
+static const char* class_end(const char* p) {
+    const char* q = p + 1;
+    if (*q == '!' || *q == '^') q++;
+    if (*q == ']') q++; // A leading ']' is a member, not the end
+    while (*q && *q != ']' && *q != '/') q++;
+    return (*q == ']') ? q : NULL;
+}
+
+/**
+ * @brief Returns 1 if the word contains an unescaped *, ? or a complete [...].
+ */
+int has_glob_chars(const char* word) {
+    for (const char* p = word; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '*' || *p == '?') {
+            return 1;
+        } else if (*p == '[' && class_end(p)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compiles one path component into an op list.
+ * @return The pattern, or NULL if out of memory.
+ */
+GlobPattern* glob_compile(const char* component) {
+    size_t len = strlen(component);
+    GlobPattern* pat = calloc(1, sizeof(GlobPattern));
+    if (!pat) return NULL;
+    // Each op consumes at least one pattern character, so len bounds everything.
+    pat->ops = malloc((len + 1) * sizeof(GlobOp));
+    pat->text = malloc(len + 1);
+    pat->classes = malloc((len / 2 + 1) * sizeof(*pat->classes));
+    if (!pat->ops || !pat->text || !pat->classes) {
+        glob_free(pat);
+        return NULL;
+    }
+
+    pat->is_globstar = strcmp(component, "**") == 0;
+    pat->match_hidden = component[0] == '.';
+    pat->is_literal = 1;
+
+    char* out = pat->text;
+    int num_classes = 0;
+    const char* p = component;
+    while (*p) {
+        GlobOp* op = &pat->ops[pat->num_ops];
+        const char* end;
+        if (*p == '*') {
+            // Consecutive stars are equivalent to one.
+            if (pat->num_ops == 0 || pat->ops[pat->num_ops - 1].type != OP_STAR) {
+                op->type = OP_STAR;
+                pat->num_ops++;
+            }
+            pat->is_literal = 0;
+            p++;
+        } else if (*p == '?') {
+            op->type = OP_ANY;
+            pat->num_ops++;
+            pat->is_literal = 0;
+            p++;
+        } else if (*p == '[' && (end = class_end(p)) != NULL) {
+            unsigned char* set = pat->classes[num_classes];
+            memset(set, 0, 32);
+            const char* q = p + 1;
+            int negate = (*q == '!' || *q == '^');
+            if (negate) q++;
+            while (q < end) {
+                unsigned char lo = (unsigned char)*q;
+                unsigned char hi = lo;
+                if (q[1] == '-' && q + 2 < end) {
+                    hi = (unsigned char)q[2];
+                    q += 3;
+                } else {
+                    q++;
+                }
+                for (unsigned int c = lo; c <= hi; c++) {
+                    set[c >> 3] |= (unsigned char)(1u << (c & 7));
+                }
+            }
+            if (negate) {
+                for (int i = 0; i < 32; i++) set[i] = (unsigned char)~set[i];
+            }
+            set[0] &= (unsigned char)~1u; // Never match the terminator
+            op->type = OP_CLASS;
+            op->class_index = num_classes++;
+            pat->num_ops++;
+            pat->is_literal = 0;
+            p = end + 1;
+        } else {
+            // Gather a run of literal characters, removing escapes.
+            op->type = OP_LITERAL;
+            op->text = out;
+            while (*p && *p != '*' && *p != '?' && !(*p == '[' && class_end(p))) {
+                if (*p == '\\' && p[1]) p++;
+                *out++ = *p++;
+            }
+            op->len = (int)(out - op->text);
+            pat->num_ops++;
+        }
+    }
+    *out = '\0';
+    return pat;
+}
+
+void glob_free(GlobPattern* pattern) {
+    if (!pattern) return;
+    free(pattern->ops);
+    free(pattern->text);
+    free(pattern->classes);
+    free(pattern);
+}
+
+/**
+ * @brief Matches a name against a compiled component.
+ * On a mismatch after a '*', it retries with the star absorbing one more
+ * character; remembering only the last star is enough for glob patterns.
+ */
+int glob_match(const GlobPattern* pattern, const char* name) {
+    const GlobOp* ops = pattern->ops;
+    int n = pattern->num_ops;
+    int i = 0;
+    const char* s = name;
+    int star_op = -1;
+    const char* star_pos = NULL;
+
+    while (1) {
+        if (i < n) {
+            const GlobOp* op = &ops[i];
+            if (op->type == OP_STAR) {
+                if (i == n - 1) return 1; // A trailing star matches the rest
+                star_op = i++;
+                star_pos = s;
+                continue;
+            }
+            if (op->type == OP_LITERAL) {
+                if (strncmp(s, op->text, op->len) == 0) {
+                    s += op->len;
+                    i++;
+                    continue;
+                }
+            } else if (*s != '\0') {
+                unsigned char c = (unsigned char)*s;
+                if (op->type == OP_ANY ||
+                    (pattern->classes[op->class_index][c >> 3] & (1u << (c & 7)))) {
+                    s++;
+                    i++;
+                    continue;
+                }
+            }
+        } else if (*s == '\0') {
+            return 1;
+        }
+
+        // Mismatch: let the last star swallow one more character.
+        if (star_op < 0 || *star_pos == '\0') {
+            return 0;
+        }
+        s = ++star_pos;
+        i = star_op + 1;
+    }
+}
+
+
+static int add_result(GlobResults* r, const char* path) {
+    if (r->count == r->capacity) {
+        int new_capacity = r->capacity ? r->capacity * 2 : 16;
+        char** tmp = realloc(r->items, new_capacity * sizeof(char*));
+        if (!tmp) return -1;
+        r->items = tmp;
+        r->capacity = new_capacity;
+    }
+    r->items[r->count] = strdup(path);
+    if (!r->items[r->count]) return -1;
+    r->count++;
+    return 0;
+}
+
+// Appends "/name" (or just "name" at the start) to the path buffer.
+static size_t path_append(char* path, size_t len, const char* name) {
+    size_t name_len = strlen(name);
+    size_t sep = (len > 0 && path[len - 1] != '/') ? 1 : 0;
+    if (len + sep + name_len + 1 >= PATH_MAX) {
+        return 0;
+    }
+    if (sep) path[len] = '/';
+    memcpy(path + len + sep, name, name_len + 1);
+    return len + sep + name_len;
+}
+
+// Uses d_type when it's conclusive; stats only for symlinks and unknown types.
+static int entry_is_dir(const char* path, unsigned char d_type) {
+    if (d_type == DT_DIR) return 1;
+    if (d_type != DT_UNKNOWN && d_type != DT_LNK) return 0;
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static int path_exists(const char* path, int need_dir) {
+    struct stat st;
+    if (need_dir) {
+        return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+    return fstatat(AT_FDCWD, path, &st, AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+static void emit(GlobState* state, char* path, size_t len) {
+    if (len == 0) return;
+    if (state->trailing_slash) {
+        if (len + 1 >= PATH_MAX) return;
+        path[len] = '/';
+        path[len + 1] = '\0';
+        add_result(&state->results, path);
+        path[len] = '\0';
+    } else {
+        add_result(&state->results, path);
+    }
+}
+
+/**
+ * @brief Matches components [idx..] below the directory in path[0..len).
+ * @param verified 0 if literal components were appended since the last
+ *        listing, so the path still has to be checked before it's reported.
+ */
+static void expand_from(GlobState* state, int idx, char* path, size_t len, int verified) {
+    int last = (idx == state->num_components - 1);
+
+    if (idx == state->num_components) {
+        if (verified || path_exists(path, state->trailing_slash)) {
+            emit(state, path, len);
+        }
+        return;
+    }
+
+    GlobPattern* pat = state->components[idx];
+    if (pat->is_literal) {
+        // No wildcards: no need to read the directory at all.
+        size_t new_len = path_append(path, len, pat->text);
+        if (new_len > 0) {
+            expand_from(state, idx + 1, path, new_len, 0);
+        }
+        path[len] = '\0';
+        return;
+    }
+
+    if (pat->is_globstar && !last) {
+        // Zero directories: match the rest right here.
+        expand_from(state, idx + 1, path, len, verified);
+    }
+
+    DirListing* listing = dircache_get(len > 0 ? path : ".");
+    if (!listing) {
+        path[len] = '\0';
+        return;
+    }
+
+    for (int i = 0; i < listing->count; i++) {
+        const char* name = listing->names[i];
+        if (name[0] == '.') {
+            // "." and ".." never match; other dot files only match an explicit dot.
+            if (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')) continue;
+            if (!pat->match_hidden) continue;
+        }
+
+        if (pat->is_globstar) {
+            size_t new_len = path_append(path, len, name);
+            if (new_len == 0) continue;
+            // Don't follow symlinks while recursing; that's how loops happen.
+            int is_dir = listing->types[i] == DT_DIR ||
+                         (listing->types[i] == DT_UNKNOWN && entry_is_dir(path, DT_UNKNOWN));
+            if (last) {
+                if (!state->trailing_slash || is_dir) emit(state, path, new_len);
+            }
+            if (is_dir) {
+                expand_from(state, idx, path, new_len, 1);
+            }
+            path[len] = '\0';
+            continue;
+        }
+
+        if (!glob_match(pat, name)) continue;
+
+        size_t new_len = path_append(path, len, name);
+        if (new_len == 0) continue;
+        if (last) {
+            if (!state->trailing_slash || entry_is_dir(path, listing->types[i])) {
+                emit(state, path, new_len);
+            }
+        } else if (entry_is_dir(path, listing->types[i])) {
+            expand_from(state, idx + 1, path, new_len, 1);
+        }
+        path[len] = '\0';
+    }
+    dircache_release(listing);
+    path[len] = '\0';
+}
+
+static int result_comparator(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * @brief Expands a pattern into the sorted list of paths it matches.
+ * @return A NULL-terminated array (free with free_glob_results), or NULL if
+ *         there were no matches.
+ */
+char** glob_expand(const char* pattern, int* count) {
+    *count = 0;
+    size_t pattern_len = strlen(pattern);
+    if (pattern_len == 0 || pattern_len >= PATH_MAX) return NULL;
+
+    char* copy = strdup(pattern);
+    if (!copy) return NULL;
+
+    GlobState state = {0};
+    state.components = calloc(pattern_len / 2 + 2, sizeof(GlobPattern*));
+    if (!state.components) {
+        free(copy);
+        return NULL;
+    }
+
+    // Split on '/', collapsing repeated slashes.
+    char path[PATH_MAX];
+    size_t len = 0;
+    char* p = copy;
+    if (*p == '/') {
+        path[len++] = '/';
+    }
+    path[len] = '\0';
+    int ok = 1;
+    char* save = NULL;
+    for (char* tok = strtok_r(p, "/", &save); tok; tok = strtok_r(NULL, "/", &save)) {
+        GlobPattern* pat = glob_compile(tok);
+        if (!pat) {
+            ok = 0;
+            break;
+        }
+        state.components[state.num_components++] = pat;
+    }
+    state.trailing_slash = pattern[pattern_len - 1] == '/' && state.num_components > 0;
+
+    if (ok && state.num_components > 0) {
+        expand_from(&state, 0, path, len, 1);
+    }
+
+    for (int i = 0; i < state.num_components; i++) {
+        glob_free(state.components[i]);
+    }
+    free(state.components);
+    free(copy);
+
+    GlobResults* r = &state.results;
+    if (r->count == 0) {
+        free(r->items);
+        return NULL;
+    }
+
+    // Sort and drop duplicates (several "**" can reach the same path).
+    qsort(r->items, r->count, sizeof(char*), result_comparator);
+    int unique = 1;
+    for (int i = 1; i < r->count; i++) {
+        if (strcmp(r->items[i], r->items[unique - 1]) == 0) {
+            free(r->items[i]);
+        } else {
+            r->items[unique++] = r->items[i];
+        }
+    }
+    r->count = unique;
+
+    if (add_result(r, "") != 0) { // Make room for the terminator
+        free_glob_results(r->items, r->count);
+        return NULL;
+    }
+    free(r->items[r->count - 1]);
+    r->items[--r->count] = NULL;
+
+    *count = r->count;
+    return r->items;
+}
+
+void free_glob_results(char** results, int count) {
+    if (!results) return;
+    for (int i = 0; i < count; i++) free(results[i]);
+    free(results);
+}
+
+/**
+ * @brief Expands the wildcard arguments of a command in place, so builtins
+ * like hop and reveal see the same expanded arguments as external programs.
+ * @return 0 on success, -1 if out of memory (the command is left unchanged).
+ */
+int expand_command_globs(SimpleCommand* cmd) {
+    int needs_expansion = 0;
+    for (int i = 0; i < cmd->arg_count; i++) {
+        if (has_glob_chars(cmd->args[i])) {
+            needs_expansion = 1;
+            break;
+        }
+    }
+    if (!needs_expansion) return 0;
+
+    // Build the new list on the side so a failure leaves cmd untouched.
+    SimpleCommand expanded = {0};
+    for (int i = 0; i < cmd->arg_count; i++) {
+        int count = 0;
+        char** matches = has_glob_chars(cmd->args[i]) ? glob_expand(cmd->args[i], &count) : NULL;
+        if (!matches) {
+            // No match: the word is passed through unchanged.
+            char* copy = strdup(cmd->args[i]);
+            if (!copy || !append_arg(&expanded, copy)) {
+                free(copy);
+                goto fail;
+            }
+            continue;
+        }
+        for (int j = 0; j < count; j++) {
+            if (!append_arg(&expanded, matches[j])) {
+                for (int k = j; k < count; k++) free(matches[k]);
+                free(matches);
+                goto fail;
+            }
+        }
+        free(matches); // The strings now belong to `expanded`
+    }
+
+    for (int i = 0; i < cmd->arg_count; i++) free(cmd->args[i]);
+    free(cmd->args);
+    cmd->args = expanded.args;
+    cmd->arg_count = expanded.arg_count;
+    cmd->arg_capacity = expanded.arg_capacity;
+    return 0;
+
+fail:
+    perror("shell: glob");
+    for (int i = 0; i < expanded.arg_count; i++) free(expanded.args[i]);
+    free(expanded.args);
+    return -1;
+}
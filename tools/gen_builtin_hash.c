@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdint.h>
+
+// Custom headers
+#include "builtins.h"
+
+/*
+ * Build-time generator for the builtin table's perfect hash.
+ *
+ * Finds the smallest power-of-two table and a seed for builtin_hash() under
+ * which every name in builtins.def gets a slot of its own, then prints a
+ * header mapping slots to table indices. Lookups then cost one hash and
+ * one strcmp, however many builtins there are.
+ */
+
+#define MAX_SEEDS 1000000
+#define MAX_BITS 12
+
+static const char* names[] = {
+#define BUILTIN(name, fn, flags) #name,
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#define NUM_NAMES ((int)(sizeof(names) / sizeof(names[0])))
+
+static int try_seed(uint32_t seed, int bits, int* slots) {
+    uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = 0; i <= mask; i++) slots[i] = -1;
+    for (int i = 0; i < NUM_NAMES; i++) {
+        uint32_t slot = builtin_hash(names[i], seed) & mask;
+        if (slots[slot] != -1) return 0;
+        slots[slot] = i;
+    }
+    return 1;
+}
+
+int main(void) {
+    static int slots[1 << MAX_BITS];
+    int bits = 1;
+    while ((1 << bits) < NUM_NAMES) bits++;
+
+    for (; bits <= MAX_BITS; bits++) {
+        for (uint32_t seed = 2166136261u; seed < 2166136261u + MAX_SEEDS; seed++) {
+            if (!try_seed(seed, bits, slots)) continue;
+
+            printf("// Generated by tools/gen_builtin_hash.c from include/builtins.def. Do not edit.\n");
+            printf("#define BUILTIN_HASH_SEED %uu\n", seed);
+            printf("#define BUILTIN_HASH_BITS %d\n\n", bits);
+            printf("static const short builtin_slots[1 << BUILTIN_HASH_BITS] = {");
+            for (int i = 0; i < (1 << bits); i++) {
+                printf("%s%s%d", i ? "," : "", i % 16 ? " " : "\n    ", slots[i]);
+            }
+            printf("\n};\n");
+            return 0;
+        }
+    }
+    fprintf(stderr, "gen_builtin_hash: no perfect hash found for %d builtins\n", NUM_NAMES);
+    return 1;
+}